@@ -0,0 +1,381 @@
+#include "database/database.h"
+#include "encryption/encryption.h"
+#include "encryption/kdf.h"
+#include "database/text_search.h"
+#include "encryption/session_key.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * @brief Результат одного замера: латентности отдельных операций в наносекундах.
+ */
+struct bench_result_t {
+    std::string m_name;
+    size_t m_vaultSize;
+    std::vector<double> m_latenciesNs;
+    double m_totalSeconds;
+};
+
+/**
+ * @brief Синтетический источник записей для быстрого заполнения хранилища.
+ */
+class synthetic_reader_t : public entry_reader_t {
+private:
+    size_t m_count;
+    size_t m_next;
+    std::string m_error;
+
+public:
+    explicit synthetic_reader_t(size_t count) : m_count(count), m_next(0) {}
+
+    bool next_(import_row_t& row) override {
+        if (m_next >= m_count) {
+            return false;
+        }
+        std::string n = std::to_string(m_next++);
+        row.m_title = "Site " + n;
+        row.m_url = "https://site" + n + ".example.com/login";
+        row.m_username = "user" + n + "@example.com";
+        row.m_password = "P@ssw0rd-" + n;
+        row.m_notes = "synthetic entry number " + n;
+        return true;
+    }
+
+    const std::string& error_() const override {
+        return m_error;
+    }
+};
+
+/**
+ * @brief Выполняет op ops раз и собирает латентность каждого вызова.
+ */
+static bench_result_t measure(const std::string& name, size_t vaultSize, size_t ops,
+                              const std::function<void(size_t)>& op) {
+    bench_result_t result{name, vaultSize, {}, 0.0};
+    result.m_latenciesNs.reserve(ops);
+
+    auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        op(i);
+        auto t1 = std::chrono::steady_clock::now();
+        result.m_latenciesNs.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+    }
+    result.m_totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return result;
+}
+
+/**
+ * @brief То же, что measure, но ops вызовов делятся между threads потоками;
+ *        op получает номер потока и номер вызова.
+ */
+static bench_result_t measure_parallel(const std::string& name, size_t vaultSize, size_t ops, size_t threads,
+                                       const std::function<void(size_t, size_t)>& op) {
+    bench_result_t result{name, vaultSize, {}, 0.0};
+    std::vector<std::vector<double>> latencies(threads);
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            size_t count = ops / threads + (t < ops % threads ? 1 : 0);
+            latencies[t].reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                auto t0 = std::chrono::steady_clock::now();
+                op(t, i);
+                auto t1 = std::chrono::steady_clock::now();
+                latencies[t].push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    result.m_totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    for (const std::vector<double>& part : latencies) {
+        result.m_latenciesNs.insert(result.m_latenciesNs.end(), part.begin(), part.end());
+    }
+    return result;
+}
+
+static double percentile(std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static void write_json(std::ostream& out, std::vector<bench_result_t>& results) {
+    out << "{\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        bench_result_t& r = results[i];
+        std::sort(r.m_latenciesNs.begin(), r.m_latenciesNs.end());
+
+        double throughput = r.m_totalSeconds > 0.0 ? r.m_latenciesNs.size() / r.m_totalSeconds : 0.0;
+        out << "    {\"name\": \"" << r.m_name << "\""
+            << ", \"vault_size\": " << r.m_vaultSize
+            << ", \"ops\": " << r.m_latenciesNs.size()
+            << ", \"throughput_ops_per_s\": " << throughput
+            << ", \"p50_us\": " << percentile(r.m_latenciesNs, 0.50) / 1000.0
+            << ", \"p99_us\": " << percentile(r.m_latenciesNs, 0.99) / 1000.0
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+static std::vector<size_t> parse_sizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            sizes.push_back(std::stoul(item));
+        }
+    }
+    return sizes;
+}
+
+static void print_usage() {
+    std::cerr << "Usage: passman_bench [--sizes 1000,10000,100000,1000000] [--ops N]\n"
+              << "                     [--sqlite-defaults] [--readers N] [--cache N]\n"
+              << "                     [--out result.json]\n";
+}
+
+/**
+ * @brief Замеры криптографии (не зависят от размера хранилища).
+ */
+static void bench_crypto(size_t ops, std::vector<bench_result_t>& results) {
+    encryption_t encryption;
+
+    results.push_back(measure("derive_key_", 0, std::max<size_t>(ops / 100, 5), [&](size_t i) {
+        encryption.derive_key_("master-password-" + std::to_string(i));
+    }));
+
+    // Одинаковая общая работа (400000 итераций PBKDF2-SHA256), разное число полос
+    const uint32_t totalIterations = 400000;
+    for (uint32_t lanes : {1u, default_kdf_lanes()}) {
+        kdf_params_t params{kdf_algorithm_t::pbkdf2_sha256, totalIterations / lanes, 0, 0, 0,
+                            std::vector<unsigned char>(16, 0x5a), lanes};
+        unsigned char derived[32];
+        results.push_back(measure("derive_kdf_key_lanes" + std::to_string(lanes), 0, 5, [&](size_t) {
+            derive_kdf_key("master-password", params, derived, sizeof(derived));
+        }));
+        if (lanes == 1 && default_kdf_lanes() == 1) {
+            break;
+        }
+    }
+
+    session_key_t key = session_key_t::derive_(encryption, "master-password");
+    std::vector<std::vector<unsigned char>> ciphertexts(ops);
+    results.push_back(measure("encrypt_aes_", 0, ops, [&](size_t i) {
+        ciphertexts[i] = encryption.encrypt_aes_("P@ssw0rd-" + std::to_string(i), key);
+    }));
+    results.push_back(measure("decrypt_aes_", 0, ops, [&](size_t i) {
+        encryption.decrypt_aes_(ciphertexts[i].data(), ciphertexts[i].size(), key);
+    }));
+
+    // Без выделений: контекст и буферы переиспользуются между вызовами
+    cipher_context_t ctx;
+    std::vector<unsigned char> sealed(encryption_t::encrypted_size_(64));
+    std::vector<unsigned char> opened(encryption_t::decrypted_capacity_(sealed.size()));
+    std::string plaintext = "P@ssw0rd-0123456789";
+    size_t sealedSize = 0;
+    results.push_back(measure("encrypt_into_", 0, ops, [&](size_t) {
+        sealedSize = encryption.encrypt_into_(ctx, reinterpret_cast<const unsigned char*>(plaintext.data()),
+                                              plaintext.size(), key, sealed.data());
+    }));
+    results.push_back(measure("decrypt_into_", 0, ops, [&](size_t) {
+        size_t written = 0;
+        encryption.decrypt_into_(ctx, sealed.data(), sealedSize, key, opened.data(), written);
+    }));
+}
+
+/**
+ * @brief Замеры операций database_t на хранилище заданного размера.
+ */
+static void bench_database(size_t vaultSize, size_t ops, bool sqliteDefaults, int readers,
+                           size_t cacheSize, std::vector<bench_result_t>& results) {
+    fs::path dir = fs::temp_directory_path() / ("passman_bench_" + std::to_string(vaultSize));
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    std::string path = (dir / "passwords.db").string();
+    storage_profile_t profile = sqliteDefaults ? storage_profile_t::sqlite_defaults_(path)
+                                               : storage_profile_t::tuned_(path);
+    profile.m_readConnections = readers;
+
+    {
+        encryption_t encryption;
+        session_key_t key = session_key_t::derive_(encryption, "master-password");
+
+        database_t db(profile);
+        db.init_database_();
+        db.enable_cache_(cacheSize, std::chrono::seconds(60));
+
+        synthetic_reader_t reader(vaultSize);
+        import_result_t imported = db.import_entries_(reader, key, 10000);
+        std::cerr << "vault " << vaultSize << ": filled in " << imported.m_seconds << " s ("
+                  << static_cast<size_t>(imported.m_rowsPerSecond) << " rows/s)\n";
+
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> pickId(1, static_cast<int>(std::max<size_t>(vaultSize, 1)));
+
+        results.push_back(measure("get_entry_by_id_", vaultSize, ops, [&](size_t) {
+            db.get_entry_by_id_(pickId(rng));
+        }));
+
+        results.push_back(measure("get_decrypted_password_", vaultSize, ops, [&](size_t) {
+            db.get_decrypted_password_(pickId(rng), key);
+        }));
+
+        // Пакет из 200 ID: один запрос и одна расшифровка пакета на пуле
+        std::vector<int> batchIds(200);
+        std::vector<std::string> batchPasswords;
+        results.push_back(measure("get_decrypted_passwords_x200", vaultSize, std::max<size_t>(ops / 100, 10),
+                                  [&](size_t) {
+            for (int& id : batchIds) {
+                id = pickId(rng);
+            }
+            db.get_decrypted_passwords_(batchIds, key, batchPasswords);
+        }));
+
+        if (readers > 0) {
+            // Поиск паролей из нескольких потоков через пул читателей
+            std::vector<std::mt19937> threadRngs;
+            for (int t = 0; t < readers; ++t) {
+                threadRngs.emplace_back(1000 + t);
+            }
+            results.push_back(measure_parallel("get_decrypted_password_x" + std::to_string(readers), vaultSize,
+                                               ops, static_cast<size_t>(readers), [&](size_t t, size_t) {
+                db.get_decrypted_password_(pickId(threadRngs[t]), key);
+            }));
+        }
+
+        results.push_back(measure("search_entries_", vaultSize, std::max<size_t>(ops / 10, 10), [&](size_t) {
+            db.search_entries_("site " + std::to_string(pickId(rng) - 1));
+        }));
+
+        results.push_back(measure("update_entry_", vaultSize, std::max<size_t>(ops / 10, 10), [&](size_t i) {
+            db.update_entry_(pickId(rng), "", "", "", "", "updated note " + std::to_string(i), key);
+        }));
+
+        results.push_back(measure("add_entry_", vaultSize, std::max<size_t>(ops / 10, 10), [&](size_t i) {
+            std::string n = std::to_string(i);
+            db.add_entry_("Bench " + n, "bench" + n + ".example.com", "bench", "pw" + n, "", key);
+        }));
+
+        // Снимок: открытие (mmap без разбора) и чтение прямо из отображения
+        std::string snapshotPath = (dir / "passwords.snap").string();
+        if (db.export_snapshot_(snapshotPath)) {
+            results.push_back(measure("snapshot_open", vaultSize, 100, [&](size_t) {
+                database_t snapshot(storage_profile_t::snapshot_(snapshotPath));
+                snapshot.init_database_();
+            }));
+
+            database_t snapshot(storage_profile_t::snapshot_(snapshotPath));
+            results.push_back(measure("snapshot_get_entry_by_id_", vaultSize, ops, [&](size_t) {
+                snapshot.get_entry_by_id_(pickId(rng));
+            }));
+            results.push_back(measure("snapshot_search_entries_", vaultSize, std::max<size_t>(ops / 10, 10),
+                                      [&](size_t) {
+                snapshot.search_entries_("site " + std::to_string(pickId(rng) - 1));
+            }));
+        }
+
+        // Колоночное хранилище в памяти: поиск подстроки SIMD-ядром (search-as-you-type)
+        {
+            database_t columns(profile);
+            columns.init_database_();
+            results.push_back(measure("load_column_store_", vaultSize, 1, [&](size_t) {
+                columns.load_column_store_();
+            }));
+            size_t matches = 0;
+            results.push_back(measure("column_for_each_entry_", vaultSize, std::max<size_t>(ops / 10, 10),
+                                      [&](size_t) {
+                columns.for_each_entry_("SITE" + std::to_string(pickId(rng) - 1) + ".",
+                                        [&](const password_entry_view_t&) { ++matches; });
+            }));
+            std::cerr << "vault " << vaultSize << ": column search via " << text_search_isa() << "\n";
+
+            // Нечёткий поиск с ранжированием: первый вызов строит индекс, дальше - запрос
+            // с переставленными буквами (ищется только как опечатка)
+            entry_result_set_t ranked;
+            results.push_back(measure("search_ranked_index", vaultSize, 1, [&](size_t) {
+                columns.search_ranked_("site", 20, ranked);
+            }));
+            results.push_back(measure("search_ranked_", vaultSize, std::max<size_t>(ops / 10, 10), [&](size_t) {
+                columns.search_ranked_("stie" + std::to_string(pickId(rng) - 1), 20, ranked);
+            }));
+        }
+
+        if (cacheSize > 0) {
+            cache_stats_t stats = db.cache_stats_();
+            std::cerr << "vault " << vaultSize << ": cache hits " << stats.m_hits << ", misses " << stats.m_misses
+                      << ", secret hits " << stats.m_secretHits << ", evictions " << stats.m_evictions << "\n";
+        }
+    }
+
+    fs::remove_all(dir);
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+    size_t ops = 10000;
+    std::string outPath;
+    bool sqliteDefaults = false;
+    int readers = 0;
+    size_t cacheSize = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes = parse_sizes(argv[++i]);
+        } else if (arg == "--ops" && i + 1 < argc) {
+            ops = std::max<size_t>(std::stoul(argv[++i]), 1);
+        } else if (arg == "--sqlite-defaults") {
+            sqliteDefaults = true;
+        } else if (arg == "--readers" && i + 1 < argc) {
+            readers = std::max(std::stoi(argv[++i]), 0);
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cacheSize = std::stoul(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    std::vector<bench_result_t> results;
+    bench_crypto(ops, results);
+    for (size_t size : sizes) {
+        bench_database(size, ops, sqliteDefaults, readers, cacheSize, results);
+    }
+
+    if (outPath.empty()) {
+        write_json(std::cout, results);
+    } else {
+        std::ofstream out(outPath);
+        if (!out) {
+            std::cerr << "Could not write " << outPath << "\n";
+            return 1;
+        }
+        write_json(out, results);
+    }
+    return 0;
+}
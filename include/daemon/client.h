@@ -0,0 +1,57 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include "daemon/protocol.h"
+#include "database/database.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Синхронный клиент демона (см. daemon_t и protocol.h).
+ *        Одно соединение на объект; запросы выполняются последовательно.
+ */
+class daemon_client_t {
+private:
+    int m_fd;
+
+    /**
+     * @brief Отправляет кадр запроса и читает тело ответа.
+     */
+    bool round_trip_(std::vector<unsigned char> request, std::vector<unsigned char>& response);
+
+public:
+    daemon_client_t();
+    ~daemon_client_t();
+
+    daemon_client_t(const daemon_client_t&) = delete;
+    daemon_client_t& operator=(const daemon_client_t&) = delete;
+
+    bool connect_(const std::string& socketPath);
+
+    /**
+     * @brief Запись по ID вместе с расшифрованным паролем
+     *        (m_encryptedPassword в entry не заполняется).
+     */
+    status_t get_(int id, password_entry_t& entry, std::string& password);
+
+    /**
+     * @brief Несколько записей с паролями за один запрос (не больше c_max_batch_ids).
+     *        Отсутствующие ID пропускаются; passwords[i] - пароль entries[i].
+     */
+    status_t get_many_(const std::vector<int>& ids,
+                       std::vector<password_entry_t>& entries,
+                       std::vector<std::string>& passwords);
+
+    /**
+     * @brief Поиск по метаданным (без паролей), не больше limit записей.
+     */
+    status_t search_(const std::string& query, uint32_t limit, std::vector<password_entry_t>& entries);
+
+    status_t add_(const std::string& title,
+                  const std::string& url,
+                  const std::string& username,
+                  const std::string& password,
+                  const std::string& notes);
+};
+
+#endif // CLIENT_H
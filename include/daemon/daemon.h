@@ -0,0 +1,73 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "database/database.h"
+#include "encryption/encryption.h"
+#include "encryption/session_key.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Демон поиска учётных данных на Unix-сокете.
+ *
+ * Хранилище разблокируется один раз при запуске; дальше запросы get/search/add
+ * (см. protocol.h) обслуживаются одним потоком с циклом epoll на тёплом
+ * database_t и готовом ключе. Сокет создаётся с правами 0600, кроме того,
+ * принимаются только клиенты с тем же UID (SO_PEERCRED).
+ * run_() работает до SIGINT/SIGTERM.
+ */
+class daemon_t {
+private:
+    /**
+     * @brief Состояние одного клиента: недочитанные кадры и неотправленные ответы.
+     */
+    struct client_t {
+        int m_fd;
+        std::vector<unsigned char> m_in;
+        std::vector<unsigned char> m_out;
+        size_t m_outPos;
+        bool m_wantWrite; // подписан ли на EPOLLOUT
+    };
+
+    database_t& m_db;
+    const session_key_t& m_key;
+    encryption_t m_encryption;
+    cipher_context_t m_ctx; // цикл событий однопоточный - один контекст на все запросы
+    std::string m_socketPath;
+
+    int m_listenFd;
+    int m_epollFd;
+    int m_signalFd;
+    std::unordered_map<int, client_t> m_clients;
+
+    bool listen_();
+    void accept_clients_();
+    bool read_client_(client_t& client);
+    bool flush_client_(client_t& client);
+    void close_client_(int fd);
+
+    /**
+     * @brief Выполняет один запрос и дописывает кадр ответа в out.
+     */
+    void handle_request_(const unsigned char* body, size_t size, std::vector<unsigned char>& out);
+
+public:
+    /**
+     * @param db Инициализированное хранилище (init_database_ уже вызван)
+     * @param key Ключ сессии; должен жить дольше демона
+     */
+    daemon_t(database_t& db, const session_key_t& key, const std::string& socketPath);
+    ~daemon_t();
+
+    daemon_t(const daemon_t&) = delete;
+    daemon_t& operator=(const daemon_t&) = delete;
+
+    /**
+     * @brief Открывает сокет и обслуживает клиентов до сигнала завершения.
+     * @return false, если сокет не удалось открыть
+     */
+    bool run_();
+};
+
+#endif // DAEMON_H
@@ -0,0 +1,98 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Бинарный протокол демона (все целые - little-endian).
+ *
+ * Кадр: [u32 длина тела][тело]. Тело запроса начинается с кода операции (u8),
+ * тело ответа - с кода статуса (u8). Строки передаются как [u32 длина][байты].
+ *
+ *   get    (u32 id)                    -> u32 id, title, url, username, password, notes
+ *   search (str query, u32 limit)      -> u32 n, n x (u32 id, title, url, username, notes)
+ *   add    (str title, url, username, password, notes) -> пустое тело
+ *   get_many (u32 n, n x u32 id)       -> u32 n, n x (u32 id, title, url, username, password, notes)
+ *                                         (только найденные записи, в порядке запроса;
+ *                                         если хоть один пароль не расшифровался -
+ *                                         status_t::error для всего запроса, как у get)
+ */
+enum class opcode_t : uint8_t {
+    get = 1,
+    search = 2,
+    add = 3,
+    get_many = 4
+};
+
+enum class status_t : uint8_t {
+    ok = 0,
+    not_found = 1,
+    bad_request = 2,
+    error = 3
+};
+
+const size_t c_frame_header_size = 4;
+const uint32_t c_max_frame_size = 1u << 20;  // в обе стороны; запрос больше - разрыв соединения,
+                                             // ответ больше - status_t::error
+const uint32_t c_max_search_results = 1000;  // верхняя граница limit в search
+const uint32_t c_max_batch_ids = 1000;       // верхняя граница n в get_many
+
+/**
+ * @brief Собирает тело кадра; finish_() дописывает заголовок с длиной.
+ */
+class frame_writer_t {
+private:
+    std::vector<unsigned char> m_buf;
+
+public:
+    frame_writer_t();
+
+    void put_u8_(uint8_t value);
+
+    /**
+     * @return Смещение записанного значения (для последующего set_u32_)
+     */
+    size_t put_u32_(uint32_t value);
+    void put_string_(std::string_view value);
+
+    /**
+     * @brief Перезаписывает ранее добавленное значение (например, счётчик записей).
+     */
+    void set_u32_(size_t offset, uint32_t value);
+
+    /**
+     * @brief Готовый кадр (заголовок + тело); writer после вызова пуст.
+     */
+    std::vector<unsigned char> finish_();
+};
+
+/**
+ * @brief Последовательно разбирает тело кадра; при выходе за границу
+ *        все get_ возвращают false.
+ */
+class frame_reader_t {
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    size_t m_pos;
+
+public:
+    frame_reader_t(const unsigned char* data, size_t size);
+
+    bool get_u8_(uint8_t& value);
+    bool get_u32_(uint32_t& value);
+    bool get_string_(std::string& value);
+
+    bool at_end_() const { return m_pos == m_size; }
+};
+
+/**
+ * @brief Читает u32 little-endian (например, длину тела из заголовка кадра).
+ */
+uint32_t read_u32_le(const unsigned char* data);
+
+#endif // PROTOCOL_H
@@ -0,0 +1,214 @@
+#ifndef ASYNC_DATABASE_H
+#define ASYNC_DATABASE_H
+
+#include "database/database.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Результат асинхронной операции async_database_t: std::future и флаг отмены.
+ *
+ * cancel_() только просит остановиться. Операции с точками отмены (поиск,
+ * смена мастер-пароля) прерываются на ближайшей из них и сообщают об этом
+ * своим результатом; операция, отменённая до начала, не выполняется вовсе,
+ * и future получает значение по умолчанию (false, nullptr, пустой ключ).
+ */
+template <typename T>
+class pending_t {
+public:
+    pending_t() = default;
+    pending_t(std::future<T> future, std::shared_ptr<std::atomic<bool>> cancelled)
+        : m_future(std::move(future)), m_cancelled(std::move(cancelled)) {}
+
+    bool valid_() const { return m_future.valid(); }
+
+    /**
+     * @brief Ждёт не дольше timeout.
+     * @return true, если результат готов
+     */
+    bool wait_for_(std::chrono::milliseconds timeout) const {
+        return m_future.wait_for(timeout) == std::future_status::ready;
+    }
+
+    /**
+     * @brief Результат (блокирует до готовности); вызывается один раз.
+     */
+    T get_() { return m_future.get(); }
+
+    void cancel_() { m_cancelled->store(true); }
+    bool cancelled_() const { return m_cancelled->load(); }
+
+private:
+    std::future<T> m_future;
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
+/**
+ * @brief Асинхронный фасад над database_t: операции ставятся в очередь и по
+ *        одной выполняются отдельным потоком-исполнителем, вызывающий сразу
+ *        получает pending_t и может продолжать рисовать интерфейс и читать ввод.
+ *
+ * Операции выполняются в порядке постановки. Аргументы, переданные по ссылке
+ * (ключи сессии, колбэки), должны жить, пока результат не готов; строки и
+ * списки ID копируются. Пароли в аргументах затираются, когда задача
+ * уничтожается, - и после выполнения, и если её отменили до начала. Колбэки
+ * прогресса вызываются в потоке исполнителя. database_t при этом остаётся
+ * доступен и напрямую: его публичные методы потокобезопасны.
+ * Деструктор отменяет всё, что стоит в очереди и выполняется, и ждёт исполнителя.
+ */
+class async_database_t {
+public:
+    explicit async_database_t(database_t& db);
+    ~async_database_t();
+
+    async_database_t(const async_database_t&) = delete;
+    async_database_t& operator=(const async_database_t&) = delete;
+
+    /**
+     * @brief Ставит в очередь произвольную операцию task(db, cancelled) -> T.
+     *        task может быть только перемещаемым (например, владеть unique_ptr).
+     */
+    template <typename F>
+    auto submit_(F task) -> pending_t<std::invoke_result_t<F&, database_t&, const std::atomic<bool>&>>;
+
+    /**
+     * @brief database_t::search_ranked_ в исполнителе.
+     * @return Результаты или nullptr при ошибке и отмене
+     */
+    pending_t<std::shared_ptr<const entry_result_set_t>> search_ranked_(const std::string& query, size_t limit);
+
+    /**
+     * @brief database_t::get_entry_by_id_ в исполнителе (m_id = 0, если записи нет).
+     */
+    pending_t<password_entry_t> get_entry_by_id_(int id);
+
+    /**
+     * @brief database_t::get_entries_by_ids_ в исполнителе.
+     * @return Записи в порядке ids или nullptr при ошибке и отмене
+     */
+    pending_t<std::shared_ptr<const std::vector<password_entry_t>>> get_entries_by_ids_(std::vector<int> ids);
+
+    /**
+     * @brief database_t::get_decrypted_passwords_ в исполнителе.
+     * @return Пароли в порядке ids (затирает вызывающий) или nullptr при ошибке и отмене
+     */
+    pending_t<std::shared_ptr<std::vector<std::string>>> get_decrypted_passwords_(std::vector<int> ids,
+                                                                                  const session_key_t& key);
+
+    /**
+     * @brief database_t::add_entry_ в исполнителе.
+     */
+    pending_t<bool> add_entry_(std::string title,
+                               std::string url,
+                               std::string username,
+                               std::string password,
+                               std::string notes,
+                               const session_key_t& key);
+
+    /**
+     * @brief database_t::update_fields_ в исполнителе.
+     */
+    pending_t<bool> update_fields_(int id, entry_update_t update, const session_key_t& key);
+
+    /**
+     * @brief database_t::delete_entry_ в исполнителе.
+     */
+    pending_t<bool> delete_entry_(int id);
+
+    /**
+     * @brief database_t::import_entries_ в исполнителе; источник принадлежит
+     *        задаче. Отмена возможна только до начала (m_ok = false).
+     */
+    pending_t<import_result_t> import_entries_(std::unique_ptr<entry_reader_t> reader,
+                                               const session_key_t& key,
+                                               size_t batchSize = 1000);
+
+    /**
+     * @brief database_t::export_snapshot_ в исполнителе.
+     */
+    pending_t<bool> export_snapshot_(std::string path);
+
+    /**
+     * @brief Вывод ключа из мастер-пароля (session_key_t::derive_); пароль
+     *        затирается вместе с задачей. Отмена возможна только до начала.
+     */
+    pending_t<session_key_t> derive_key_(std::string masterPassword, const kdf_params_t& params);
+
+    /**
+     * @brief database_t::rekey_ в исполнителе. Отмена останавливает смену после
+     *        текущего пакета; повторный вызов продолжает с маркера.
+     */
+    pending_t<bool> rekey_(const session_key_t& oldKey,
+                           const session_key_t& newKey,
+                           size_t chunkSize,
+                           rekey_callback_t progress,
+                           const kdf_params_t* newParams);
+
+    /**
+     * @brief database_t::rollback_rekey_ в исполнителе; отмены нет - откат
+     *        доводится до конца.
+     */
+    pending_t<bool> rollback_rekey_(const session_key_t& oldKey,
+                                    const session_key_t& newKey,
+                                    size_t chunkSize,
+                                    rekey_callback_t progress);
+
+    /**
+     * @brief Число операций в очереди (без выполняющейся).
+     */
+    size_t queued_() const;
+
+private:
+    struct task_t {
+        std::shared_ptr<std::atomic<bool>> m_cancelled;
+        std::function<void()> m_run;
+    };
+
+    database_t& m_db;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::deque<task_t> m_queue;
+    std::shared_ptr<std::atomic<bool>> m_running; // флаг выполняющейся операции, под m_mutex
+    bool m_stop;
+    std::thread m_worker;
+
+    void enqueue_(task_t task);
+    void run_();
+};
+
+template <typename F>
+auto async_database_t::submit_(F task)
+    -> pending_t<std::invoke_result_t<F&, database_t&, const std::atomic<bool>&>> {
+    using result_t = std::invoke_result_t<F&, database_t&, const std::atomic<bool>&>;
+
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    auto promise = std::make_shared<std::promise<result_t>>();
+    std::future<result_t> future = promise->get_future();
+
+    // std::function требует копируемости - сама операция живёт в shared_ptr
+    auto shared = std::make_shared<F>(std::move(task));
+    enqueue_({cancelled, [this, shared, promise, cancelled] {
+        const std::atomic<bool>& flag = *cancelled;
+        if constexpr (std::is_void_v<result_t>) {
+            if (!flag) {
+                (*shared)(m_db, flag);
+            }
+            promise->set_value();
+        } else {
+            promise->set_value(flag ? result_t() : (*shared)(m_db, flag));
+        }
+    }});
+    return pending_t<result_t>(std::move(future), std::move(cancelled));
+}
+
+#endif // ASYNC_DATABASE_H
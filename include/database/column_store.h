@@ -0,0 +1,90 @@
+#ifndef COLUMN_STORE_H
+#define COLUMN_STORE_H
+
+#include "database/database.h"
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Записи хранилища в памяти по колонкам.
+ *
+ * Каждое поле (title, url, username, notes и зашифрованный пароль) лежит в
+ * своём непрерывном буфере, строка i занимает [offsets[i], offsets[i + 1]).
+ * Поиск прогоняет SIMD-ядро find_folded по целым колонкам, а не по строкам,
+ * и переводит позиции совпадений в номера строк по массиву смещений.
+ *
+ * Удалённые и изменённые строки помечаются мёртвыми (изменённая дописывается
+ * в конец), а когда мёртвых становится больше живых, колонки пересобираются.
+ * Потокобезопасен: поиск под разделяемой блокировкой, изменения - под
+ * исключительной; посетители не должны менять хранилище.
+ */
+class column_store_t {
+private:
+    enum field_t { c_title, c_url, c_username, c_notes, c_password, c_field_count };
+
+    struct column_t {
+        std::vector<char> m_data;
+        std::vector<size_t> m_offsets{0}; // rows + 1 элементов
+    };
+
+    mutable std::shared_mutex m_mutex;
+    column_t m_columns[c_field_count];
+    std::vector<int> m_ids;
+    std::vector<uint8_t> m_alive;
+    std::unordered_map<int, size_t> m_rowById; // только живые строки
+    size_t m_dead;
+    bool m_ordered; // строки идут по возрастанию ID
+
+    void append_row_(const password_entry_view_t& view);
+    bool remove_row_(int id);
+    void compact_();
+    password_entry_view_t view_(size_t row) const;
+
+    /**
+     * @brief Отмечает в matched строки, где в колонке field есть foldedQuery.
+     * @return false, если поиск отменён
+     */
+    bool scan_column_(field_t field, const std::string& foldedQuery, std::vector<uint8_t>& matched,
+                      const std::atomic<bool>* cancelled) const;
+
+public:
+    column_store_t();
+
+    column_store_t(const column_store_t&) = delete;
+    column_store_t& operator=(const column_store_t&) = delete;
+
+    /**
+     * @brief Добавляет запись (view должен содержать зашифрованный пароль).
+     */
+    void append_(const password_entry_view_t& view);
+
+    /**
+     * @brief Заменяет запись с тем же ID (или добавляет, если её нет).
+     */
+    void replace_(const password_entry_view_t& view);
+
+    bool remove_(int id);
+
+    /**
+     * @brief Забирает содержимое other (пересобранного целиком) под одной блокировкой.
+     */
+    void swap_(column_store_t& other);
+
+    size_t size_() const;
+
+    /**
+     * @brief Записи, где query - подстрока title/url/username/notes без учёта
+     *        регистра ASCII; '%' и '_' в query - обычные символы (SQL-путь
+     *        экранирует их в LIKE). Пустой запрос - все записи. По возрастанию ID.
+     * @param cancelled Если задан и стал true, обход прерывается
+     * @return false, если обход прерван
+     */
+    bool for_each_(const std::string& query, const entry_visitor_t& visitor,
+                   const std::atomic<bool>* cancelled = nullptr) const;
+};
+
+#endif // COLUMN_STORE_H
@@ -0,0 +1,121 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include "database/storage_profile.h"
+#include <sqlite3.h>
+
+/**
+ * @brief Идентификаторы запросов в кеше подготовленных выражений.
+ */
+enum statement_id_t {
+    c_stmt_insert,
+    c_stmt_search,
+    c_stmt_delete,
+    c_stmt_get_password,
+    c_stmt_get_by_id,
+    c_stmt_list_all,
+    c_stmt_search_fts,
+    c_stmt_rekey_select,
+    c_stmt_update_password,
+    c_stmt_rekey_mark,
+    c_stmt_rekey_state,
+    c_stmt_page_all,
+    c_stmt_page_search,
+    c_stmt_page_fts,
+    c_stmt_count_legacy,
+    c_stmt_header_select,
+    c_stmt_header_upsert,
+    c_stmt_has_entries,
+    c_stmt_get_by_ids,
+    c_stmt_get_passwords,
+    c_stmt_first_gcm,
+    c_stmt_rekey_select_back,
+    c_stmt_rekey_count,
+    c_stmt_rekey_count_back,
+    c_stmt_key_check_select,
+    c_stmt_key_check_update,
+    c_stmt_count
+};
+
+/**
+ * @brief Поля записи для частичного обновления (битовая маска).
+ */
+enum entry_field_t : unsigned {
+    c_field_title = 1u << 0,
+    c_field_url = 1u << 1,
+    c_field_username = 1u << 2,
+    c_field_password = 1u << 3,
+    c_field_notes = 1u << 4,
+    c_field_all = (1u << 5) - 1
+};
+
+/**
+ * @brief Одно соединение SQLite со своим набором подготовленных выражений.
+ *
+ * Соединение не потокобезопасно само по себе (открывается с SQLITE_OPEN_NOMUTEX):
+ * database_t гарантирует, что им пользуется не более одного потока за раз.
+ */
+class connection_t {
+private:
+    sqlite3* m_db;
+    sqlite3_stmt* m_statements[c_stmt_count];
+    sqlite3_stmt* m_updateStatements[c_field_all + 1]; // по маске полей, готовятся при первом вызове
+
+    bool apply_profile_(const storage_profile_t& profile, bool readOnly);
+
+public:
+    connection_t();
+    ~connection_t();
+
+    connection_t(const connection_t&) = delete;
+    connection_t& operator=(const connection_t&) = delete;
+
+    /**
+     * @brief Открывает файл хранилища и применяет PRAGMA профиля.
+     * @param readOnly Соединение только для чтения (для пула читателей)
+     */
+    bool open_(const storage_profile_t& profile, bool readOnly);
+
+    /**
+     * @brief Готовит все выражения; выражения над passwords_fts - только если withFts.
+     */
+    bool prepare_statements_(bool withFts);
+    void finalize_statements_();
+
+    /**
+     * @brief Возвращает закешированное выражение или nullptr (с сообщением в stderr),
+     *        если init_database_ не был вызван или подготовка не удалась.
+     */
+    sqlite3_stmt* statement_(statement_id_t id, const char* what);
+
+    /**
+     * @brief UPDATE только полей из маски fields (непустой):
+     *        SET title = ?1, url = ?2, username = ?3, password = ?4, notes = ?5
+     *        (в SET входят лишь выбранные), WHERE id = ?6, RETURNING всю запись.
+     * @return nullptr при ошибке подготовки
+     */
+    sqlite3_stmt* update_statement_(unsigned fields);
+
+    bool exec_(const char* sql, const char* what);
+
+    /**
+     * @brief Переносит в метрики попадания и промахи кеша страниц с прошлого
+     *        вызова (счётчики соединения при этом обнуляются).
+     */
+    void flush_cache_metrics_();
+
+    sqlite3* handle_() const { return m_db; }
+    const char* errmsg_() const { return sqlite3_errmsg(m_db); }
+};
+
+/**
+ * @brief sqlite3_prepare_v2 с замером времени (metrics.h).
+ */
+int prepare_statement(sqlite3* db, const char* sql, sqlite3_stmt** stmt);
+
+/**
+ * @brief sqlite3_step с замером времени (metrics.h).
+ */
+int step_statement(sqlite3_stmt* stmt);
+
+#endif // CONNECTION_H
@@ -0,0 +1,46 @@
+#ifndef CURSOR_H
+#define CURSOR_H
+
+#include "database/database.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Постраничный курсор по результатам поиска (пагинация по ключу id).
+ *
+ * В памяти держится только текущая страница, поэтому просмотр даже очень
+ * большого хранилища начинается сразу и не зависит от его размера.
+ * Записи страницы содержат только метаданные (без зашифрованного пароля).
+ */
+class entry_cursor_t {
+private:
+    database_t& m_db;
+    std::string m_query;
+    size_t m_pageSize;
+    int m_lastId;
+    bool m_finished;
+
+public:
+    entry_cursor_t(database_t& db, const std::string& query, size_t pageSize = 20);
+
+    /**
+     * @brief Читает следующую страницу в page (содержимое заменяется).
+     * @return false, если записей больше нет (page при этом пуст)
+     */
+    bool next_page_(std::vector<password_entry_t>& page);
+
+    /**
+     * @brief Обходит следующую страницу без копирования строк (см. password_entry_view_t).
+     * @return Число записей на странице; 0, если записей больше нет
+     */
+    size_t next_page_(const entry_visitor_t& visitor);
+
+    /**
+     * @brief Возвращает курсор к началу результатов.
+     */
+    void rewind_();
+
+    bool finished_() const { return m_finished; }
+};
+
+#endif // CURSOR_H
@@ -2,8 +2,23 @@
 #define DATABASE_H
 
 #include "encryption/encryption.h"
+#include "encryption/session_key.h"
+#include "encryption/crypto_pool.h"
+#include "encryption/kdf.h"
+#include "database/import.h"
+#include "database/result_set.h"
+#include "database/storage_profile.h"
+#include "database/connection.h"
 #include <vector>
 #include <string>
+#include <functional>
+#include <string_view>
+#include <chrono>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
 #include <sqlite3.h>
 
 /**
@@ -18,15 +33,189 @@ struct password_entry_t {
     std::string m_notes;
 };
 
+/**
+ * @brief Запись без копирования: поля указывают прямо в буферы SQLite.
+ *
+ * Действительна только внутри вызова посетителя (до следующего sqlite3_step),
+ * после этого указатели становятся недействительными. Для сохранения записи
+ * используйте to_entry_().
+ */
+struct password_entry_view_t {
+    int m_id;
+    std::string_view m_title;
+    std::string_view m_url;
+    std::string_view m_username;
+    const unsigned char* m_encryptedPassword; // nullptr в проекциях без пароля
+    size_t m_encryptedSize;
+    std::string_view m_notes;
+
+    /**
+     * @brief Копирует представление в собственную запись (переиспользуя её буферы).
+     */
+    void to_entry_(password_entry_t& entry) const;
+
+    /**
+     * @brief Представление над уже загруженной записью.
+     */
+    static password_entry_view_t of_(const password_entry_t& entry);
+    static password_entry_view_t of_(const pmr_password_entry_t& entry);
+};
+
+using entry_visitor_t = std::function<void(const password_entry_view_t&)>;
+
+/**
+ * @brief Изменения записи для database_t::update_fields_.
+ */
+struct entry_update_t {
+    unsigned m_fields;      // маска entry_field_t: какие поля менять
+    std::string m_title;
+    std::string m_url;
+    std::string m_username;
+    std::string m_password; // открытый текст, шифруется ключом сессии
+    std::string m_notes;
+};
+
+/**
+ * @brief Прогресс смены мастер-пароля (передаётся в колбэк после каждого пакета).
+ */
+struct rekey_progress_t {
+    size_t m_processed; // перешифровано записей в этом запуске
+    size_t m_total;     // всего записей осталось на момент запуска
+    int m_lastId;       // последний перешифрованный ID (маркер для возобновления)
+};
+
+using rekey_callback_t = std::function<void(const rekey_progress_t&)>;
+
+/**
+ * @brief Результат проверки мастер-пароля (см. database_t::verify_key_).
+ */
+enum class key_check_t {
+    match,    // ключ подтверждён контрольным значением или тегом GCM
+    mismatch, // ключ неверный
+    unknown   // проверить нечем: нет контрольного значения и блоков GCM
+};
+
+/**
+ * @brief Счётчики кеша записей (см. database_t::enable_cache_).
+ */
+struct cache_stats_t {
+    uint64_t m_hits;         // записи, найденные в кеше
+    uint64_t m_misses;       // записи, прочитанные из SQLite
+    uint64_t m_secretHits;   // пароли, взятые из кеша без расшифровки
+    uint64_t m_secretMisses;
+    uint64_t m_evictions;    // вытеснено по LRU
+    size_t m_size;           // записей в кеше сейчас
+};
+
+class entry_cache_t;
+class snapshot_t;
+class column_store_t;
+class fuzzy_index_t;
+
+/**
+ * @brief Хранилище паролей поверх SQLite.
+ *
+ * Публичные методы можно вызывать из нескольких потоков одновременно: запись
+ * идёт через одно соединение-писатель под мьютексом, а чтение - через пул
+ * соединений только для чтения (storage_profile_t::m_readConnections), каждое
+ * со своими подготовленными выражениями. Без пула все вызовы сериализуются
+ * на писателе. Посетители (entry_visitor_t) вызываются, пока соединение занято,
+ * поэтому они не должны обращаться к тому же database_t.
+ *
+ * С профилем storage_profile_t::snapshot_ хранилище открывается из снимка
+ * (export_snapshot_) без SQLite: чтение идёт прямо из отображения файла,
+ * а изменяющие методы печатают ошибку и возвращают false.
+ */
 class database_t {
 private:
-    sqlite3* m_db;
+    /**
+     * @brief Захват соединения на время одного вызова: писателя - для записи
+     *        (или если пула нет), иначе - свободного читателя из пула.
+     */
+    class lease_t {
+    private:
+        database_t& m_owner;
+        connection_t* m_conn;
+        std::unique_lock<std::mutex> m_writerLock;
+
+    public:
+        lease_t(database_t& owner, bool forWrite);
+        ~lease_t();
+
+        lease_t(const lease_t&) = delete;
+        lease_t& operator=(const lease_t&) = delete;
+
+        connection_t& conn() { return *m_conn; }
+    };
+
+    storage_profile_t m_profile;
     encryption_t m_encryption;
+    crypto_pool_t m_cryptoPool; // пакетное (многопоточное) шифрование
+    connection_t m_writer;      // единственное соединение с правом записи
+    std::vector<std::unique_ptr<connection_t>> m_readers;
+    std::vector<connection_t*> m_idleReaders; // свободные читатели, под m_poolMutex
+    std::mutex m_writerMutex;
+    std::mutex m_poolMutex;
+    std::condition_variable m_readerReleased;
+    bool m_ftsEnabled; // есть ли полнотекстовый индекс passwords_fts
+    std::unique_ptr<entry_cache_t> m_cache; // nullptr, если кеш выключен
+    std::unique_ptr<snapshot_t> m_snapshot; // не nullptr - хранилище открыто из снимка
+    std::unique_ptr<column_store_t> m_columns; // nullptr, пока не вызван load_column_store_
+    std::shared_ptr<const fuzzy_index_t> m_fuzzy; // nullptr - построить заново, под m_fuzzyMutex
+    uint64_t m_fuzzyGeneration; // растёт при каждом сбросе индекса, под m_fuzzyMutex
+    std::mutex m_fuzzyMutex;
+
+    bool init_fts_index_(connection_t& conn);
+    void open_readers_();
+    bool visit_rows_(sqlite3_stmt* stmt, bool withPassword, const entry_visitor_t& visitor,
+                     const std::atomic<bool>* cancelled = nullptr);
+    bool rekey_state_(connection_t& conn, int* lastId);
+    key_check_t check_key_(connection_t& conn, const session_key_t& key, int afterId);
+
+    /**
+     * @brief Сбрасывает индекс нечёткого поиска после изменения записей.
+     *        Вызывается под арендой писателя, поэтому m_fuzzyMutex никогда не
+     *        удерживается во время чтения базы (см. search_ranked_).
+     */
+    void invalidate_fuzzy_();
+
+    /**
+     * @brief Для снимка печатает, что операция what недоступна.
+     * @return true, если хранилище только для чтения
+     */
+    bool reject_write_(const char* what) const;
+
+    /**
+     * @brief Перечитывает колоночное хранилище целиком через conn (под захватом писателя).
+     */
+    void reload_columns_(connection_t& conn);
+
+    bool insert_entry_(connection_t& conn,
+                       const std::string& title,
+                       const std::string& url,
+                       const std::string& username,
+                       const std::vector<unsigned char>& encryptedPassword,
+                       const std::string& notes);
 
 public:
+    /**
+     * @brief Открывает passwords.db в текущем каталоге с профилем по умолчанию.
+     */
     database_t();
+
+    /**
+     * @brief Открывает хранилище по пути и с PRAGMA из профиля.
+     */
+    explicit database_t(const storage_profile_t& profile);
     ~database_t();
 
+    database_t(const database_t&) = delete;
+    database_t& operator=(const database_t&) = delete;
+
+    /**
+     * @brief Создаёт таблицы и подготавливает все SQL-выражения.
+     *        Должна быть вызвана до остальных методов.
+     */
     void init_database_();
 
     bool add_entry_(const std::string& title,
@@ -34,21 +223,84 @@ public:
                     const std::string& username,
                     const std::string& password,
                     const std::string& notes,
-                    const std::string& masterPassword);
+                    const session_key_t& key);
+
+    /**
+     * @brief Массовый импорт записей из потокового источника.
+     *
+     * Все строки вставляются одним подготовленным INSERT в явных транзакциях,
+     * фиксируемых каждые batchSize строк (один fsync на пакет, а не на запись).
+     * При ошибке разбора уже вставленные строки фиксируются, а в результате
+     * возвращается m_ok = false и текст ошибки.
+     */
+    import_result_t import_entries_(entry_reader_t& reader,
+                                    const session_key_t& key,
+                                    size_t batchSize = 1000);
+
+    /**
+     * @brief Ищет записи по title/url/username/notes.
+     *
+     * Каждое слово запроса ищется как префикс токена по индексу FTS5 (все слова
+     * должны присутствовать), результаты упорядочены по релевантности (bm25,
+     * совпадения в title и url весят больше). Пустой запрос возвращает все записи.
+     * Если FTS5 недоступен или в запросе нет индексируемых слов, выполняется
+     * поиск подстроки через LIKE.
+     */
+    std::vector<password_entry_t> search_entries_(const std::string& query);
+
+    /**
+     * @brief То же, что search_entries_, но записи размещаются в арене results
+     *        (предыдущее содержимое results освобождается).
+     * @return false при ошибке SQLite
+     */
+    bool search_entries_(const std::string& query, entry_result_set_t& results);
+
+    /**
+     * @brief То же, что search_entries_, но без копирования строк:
+     *        visitor получает представление каждой найденной записи.
+     * @param cancelled Если задан, обход прекращается, как только он станет true
+     *        (например, пользователь уже ввёл следующий запрос)
+     * @return false при ошибке SQLite или отмене
+     */
+    bool for_each_entry_(const std::string& query, const entry_visitor_t& visitor,
+                         const std::atomic<bool>* cancelled = nullptr);
 
-    std::vector<password_entry_t> search_entries_(const std::string& query,
-                                                  const std::string& masterPassword);
+    /**
+     * @brief Ищет ли for_each_entry_ подстроку без учёта регистра ASCII (колоночное
+     *        хранилище, снимок, LIKE), а не токены FTS. Тогда результаты запроса,
+     *        содержащего предыдущий, - подмножество предыдущих.
+     */
+    bool substring_search_() const { return m_columns != nullptr || !m_ftsEnabled; }
+
+    /**
+     * @brief Нечёткий поиск с ранжированием (fuzzy_search.h): подстроки,
+     *        подпоследовательности ("gh" -> GitHub) и слова с опечатками
+     *        ("gihtub" -> GitHub); совпадения в title и url весят больше.
+     *
+     * Индекс строится из всех записей при первом вызове и после любого
+     * изменения хранилища. Читаются только метаданные: m_encryptedPassword
+     * в результатах пуст.
+     * @param limit Сколько лучших записей вернуть (по убыванию оценки)
+     * @param cancelled Если задан и стал true, поиск прерывается
+     * @return false при ошибке чтения или отмене
+     */
+    bool search_ranked_(const std::string& query, size_t limit, entry_result_set_t& results,
+                        const std::atomic<bool>* cancelled = nullptr);
 
     bool delete_entry_(int id);
 
     /**
      * @brief Возвращает расшифрованный пароль для записи с указанным ID.
+     *        При включённом кеше паролей (enable_cache_) повторный вызов в пределах
+     *        TTL не обращается к базе; кеш не различает ключи - он рассчитан на
+     *        один ключ сессии.
+     * @param key Ключ сессии, полученный при разблокировке хранилища
      */
-    std::string get_decrypted_password_(int id, const std::string& masterPassword);
+    std::string get_decrypted_password_(int id, const session_key_t& key);
 
     /**
      * @brief Обновляет запись (title, url, username, password, notes)
-     *        Если поле пустое, сохраняется старое значение.
+     *        Если поле пустое, сохраняется старое значение (см. update_fields_).
      */
     bool update_entry_(int id,
                        const std::string& newTitle,
@@ -56,13 +308,229 @@ public:
                        const std::string& newUsername,
                        const std::string& newPassword,
                        const std::string& newNotes,
-                       const std::string& masterPassword);
+                       const session_key_t& key);
+
+    /**
+     * @brief Частичное обновление: пишет только поля из update.m_fields одним
+     *        UPDATE (вместе с триггером индекса FTS - одна неявная транзакция),
+     *        без предварительного чтения записи. Зашифрованный пароль не
+     *        трогается, если c_field_password не задан; индекс FTS - если
+     *        меняется только пароль. Пустая строка в выбранном поле - новое значение.
+     * @return false, если записи нет или при ошибке SQLite
+     */
+    bool update_fields_(int id, const entry_update_t& update, const session_key_t& key);
+
+    /**
+     * @brief Одна страница результатов поиска с пагинацией по ключу (id > afterId).
+     *
+     * Читаются только метаданные: m_encryptedPassword в записях страницы пуст.
+     * Записи идут по возрастанию ID (без ранжирования), поэтому следующую
+     * страницу можно запросить с afterId = ID последней записи.
+     * Строки в page переиспользуются между вызовами.
+     * @param query Запрос в том же смысле, что и в search_entries_; пустой - все записи
+     * @return false при ошибке SQLite
+     */
+    bool list_page_(const std::string& query,
+                    int afterId,
+                    size_t limit,
+                    std::vector<password_entry_t>& page);
+
+    /**
+     * @brief Как list_page_, но без копирования: visitor получает представления
+     *        (m_encryptedPassword в них равен nullptr).
+     * @return false при ошибке SQLite
+     */
+    bool visit_page_(const std::string& query,
+                     int afterId,
+                     size_t limit,
+                     const entry_visitor_t& visitor);
+
+    /**
+     * @brief Расшифровывает пароли пакета записей на всех ядрах.
+     * @param decrypted Если задан, сюда пишется 1 для расшифрованных паролей и 0
+     *        для нерасшифрованных (им соответствует пустая строка)
+     * @return Пароли в том же порядке, что и entries
+     */
+    std::vector<std::string> decrypt_entries_(const password_entry_t* entries,
+                                              size_t count,
+                                              const session_key_t& key,
+                                              std::vector<char>* decrypted = nullptr);
+
+    /**
+     * @brief Смена мастер-пароля: перешифровывает все пароли из oldKey в newKey.
+     *
+     * Таблица читается пакетами по chunkSize строк по курсору (id > последний),
+     * каждый пакет расшифровывается и шифруется заново параллельно и фиксируется
+     * отдельной транзакцией вместе с маркером прогресса в таблице rekey_state.
+     * После сбоя повторный вызов с теми же ключами продолжает с маркера.
+     * Если хоть одна запись не расшифровывается oldKey (или, при возобновлении,
+     * уже перешифрованная запись не расшифровывается newKey), операция
+     * прерывается без изменений в текущем пакете. Ключи проверяются только
+     * контрольным значением заголовка (verify_key_) и тегом GCM; смена ключа
+     * (oldKey != newKey) не начинается, пока в хранилище есть блоки старого
+     * формата CBC (их сначала переводит migrate_cipher_). По завершении в
+     * заголовок записывается контрольное значение newKey.
+     * @param newParams Параметры KDF, из которых получен newKey (новая соль); до
+     *        завершения они хранятся как ожидающие (load_kdf_params_(p, true)) и
+     *        становятся текущими вместе со снятием маркера. nullptr - параметры
+     *        не меняются (или, при возобновлении, применяются ожидающие)
+     * @param cancelled Если задан и стал true, смена останавливается перед
+     *        следующим пакетом (как после сбоя - её можно возобновить)
+     * @return false при ошибке или отмене
+     */
+    bool rekey_(const session_key_t& oldKey,
+                const session_key_t& newKey,
+                size_t chunkSize = 1000,
+                const rekey_callback_t& progress = nullptr,
+                const kdf_params_t* newParams = nullptr,
+                const std::atomic<bool>* cancelled = nullptr);
+
+    /**
+     * @brief Откат прерванной смены мастер-пароля: записи до маркера
+     *        перешифровываются из newKey обратно в oldKey, маркер и ожидающие
+     *        параметры KDF удаляются.
+     *
+     * Пакеты идут от маркера вниз, и маркер опускается вместе с каждым
+     * пакетом: записи с id <= маркера остаются под newKey, поэтому после
+     * сбоя можно и повторить откат, и продолжить смену через rekey_.
+     * Без маркера ничего не делает и возвращает true.
+     * @return false при ошибке (хранилище остаётся наполовину перешифрованным)
+     */
+    bool rollback_rekey_(const session_key_t& oldKey,
+                         const session_key_t& newKey,
+                         size_t chunkSize = 1000,
+                         const rekey_callback_t& progress = nullptr);
+
+    /**
+     * @brief Читает параметры KDF из заголовка хранилища.
+     * @param pending Параметры незавершённой смены мастер-пароля вместо текущих
+     * @return false, если заголовка нет (хранилище старого формата - kdf_params_t::legacy_())
+     */
+    bool load_kdf_params_(kdf_params_t& params, bool pending = false);
+
+    /**
+     * @brief Записывает текущие параметры KDF. Только для нового (пустого) хранилища
+     *        или чтобы явно записать kdf_params_t::legacy_() старого хранилища без
+     *        заголовка: для существующих записей параметры меняются через rekey_.
+     */
+    bool store_kdf_params_(const kdf_params_t& params);
+
+    /**
+     * @brief Проверяет мастер-пароль по контрольному значению в заголовке (его
+     *        пишут store_key_check_ и каждая завершённая смена ключа), а в старых
+     *        хранилищах без него - по тегу первого блока AES-256-GCM.
+     *
+     * Блоки CBC ключ не проверяют: с неверным ключом дополнение сходится
+     * примерно в 1/256 случаев.
+     */
+    key_check_t verify_key_(const session_key_t& key);
+
+    /**
+     * @brief Записывает контрольное значение ключа в текущий заголовок. Только для
+     *        ключа, который уже подтверждён (новое хранилище или подтверждение
+     *        пользователем): неверное значение запрёт хранилище для верного пароля.
+     * @return false, если заголовка нет или при ошибке SQLite
+     */
+    bool store_key_check_(const session_key_t& key);
+
+    /**
+     * @brief Есть ли в хранилище хоть одна запись.
+     */
+    bool has_entries_();
+
+    /**
+     * @brief Число записей, пароли которых ещё в старом формате AES-128-CBC
+     *        (по байту версии: старый блок, случайно начинающийся с 0x02,
+     *        считается блоком GCM и не расшифровывается).
+     */
+    size_t legacy_entry_count_();
+
+    /**
+     * @brief Переводит все пароли в формат AES-256-GCM (перешифровка тем же ключом
+     *        через rekey_, с теми же пакетами и возобновлением после сбоя).
+     *
+     * Не начинается, если verify_key_ не подтверждает ключ: иначе расшифрованный
+     * неверным ключом мусор был бы записан как аутентифицированный блок GCM.
+     */
+    bool migrate_cipher_(const session_key_t& key,
+                         size_t chunkSize = 1000,
+                         const rekey_callback_t& progress = nullptr);
+
+    /**
+     * @brief Проверяет, была ли прервана смена мастер-пароля.
+     * @param lastId Если не nullptr, сюда пишется последний перешифрованный ID
+     */
+    bool rekey_in_progress_(int* lastId = nullptr);
+
+    /**
+     * @brief Включает LRU-кеш записей по ID для get_entry_by_id_/visit_entry_by_id_
+     *        и (при secretTtl > 0) расшифрованных паролей для get_decrypted_password_.
+     *
+     * Записи удаляются из кеша при update_entry_/delete_entry_, весь кеш - при rekey_.
+     * Вызывать до начала работы из нескольких потоков. capacity = 0 выключает кеш.
+     */
+    void enable_cache_(size_t capacity,
+                       std::chrono::milliseconds secretTtl = std::chrono::milliseconds(0));
+
+    /**
+     * @brief Счётчики кеша (нули, если кеш выключен).
+     */
+    cache_stats_t cache_stats_() const;
 
     /**
      * @brief Получает одну запись по ID (ID уникален).
      * @return Найденная запись или запись с m_id = 0, если нет в БД.
      */
     password_entry_t get_entry_by_id_(int id);
+
+    /**
+     * @brief Получает записи по списку ID одним запросом (id IN json_each(?)).
+     *
+     * Записи, найденные в кеше, в запрос не попадают.
+     * @param entries Результат в порядке ids; для отсутствующих ID - запись с m_id = 0
+     * @return false при ошибке SQLite
+     */
+    bool get_entries_by_ids_(const std::vector<int>& ids, std::vector<password_entry_t>& entries);
+
+    /**
+     * @brief Расшифрованные пароли по списку ID: один запрос, затем расшифровка
+     *        всего пакета ключом сессии на всех ядрах (как decrypt_entries_).
+     * @param passwords Результат в порядке ids; для отсутствующих ID - пустая строка
+     * @return false при ошибке SQLite
+     */
+    bool get_decrypted_passwords_(const std::vector<int>& ids,
+                                  const session_key_t& key,
+                                  std::vector<std::string>& passwords);
+
+    /**
+     * @brief Передаёт в visitor представление записи с указанным ID без копирования.
+     * @return false, если записи нет
+     */
+    bool visit_entry_by_id_(int id, const entry_visitor_t& visitor);
+
+    /**
+     * @brief Сохраняет хранилище в снимок (snapshot.h): индекс по ID, таблица строк
+     *        и зашифрованные пароли как есть, плюс текущие параметры KDF.
+     *        Ключ не нужен. Недоступно во время незавершённой смены мастер-пароля.
+     */
+    bool export_snapshot_(const std::string& path);
+
+    /**
+     * @brief Загружает все записи в колоночное хранилище в памяти (column_store.h).
+     *
+     * После этого for_each_entry_ и search_entries_ обслуживаются из памяти:
+     * поиск подстроки без учёта регистра ASCII (как LIKE) по всем записям,
+     * SIMD-сканированием колонок, результаты - по возрастанию ID, без ранжирования
+     * FTS. Хранилище обновляется при add/update/delete, перечитывается после
+     * import и rekey. Вызывать до начала работы из нескольких потоков.
+     * @return false при ошибке чтения (поиск тогда остаётся в SQLite)
+     */
+    bool load_column_store_();
+
+    /**
+     * @brief Открыто ли хранилище из снимка (только чтение).
+     */
+    bool read_only_() const { return m_snapshot != nullptr; }
 };
 
 #endif // DATABASE_H
@@ -0,0 +1,86 @@
+#ifndef ENTRY_CACHE_H
+#define ENTRY_CACHE_H
+
+#include "database/database.h"
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief LRU-кеш записей по ID перед database_t.
+ *
+ * Хранит метаданные записи (с зашифрованным паролем) и, если задан TTL,
+ * расшифрованный пароль, который живёт не дольше TTL и затирается при
+ * вытеснении. Потокобезопасен (общий мьютекс).
+ *
+ * Чтобы запись, прочитанная из SQLite до параллельного update/delete, не
+ * попала в кеш после инвалидации, читатель берёт generation_() до запроса
+ * к базе и передаёт его в put_: если с тех пор была инвалидация, put_ ничего
+ * не делает.
+ */
+class entry_cache_t {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * @param capacity Максимум записей (не меньше 1)
+     * @param secretTtl Время жизни расшифрованного пароля; 0 - пароли не кешируются
+     */
+    entry_cache_t(size_t capacity, std::chrono::milliseconds secretTtl);
+    ~entry_cache_t();
+
+    entry_cache_t(const entry_cache_t&) = delete;
+    entry_cache_t& operator=(const entry_cache_t&) = delete;
+
+    uint64_t generation_() const;
+
+    bool get_(int id, password_entry_t& entry);
+    void put_(const password_entry_t& entry, uint64_t generation);
+
+    bool get_secret_(int id, std::string& secret);
+    void put_secret_(int id, const std::string& secret, uint64_t generation);
+
+    /**
+     * @brief Удаляет запись (после update_entry_/delete_entry_).
+     */
+    void invalidate_(int id);
+
+    /**
+     * @brief Удаляет всё (например, после смены мастер-пароля).
+     */
+    void clear_();
+
+    cache_stats_t stats_() const;
+
+private:
+    struct node_t {
+        int m_id;
+        bool m_hasEntry;
+        password_entry_t m_entry;
+        bool m_hasSecret;
+        std::string m_secret;
+        clock_t::time_point m_secretExpires;
+    };
+
+    using lru_t = std::list<node_t>; // начало - самая свежая запись
+
+    mutable std::mutex m_mutex;
+    size_t m_capacity;
+    std::chrono::milliseconds m_secretTtl;
+    lru_t m_lru;
+    std::unordered_map<int, lru_t::iterator> m_index;
+    uint64_t m_generation;
+    cache_stats_t m_stats;
+
+    /**
+     * @brief Находит или создаёт узел и делает его самым свежим (под m_mutex).
+     */
+    node_t& touch_(int id);
+    void drop_secret_(node_t& node);
+    void erase_(lru_t::iterator it);
+};
+
+#endif // ENTRY_CACHE_H
@@ -0,0 +1,123 @@
+#ifndef FUZZY_SEARCH_H
+#define FUZZY_SEARCH_H
+
+#include "database/database.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Разобранный запрос нечёткого поиска: слова без учёта регистра ASCII.
+ *
+ * Каждое слово оценивается по полям записи независимо, лучшая оценка поля:
+ *  - подстрока (выше в начале поля или слова и при совпадении поля целиком);
+ *  - подпоследовательность в стиле fzf ("gh" -> "GitHub"): бонусы за подряд
+ *    идущие символы и начала слов, штраф за пропуски;
+ *  - опечатки: расстояние Дамерау-Левенштейна (с перестановкой соседних
+ *    символов) до ближайшей подстроки поля, не больше token_t::m_typos правок;
+ *    ищутся, только если подстроки и подпоследовательности нет ни в одном поле.
+ * Совпадение в title и url весит больше, чем в username и notes.
+ * Запись подходит, только если совпало каждое слово; оценка - сумма по словам.
+ */
+class fuzzy_query_t {
+public:
+    struct token_t {
+        std::string m_text;            // слово, A-Z приведены к a-z
+        uint64_t m_mask;               // символы слова (см. char_mask)
+        std::vector<uint16_t> m_bigrams; // различные пары соседних символов
+        int m_typos;                   // допустимое число правок
+        std::array<uint64_t, 256> m_peq; // байт -> позиции в слове (для опечаток)
+    };
+
+    explicit fuzzy_query_t(const std::string& query);
+
+    bool empty_() const { return m_tokens.empty(); }
+    const std::vector<token_t>& tokens_() const { return m_tokens; }
+
+    /**
+     * @brief Оценка записи; 0 - запись не подходит.
+     */
+    int score_(std::string_view title, std::string_view url,
+               std::string_view username, std::string_view notes) const;
+
+    /**
+     * @brief Маска символов текста: бит на букву/цифру, остальные байты - по хешу.
+     *        Если маска слова не входит в маску текста, подстроки и
+     *        подпоследовательности в нём нет.
+     */
+    static uint64_t char_mask(std::string_view text);
+
+    /**
+     * @brief Код пары соседних символов (после приведения регистра).
+     */
+    static uint16_t bigram(char first, char second);
+
+private:
+    std::vector<token_t> m_tokens;
+};
+
+/**
+ * @brief Результат нечёткого поиска: строка индекса, ID записи и оценка.
+ */
+struct fuzzy_hit_t {
+    size_t m_row;
+    int m_id;
+    int m_score;
+};
+
+/**
+ * @brief Индекс для нечёткого поиска по метаданным всех записей.
+ *
+ * Хранит копию title/url/username/notes, маску символов каждой записи и
+ * инвертированный индекс пар символов (биграмм). Кандидаты отбираются без
+ * чтения текста: по маске (для подстрок и подпоследовательностей) или по
+ * числу общих с запросом биграмм (для опечаток: каждая правка портит не
+ * больше трёх биграмм). Полная оценка считается только для кандидатов, а
+ * лучшие limit записей держатся в куче ограниченного размера.
+ *
+ * Индекс неизменяем после построения; search_ можно вызывать из нескольких
+ * потоков.
+ */
+class fuzzy_index_t {
+public:
+    fuzzy_index_t();
+
+    fuzzy_index_t(const fuzzy_index_t&) = delete;
+    fuzzy_index_t& operator=(const fuzzy_index_t&) = delete;
+
+    /**
+     * @brief Добавляет запись (пароль не копируется).
+     */
+    void append_(const password_entry_view_t& view);
+
+    size_t size_() const { return m_ids.size(); }
+
+    /**
+     * @brief До limit лучших записей по убыванию оценки (при равенстве - по ID).
+     * @param cancelled Если задан и стал true, поиск прерывается
+     * @return false, если поиск отменён
+     */
+    bool search_(const std::string& query, size_t limit, std::vector<fuzzy_hit_t>& hits,
+                 const std::atomic<bool>* cancelled = nullptr) const;
+
+    /**
+     * @brief Метаданные строки индекса (m_encryptedPassword - nullptr).
+     */
+    password_entry_view_t view_(size_t row) const;
+
+private:
+    static const int c_fields = 4;
+
+    std::vector<char> m_text;
+    std::vector<char> m_folded; // m_text с A-Z -> a-z, те же смещения
+    std::vector<size_t> m_offsets{0}; // c_fields границ на запись
+    std::vector<int> m_ids;
+    std::vector<uint64_t> m_masks;      // маска символов записи
+    std::vector<uint64_t> m_fieldMasks; // c_fields масок на запись
+    std::vector<std::vector<uint32_t>> m_postings; // биграмма -> строки по возрастанию
+};
+
+#endif // FUZZY_SEARCH_H
@@ -0,0 +1,64 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include <istream>
+#include <memory>
+#include <string>
+#include <cstddef>
+
+/**
+ * @brief Одна импортируемая запись (пароль ещё в открытом виде).
+ */
+struct import_row_t {
+    std::string m_title;
+    std::string m_url;
+    std::string m_username;
+    std::string m_password;
+    std::string m_notes;
+};
+
+/**
+ * @brief Потоковый источник записей для database_t::import_entries_.
+ *        Читает данные по одной записи, не загружая файл целиком.
+ */
+class entry_reader_t {
+public:
+    virtual ~entry_reader_t() = default;
+
+    /**
+     * @brief Читает следующую запись.
+     * @return false, если данные закончились или произошла ошибка (см. error_())
+     */
+    virtual bool next_(import_row_t& row) = 0;
+
+    /**
+     * @brief Описание ошибки разбора или пустая строка, если ввод просто закончился.
+     */
+    virtual const std::string& error_() const = 0;
+};
+
+enum class import_format_t {
+    csv,  // первая строка - заголовок с именами колонок (title,url,username,password,notes)
+    json  // массив объектов [{"title": "...", "password": "...", ...}, ...]
+};
+
+/**
+ * @brief Создаёт потоковый читатель нужного формата поверх input.
+ *        Поток должен жить дольше читателя.
+ */
+std::unique_ptr<entry_reader_t> make_entry_reader(std::istream& input, import_format_t format);
+
+/**
+ * @brief Итог импорта.
+ */
+struct import_result_t {
+    bool m_ok;              // false, если импорт прерван ошибкой
+    std::string m_error;
+    size_t m_imported;      // успешно вставленные записи
+    size_t m_failed;        // прочитанные записи, которые не удалось сохранить
+                            // (в том числе весь пакет при сбое BEGIN или COMMIT)
+    double m_seconds;
+    double m_rowsPerSecond;
+};
+
+#endif // IMPORT_H
@@ -0,0 +1,72 @@
+#ifndef RESULT_SET_H
+#define RESULT_SET_H
+
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+
+/**
+ * @brief Вариант password_entry_t, все поля которого выделяются из арены
+ *        (std::pmr): строки и BLOB записей лежат в общих больших блоках.
+ */
+struct pmr_password_entry_t {
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    int m_id;
+    std::pmr::string m_title;
+    std::pmr::string m_url;
+    std::pmr::string m_username;
+    std::pmr::vector<unsigned char> m_encryptedPassword; // зашифрованный пароль
+    std::pmr::string m_notes;
+
+    explicit pmr_password_entry_t(const allocator_type& alloc = {});
+    pmr_password_entry_t(const pmr_password_entry_t& other, const allocator_type& alloc = {});
+    pmr_password_entry_t(pmr_password_entry_t&& other, const allocator_type& alloc);
+    pmr_password_entry_t(pmr_password_entry_t&& other) noexcept = default;
+    pmr_password_entry_t& operator=(const pmr_password_entry_t&) = default;
+    pmr_password_entry_t& operator=(pmr_password_entry_t&&) = default;
+};
+
+/**
+ * @brief Результат поиска, целиком размещённый в монотонной арене.
+ *
+ * Вместо сотен тысяч мелких выделений (четыре строки и вектор на запись)
+ * память берётся большими блоками и освобождается разом в clear_() или
+ * в деструкторе. Объект нельзя копировать: записи ссылаются на его арену.
+ */
+class entry_result_set_t {
+private:
+    std::pmr::monotonic_buffer_resource m_arena;
+    std::pmr::vector<pmr_password_entry_t> m_entries;
+
+public:
+    /**
+     * @param initialBytes Размер первого блока арены (следующие растут геометрически)
+     */
+    explicit entry_result_set_t(size_t initialBytes = 64 * 1024);
+
+    entry_result_set_t(const entry_result_set_t&) = delete;
+    entry_result_set_t& operator=(const entry_result_set_t&) = delete;
+
+    /**
+     * @brief Добавляет пустую запись, размещённую в арене.
+     */
+    pmr_password_entry_t& append_();
+
+    /**
+     * @brief Удаляет все записи и одним вызовом возвращает всю память арены.
+     */
+    void clear_();
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+
+    const pmr_password_entry_t& operator[](size_t index) const { return m_entries[index]; }
+
+    std::pmr::vector<pmr_password_entry_t>::const_iterator begin() const { return m_entries.begin(); }
+    std::pmr::vector<pmr_password_entry_t>::const_iterator end() const { return m_entries.end(); }
+};
+
+#endif // RESULT_SET_H
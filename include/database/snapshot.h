@@ -0,0 +1,122 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "database/database.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Формат снимка хранилища (версия 1), все числа little-endian:
+ *
+ *   [snapshot_header_t, 128 байт]
+ *   [индекс: snapshot_record_t x m_entryCount, по возрастанию ID]
+ *   [таблица строк: title/url/username/notes всех записей подряд]
+ *   [блок зашифрованных паролей подряд]
+ *
+ * Смещения в записях индекса отсчитываются от начала своей секции. Пароли
+ * остаются зашифрованными ключом сессии, в заголовке лежат параметры KDF,
+ * поэтому снимок открывается тем же мастер-паролем, что и исходное хранилище.
+ */
+struct snapshot_header_t {
+    char m_magic[8];          // "PMSNAP\0\0"
+    uint32_t m_version;
+    uint32_t m_byteOrder;     // 0x01020304, записанное на машине-экспортёре
+    uint32_t m_headerSize;
+    uint32_t m_entryCount;
+    uint64_t m_fileSize;
+    uint64_t m_indexOffset;
+    uint64_t m_stringsOffset;
+    uint64_t m_stringsSize;
+    uint64_t m_blobsOffset;
+    uint64_t m_blobsSize;
+    uint32_t m_kdfAlgorithm;  // kdf_params_t
+    uint32_t m_kdfIterations;
+    uint32_t m_kdfScryptLogN;
+    uint32_t m_kdfScryptR;
+    uint32_t m_kdfScryptP;
+    uint32_t m_kdfLanes;
+    uint32_t m_kdfSaltSize;
+    unsigned char m_kdfSalt[24];
+    uint32_t m_reserved;
+};
+
+struct snapshot_record_t {
+    int32_t m_id;
+    uint32_t m_blobSize;
+    uint32_t m_blobOffset;
+    uint32_t m_fields[4][2];  // {смещение, длина} title, url, username, notes
+};
+
+static_assert(sizeof(snapshot_header_t) == 128, "snapshot header must stay 128 bytes");
+static_assert(sizeof(snapshot_record_t) == 44, "snapshot record layout changed");
+
+/**
+ * @brief Снимок хранилища, отображённый в память (только чтение).
+ *
+ * open_() проверяет только заголовок и границы секций, ничего не разбирая,
+ * поэтому открытие не зависит от размера хранилища. Поиск по ID - двоичный
+ * по индексу, поиск по тексту - подстрока без учёта регистра ASCII (как LIKE).
+ * Представления записей указывают прямо в отображение и действительны, пока
+ * снимок открыт. Потокобезопасен (отображение не меняется).
+ */
+class snapshot_t {
+private:
+    const unsigned char* m_base;
+    size_t m_size;
+    const snapshot_header_t* m_header;
+    const snapshot_record_t* m_index;
+
+    /**
+     * @brief Заполняет view по записи индекса.
+     * @return false, если запись выходит за границы секций (повреждённый снимок)
+     */
+    bool view_(const snapshot_record_t& record, bool withPassword, password_entry_view_t& view) const;
+    static bool matches_(const password_entry_view_t& view, const std::string& foldedQuery);
+
+public:
+    snapshot_t();
+    ~snapshot_t();
+
+    snapshot_t(const snapshot_t&) = delete;
+    snapshot_t& operator=(const snapshot_t&) = delete;
+
+    /**
+     * @brief Отображает файл снимка в память.
+     * @return false, если файла нет или он не похож на снимок этой версии
+     */
+    bool open_(const std::string& path);
+    void close_();
+
+    bool is_open_() const { return m_base != nullptr; }
+    size_t size_() const;
+    kdf_params_t kdf_params_() const;
+
+    bool visit_(int id, const entry_visitor_t& visitor) const;
+
+    /**
+     * @brief Все записи, где query - подстрока title/url/username/notes
+     *        (пустой запрос - все записи), по возрастанию ID.
+     * @param cancelled Если задан и стал true, обход прерывается
+     * @return false, если снимок повреждён или обход прерван
+     */
+    bool for_each_(const std::string& query, const entry_visitor_t& visitor,
+                   const std::atomic<bool>* cancelled = nullptr) const;
+
+    /**
+     * @brief Страница как в database_t::visit_page_ (без паролей, id > afterId).
+     */
+    bool visit_page_(const std::string& query, int afterId, size_t limit,
+                     const entry_visitor_t& visitor) const;
+
+    /**
+     * @brief Записывает снимок в path (через временный файл и rename).
+     * @param entries Записи по возрастанию ID, с зашифрованными паролями
+     */
+    static bool write_(const std::string& path,
+                       const std::vector<password_entry_t>& entries,
+                       const kdf_params_t& params);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,48 @@
+#ifndef STORAGE_PROFILE_H
+#define STORAGE_PROFILE_H
+
+#include <string>
+
+/**
+ * @brief Режим PRAGMA synchronous.
+ */
+enum class sync_mode_t {
+    off,
+    normal, // в режиме WAL не теряет целостность, fsync только при checkpoint
+    full
+};
+
+/**
+ * @brief Параметры открытия SQLite-хранилища (применяются в конструкторе database_t).
+ *
+ * Значения по умолчанию настроены на низкую задержку записи: WAL (читатели не
+ * блокируют писателя), synchronous=NORMAL, mmap и увеличенный кеш страниц.
+ */
+struct storage_profile_t {
+    std::string m_path = "passwords.db";
+    bool m_walMode = true;                      // PRAGMA journal_mode=WAL
+    sync_mode_t m_synchronous = sync_mode_t::normal;
+    long long m_mmapSize = 256LL * 1024 * 1024; // PRAGMA mmap_size, байт (0 - выключено)
+    int m_cacheSizeKib = 64 * 1024;             // PRAGMA cache_size = -KiB
+    bool m_tempStoreMemory = true;              // PRAGMA temp_store=MEMORY
+    int m_busyTimeoutMs = 5000;                 // ожидание блокировки другим процессом
+    int m_readConnections = 0;                  // пул читателей (0 - все запросы через писателя)
+    bool m_snapshot = false;                    // m_path - снимок (snapshot.h), только чтение
+
+    /**
+     * @brief Профиль с настройками по умолчанию для указанного файла.
+     */
+    static storage_profile_t tuned_(const std::string& path);
+
+    /**
+     * @brief Стандартное поведение SQLite: журнал отката и synchronous=FULL.
+     */
+    static storage_profile_t sqlite_defaults_(const std::string& path);
+
+    /**
+     * @brief Снимок хранилища, отображённый в память, вместо SQLite (только чтение).
+     */
+    static storage_profile_t snapshot_(const std::string& path);
+};
+
+#endif // STORAGE_PROFILE_H
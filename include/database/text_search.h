@@ -0,0 +1,30 @@
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Приводит A-Z к нижнему регистру, остальные байты (в том числе UTF-8) не меняет.
+ *        Тот же смысл регистра, что у LIKE в SQLite.
+ */
+std::string fold_ascii(std::string_view text);
+
+/**
+ * @brief Ищет foldedNeedle (уже после fold_ascii) в data без учёта регистра ASCII.
+ *
+ * Кандидаты отбираются по первому и последнему байту образца сразу для 32
+ * (AVX2) или 16 (SSE2) позиций, затем проверяются целиком. Набор инструкций
+ * выбирается один раз при первом вызове по возможностям процессора; на других
+ * архитектурах используется скалярный вариант.
+ * @return Позиция первого вхождения или std::string::npos; пустой образец - 0
+ */
+size_t find_folded(const char* data, size_t size, const std::string& foldedNeedle);
+
+/**
+ * @brief Вариант find_folded, выбранный для этого процессора: "avx2", "sse2" или "scalar".
+ */
+const char* text_search_isa();
+
+#endif // TEXT_SEARCH_H
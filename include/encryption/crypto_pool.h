@@ -0,0 +1,90 @@
+#ifndef CRYPTO_POOL_H
+#define CRYPTO_POOL_H
+
+#include "encryption/encryption.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class session_key_t;
+
+/**
+ * @brief Ссылка на зашифрованный блок без копирования (указатель + размер).
+ */
+struct ciphertext_ref_t {
+    const unsigned char* m_data;
+    size_t m_size;
+};
+
+/**
+ * @brief Пул потоков для пакетного шифрования/расшифровки.
+ *
+ * У каждого рабочего потока (и у вызывающего, который тоже участвует в работе)
+ * свой cipher_context_t, переиспользуемый между записями. Результаты
+ * возвращаются в порядке входных данных. Потоки создаются при первом пакете.
+ * Одновременно выполняется один пакет; параллельные вызовы ждут друг друга.
+ */
+class crypto_pool_t {
+public:
+    /// Задача над i-м элементом пакета с контекстом текущего потока.
+    using task_t = std::function<void(cipher_context_t& ctx, size_t index)>;
+
+    /**
+     * @param threadCount Число потоков, включая вызывающий; 0 - по числу ядер.
+     */
+    explicit crypto_pool_t(size_t threadCount = 0);
+    ~crypto_pool_t();
+
+    crypto_pool_t(const crypto_pool_t&) = delete;
+    crypto_pool_t& operator=(const crypto_pool_t&) = delete;
+
+    /**
+     * @brief Выполняет task для индексов [0, count), распределяя их по потокам.
+     *        Возвращается, когда все элементы обработаны.
+     */
+    void parallel_for_(size_t count, const task_t& task);
+
+    /**
+     * @param decrypted Если задан, сюда пишется 1 для расшифрованных блоков и 0
+     *        для нерасшифрованных (им соответствует пустая строка)
+     */
+    std::vector<std::string> decrypt_batch_(const std::vector<ciphertext_ref_t>& ciphertexts,
+                                            const session_key_t& key,
+                                            std::vector<char>* decrypted = nullptr);
+
+    std::vector<std::vector<unsigned char>> encrypt_batch_(const std::vector<std::string>& plaintexts,
+                                                           const session_key_t& key);
+
+    size_t thread_count_() const { return m_threadCount; }
+
+private:
+    encryption_t m_encryption;
+    size_t m_threadCount;
+
+    std::vector<std::thread> m_workers;
+    std::vector<std::unique_ptr<cipher_context_t>> m_contexts; // [0] - вызывающего потока
+
+    std::mutex m_batchMutex; // сериализует parallel_for_
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    const task_t* m_task;
+    size_t m_taskSize;
+    std::atomic<size_t> m_next;
+    size_t m_busyWorkers;
+    uint64_t m_generation;
+    bool m_stopping;
+
+    void start_workers_();
+    void worker_loop_(size_t index);
+    void process_chunks_(cipher_context_t& ctx);
+};
+
+#endif // CRYPTO_POOL_H
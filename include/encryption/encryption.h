@@ -3,17 +3,134 @@
 
 #include <vector>
 #include <string>
+#include <cstddef>
+#include <cstdint>
 
+class session_key_t;
+struct evp_cipher_ctx_st;
+
+/**
+ * @brief Переиспользуемый контекст шифра OpenSSL (EVP_CIPHER_CTX).
+ *
+ * Позволяет не создавать и не освобождать контекст на каждую операцию:
+ * один контекст на поток, повторно инициализируемый для каждой записи.
+ */
+class cipher_context_t {
+private:
+    evp_cipher_ctx_st* m_ctx;
+
+    // Состояние для GCM: ключ и направление, с которыми контекст уже
+    // инициализирован, чтобы для следующей записи менять только nonce.
+    // Ключ узнаётся по session_key_t::id_(), копия ключа не хранится
+    int m_gcmMode;                 // 0 - не инициализирован, 1 - шифрование, 2 - расшифровка
+    uint64_t m_gcmKeyId;
+    unsigned char m_noncePrefix[8]; // случайный префикс nonce этого контекста
+    uint32_t m_nonceCounter;
+
+public:
+    cipher_context_t();
+    ~cipher_context_t();
+
+    cipher_context_t(const cipher_context_t&) = delete;
+    cipher_context_t& operator=(const cipher_context_t&) = delete;
+
+    evp_cipher_ctx_st* get_() const { return m_ctx; }
+
+    /**
+     * @brief Готовит контекст к AES-256-GCM с ключом key (32 байта); полная
+     *        инициализация только при смене ключа или направления.
+     * @param keyId session_key_t::id_() ключа; 0 - ключ без идентификатора,
+     *        контекст инициализируется заново при каждом вызове
+     */
+    bool prepare_gcm_(bool encrypt, const unsigned char* key, uint64_t keyId);
+
+    /**
+     * @brief Следующий уникальный nonce (12 байт): случайный префикс контекста
+     *        и счётчик; префикс обновляется при переполнении счётчика.
+     */
+    bool next_nonce_(unsigned char* nonce);
+
+    /**
+     * @brief Сбрасывает закешированное состояние GCM (после использования в другом режиме).
+     */
+    void reset_gcm_() { m_gcmMode = 0; }
+};
+
+/**
+ * @brief Шифрование паролей записей.
+ *
+ * Формат блока: [0x02][nonce, 12 байт][шифртекст][тег, 16 байт] - AES-256-GCM
+ * со случайным nonce на каждую запись и всеми 32 байтами ключа сессии; байт
+ * версии входит в аутентифицируемые данные. Блоки старого формата (AES-128-CBC,
+ * IV из ключа) по-прежнему расшифровываются; новые всегда пишутся в GCM.
+ * Формат определяется только байтом версии: блок, начинающийся с 0x02, - всегда
+ * GCM (без попытки CBC при неверном теге), остальные - CBC.
+ */
 class encryption_t {
 public:
+    /// Байт версии формата AES-256-GCM.
+    static constexpr unsigned char c_format_gcm = 0x02;
+    /// Накладные расходы GCM: версия + nonce + тег.
+    static constexpr size_t c_gcm_overhead = 1 + 12 + 16;
+
     encryption_t();
 
     std::vector<unsigned char> derive_key_(const std::string& masterPassword);
 
+    /**
+     * @brief Производит ключ прямо в буфер вызывающего (без промежуточных копий).
+     * @return false, если PBKDF2 завершился с ошибкой
+     */
+    bool derive_key_into_(const std::string& masterPassword, unsigned char* out, size_t outSize);
+
+    /**
+     * @brief Размер зашифрованного блока для открытого текста длины plaintextSize.
+     */
+    static size_t encrypted_size_(size_t plaintextSize) { return plaintextSize + c_gcm_overhead; }
+
+    /**
+     * @brief Сколько места нужно decrypt_into_ под блок размера ciphertextSize
+     *        (с запасом на блок шифра для старого формата).
+     */
+    static size_t decrypted_capacity_(size_t ciphertextSize) { return ciphertextSize + 32; }
+
+    /**
+     * @brief Шифрует в буфер вызывающего размером не меньше encrypted_size_(size),
+     *        без выделений памяти.
+     * @return Число записанных байт или 0 при ошибке
+     */
+    size_t encrypt_into_(cipher_context_t& ctx, const unsigned char* plaintext, size_t size,
+                         const session_key_t& key, unsigned char* out);
+
+    /**
+     * @brief Расшифровывает в буфер вызывающего размером не меньше decrypted_capacity_(size).
+     * @param written Длина открытого текста
+     * @return false при неверном ключе или повреждённых данных (буфер тогда обнуляется)
+     */
+    bool decrypt_into_(cipher_context_t& ctx, const unsigned char* ciphertext, size_t size,
+                       const session_key_t& key, unsigned char* out, size_t& written);
+
     std::vector<unsigned char> encrypt_aes_(const std::string& plaintext, const std::vector<unsigned char>& key);
+    std::vector<unsigned char> encrypt_aes_(const std::string& plaintext, const session_key_t& key);
+    std::vector<unsigned char> encrypt_aes_(cipher_context_t& ctx, const std::string& plaintext, const session_key_t& key);
 
     std::string decrypt_aes_(const std::vector<unsigned char>& ciphertext, const std::vector<unsigned char>& key);
+    std::string decrypt_aes_(const unsigned char* ciphertext, size_t size, const session_key_t& key);
+    std::string decrypt_aes_(cipher_context_t& ctx, const unsigned char* ciphertext, size_t size, const session_key_t& key);
+
+    /**
+     * @brief Как decrypt_aes_, но сообщает, удалась ли расшифровка (тег GCM
+     *        или, для старого формата, дополнение CBC).
+     *
+     * Сошедшееся дополнение CBC не доказывает, что ключ верный (с неверным
+     * ключом оно сходится примерно в 1 случае из 256), поэтому проверкой
+     * ключа считается только authenticated.
+     * @param authenticated Если задан: true, только если блок GCM прошёл проверку тега
+     * @return false при неверном ключе или повреждённых данных
+     */
+    bool decrypt_checked_(cipher_context_t& ctx, const unsigned char* ciphertext, size_t size,
+                          const session_key_t& key, std::string& plaintext,
+                          bool* authenticated = nullptr);
 };
 
 #endif // ENCRYPTION_H
-
@@ -0,0 +1,92 @@
+#ifndef KDF_H
+#define KDF_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Функция получения ключа из мастер-пароля.
+ *        Значения хранятся в заголовке хранилища - не менять.
+ */
+enum class kdf_algorithm_t : int {
+    pbkdf2_sha1_legacy = 0, // прежняя схема: 10000 итераций и общая соль c_static_salt
+    pbkdf2_sha256 = 1,
+    scrypt = 2              // memory-hard
+};
+
+/**
+ * @brief Алгоритм и стоимость KDF вместе с солью хранилища.
+ *
+ * При m_lanes > 1 ключ собирается из независимых полос: полоса i выводит
+ * 32 байта тем же алгоритмом с солью salt || i (u32 little-endian), полосы
+ * считаются параллельно, а результат - HKDF-SHA256 от их конкатенации.
+ * Стоимость (m_iterations, m_scryptP) задаётся на одну полосу, общая работа
+ * в m_lanes раз больше; перебор всё так же требует всех полос.
+ *
+ * Для PBKDF2 полосы делят между ядрами ту же работу. Для scrypt так нельзя:
+ * разделённая память N позволила бы атакующему считать полосы по очереди
+ * в памяти одной полосы. Поэтому у scrypt каждая полоса - полный проход
+ * N x r x p, а полосы добавляются на свободные ядра и память сверх одной
+ * полосы: память на попытку та же, что без полос, а работа в m_lanes раз больше.
+ */
+struct kdf_params_t {
+    kdf_algorithm_t m_algorithm;
+    uint32_t m_iterations;  // PBKDF2
+    uint32_t m_scryptLogN;  // scrypt: N = 2^logN (память ~ 128 * r * N байт)
+    uint32_t m_scryptR;
+    uint32_t m_scryptP;
+    std::vector<unsigned char> m_salt;
+    uint32_t m_lanes = 1;
+
+    /**
+     * @brief Параметры хранилищ без заголовка (PBKDF2-SHA1, статическая соль).
+     */
+    static kdf_params_t legacy_();
+
+    /**
+     * @brief Те же алгоритм и стоимость с новой случайной солью (для смены мастер-пароля).
+     */
+    kdf_params_t with_new_salt_() const;
+
+    /**
+     * @brief Краткое описание для пользователя, например "scrypt N=2^17 r=8 p=1".
+     */
+    std::string describe_() const;
+};
+
+/**
+ * @brief Производит ключ размера outSize из пароля по параметрам.
+ * @return false при ошибке OpenSSL или недопустимых параметрах
+ */
+bool derive_kdf_key(const std::string& password, const kdf_params_t& params,
+                    unsigned char* out, size_t outSize);
+
+/**
+ * @brief Число полос по умолчанию для новых хранилищ - число ядер этой машины.
+ */
+uint32_t default_kdf_lanes();
+
+/**
+ * @brief Подбирает стоимость KDF под целевое время разблокировки на этой машине
+ *        (замеряет вывод ключа и масштабирует стоимость) и создаёт новую соль.
+ *        Для PBKDF2 число итераций не опускается ниже 100000, для scrypt - N ниже 2^14,
+ *        даже если это дольше target. Старая схема PBKDF2-SHA1 заменяется на SHA256.
+ *
+ * Для PBKDF2 бюджет работы - то, что одно ядро успевает за target; при
+ * lanes > 1 он делится между полосами (не ниже 100000 итераций на полосу),
+ * и на lanes ядрах разблокировка идёт примерно в lanes раз быстрее.
+ * Для scrypt N подбирается для одной полосы, а полос берётся не больше
+ * ядер этой машины и сколько проходов N x r одновременно помещается в
+ * maxMemoryMib: время разблокировки то же, работа на попытку больше.
+ * @param maxMemoryMib Потолок памяти scrypt на все полосы; дальше растёт параллелизм p
+ * @param lanes Число полос (1 - без распараллеливания)
+ */
+kdf_params_t calibrate_kdf(kdf_algorithm_t algorithm,
+                           std::chrono::milliseconds target,
+                           size_t maxMemoryMib = 256,
+                           uint32_t lanes = 1);
+
+#endif // KDF_H
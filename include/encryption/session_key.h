@@ -0,0 +1,77 @@
+#ifndef SESSION_KEY_H
+#define SESSION_KEY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class encryption_t;
+struct kdf_params_t;
+
+/**
+ * @brief Ключ сессии: производится из мастер-пароля один раз при разблокировке
+ *        и хранится в заблокированной (mlock) памяти, которая обнуляется при освобождении.
+ *
+ * Объект нельзя копировать (чтобы не плодить копии ключа), но можно перемещать.
+ */
+class session_key_t {
+private:
+    unsigned char* m_data;
+    size_t m_size;
+    bool m_locked;
+    uint64_t m_id; // уникален в пределах процесса, 0 - ключа нет
+
+    void release_();
+
+    /**
+     * @brief Выделяет заблокированную память под ключ (содержимое ещё не задано).
+     */
+    static session_key_t allocate_();
+
+public:
+    /// Размер производного ключа в байтах (ключ AES-256; старый формат CBC брал 16 байт ключа и 16 байт IV).
+    static constexpr size_t c_key_size = 32;
+
+    session_key_t();
+    ~session_key_t();
+
+    session_key_t(const session_key_t&) = delete;
+    session_key_t& operator=(const session_key_t&) = delete;
+    session_key_t(session_key_t&& other) noexcept;
+    session_key_t& operator=(session_key_t&& other) noexcept;
+
+    /**
+     * @brief Производит ключ из мастер-пароля по старой схеме (PBKDF2-SHA1,
+     *        статическая соль) и сохраняет его в защищённой памяти.
+     */
+    static session_key_t derive_(encryption_t& encryption, const std::string& masterPassword);
+
+    /**
+     * @brief То же с KDF и солью из заголовка хранилища.
+     */
+    static session_key_t derive_(const std::string& masterPassword, const kdf_params_t& params);
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /**
+     * @brief Идентификатор ключа: разные ключи процесса никогда не получают
+     *        одинаковый. По нему cipher_context_t узнаёт уже загруженный ключ,
+     *        не храня его копию.
+     */
+    uint64_t id_() const { return m_id; }
+
+    /**
+     * @brief Сравнение ключей за постоянное время (например, для проверки
+     *        повторно введённого мастер-пароля).
+     */
+    bool equals_(const session_key_t& other) const;
+
+    /**
+     * @brief true, если страницы ключа удалось закрепить в RAM (mlock).
+     */
+    bool is_locked_() const { return m_locked; }
+};
+
+#endif // SESSION_KEY_H
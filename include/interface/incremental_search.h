@@ -0,0 +1,92 @@
+#ifndef INCREMENTAL_SEARCH_H
+#define INCREMENTAL_SEARCH_H
+
+#include "database/database.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Поиск при вводе: каждый запрос выполняется в фоновом потоке.
+ *
+ * Новый submit_() отменяет выполняющийся запрос (флаг отмены передаётся в
+ * for_each_entry_), так что поток всегда занят только последним вводом.
+ * Если поиск в хранилище - по подстроке (database_t::substring_search_) и
+ * новый запрос содержит предыдущий завершённый, результат получается
+ * фильтрацией предыдущего в памяти, без обращения к хранилищу.
+ * Если точных совпадений нет, показываются лучшие нечёткие
+ * (database_t::search_ranked_) - например, для запроса с опечаткой.
+ *
+ * Готовый результат публикуется через latest_(), а в notify_fd_() (eventfd)
+ * пишется событие, чтобы интерфейс мог ждать его вместе с вводом в poll().
+ * Пока идёт поиск, вызывающий не должен изменять хранилище.
+ */
+class incremental_search_t {
+public:
+    /**
+     * @brief Результат одного запроса; записи без зашифрованных паролей.
+     */
+    struct result_t {
+        uint64_t m_generation; // номер запроса из submit_
+        std::string m_query;
+        entry_result_set_t m_entries;
+        bool m_refined;        // получен фильтрацией предыдущего результата
+        bool m_fuzzy;          // точных совпадений нет, это нечёткие (по убыванию оценки)
+        double m_millis;
+    };
+
+    explicit incremental_search_t(database_t& db);
+    ~incremental_search_t();
+
+    incremental_search_t(const incremental_search_t&) = delete;
+    incremental_search_t& operator=(const incremental_search_t&) = delete;
+
+    /**
+     * @brief Ставит запрос в работу, отменяя предыдущий.
+     * @return Номер запроса (растёт с каждым вызовом)
+     */
+    uint64_t submit_(const std::string& query);
+
+    /**
+     * @brief Последний опубликованный результат (nullptr, пока его нет).
+     */
+    std::shared_ptr<const result_t> latest_() const;
+
+    /**
+     * @brief Дескриптор, готовый к чтению после каждой публикации
+     *        (-1, если eventfd недоступен); событие снимает consume_notify_().
+     */
+    int notify_fd_() const { return m_notifyFd; }
+    void consume_notify_();
+
+private:
+    database_t& m_db;
+    int m_notifyFd;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::string m_pendingQuery;
+    uint64_t m_pendingGeneration; // 0 - новых запросов нет
+    uint64_t m_generation;
+    bool m_stop;
+    std::atomic<bool> m_cancel;
+    std::shared_ptr<const result_t> m_latest;
+
+    std::thread m_worker;
+
+    void run_();
+
+    /**
+     * @brief Выполняет запрос; nullptr, если он был отменён.
+     * @param base Последний завершённый результат (для уточнения) или nullptr
+     */
+    std::shared_ptr<result_t> execute_(const std::string& query, uint64_t generation,
+                                       const std::shared_ptr<const result_t>& base);
+    void publish_(std::shared_ptr<const result_t> result);
+};
+
+#endif // INCREMENTAL_SEARCH_H
@@ -5,13 +5,15 @@
 
 // Вперёд объявляем класс database_t (чтобы не включать весь database.h)
 class database_t;
+class session_key_t;
 
 /**
  * @brief Запускает TUI с основным меню.
  * @param db Ссылка на объект базы данных
- * @param masterPassword Мастер-пароль для операций шифрования/дешифрования
+ * @param key Ключ сессии (производится из мастер-пароля один раз при разблокировке;
+ *            заменяется при смене мастер-пароля)
  */
-void start_tui(database_t& db, const std::string& masterPassword);
+void start_tui(database_t& db, session_key_t& key);
 
 #endif // TUI_H
 
@@ -0,0 +1,129 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Операции, для которых собираются гистограммы задержек.
+ */
+enum metric_op_t {
+    c_op_derive_key,  // encryption_t::derive_key_ (PBKDF2 старого формата)
+    c_op_kdf,         // derive_kdf_key: любой алгоритм, включая калибровку
+    c_op_encrypt,     // шифрование одного пароля (AES-256-GCM)
+    c_op_decrypt,     // расшифровка одного пароля (GCM или старый CBC)
+    c_op_sql_prepare, // sqlite3_prepare
+    c_op_sql_step,    // один sqlite3_step
+    c_op_sql_exec,    // sqlite3_exec (транзакции, PRAGMA, схема)
+    c_op_count
+};
+
+/**
+ * @brief Счётчики без времени.
+ */
+enum metric_counter_t {
+    c_counter_bytes_encrypted,     // байт открытого текста
+    c_counter_bytes_decrypted,
+    c_counter_decrypt_failures,    // не прошла проверка тега или формат
+    c_counter_sqlite_cache_hits,   // страницы из кеша SQLite (SQLITE_DBSTATUS_CACHE_HIT)
+    c_counter_sqlite_cache_misses,
+    c_counter_count
+};
+
+/**
+ * @brief Метрики процесса: гистограммы задержек и счётчики.
+ *
+ * Запись - несколько relaxed-атомарных сложений, без блокировок; гистограмма
+ * логарифмическая: корзина i считает длительности [2^i, 2^(i+1)) нс.
+ * Инструментированный код пользуется макросами METRICS_TIME / METRICS_ADD:
+ * при сборке без PASSMAN_METRICS (cmake -DPASSMAN_METRICS=OFF) они
+ * раскрываются в пустое выражение, а выгрузка сообщает, что метрик нет.
+ */
+class metrics_t {
+public:
+    static const int c_buckets = 40; // до 2^40 нс (~18 минут), дальше - в последнюю
+
+    /**
+     * @brief Срез одной гистограммы.
+     */
+    struct histogram_t {
+        uint64_t m_count;
+        uint64_t m_sumNanos;
+        uint64_t m_maxNanos;
+        uint64_t m_buckets[c_buckets];
+
+        /**
+         * @brief Оценка квантиля q (0..1) в наносекундах: линейно внутри корзины.
+         */
+        double quantile_(double q) const;
+    };
+
+    static void record_(metric_op_t op, uint64_t nanos);
+    static void add_(metric_counter_t counter, uint64_t value);
+
+    static histogram_t histogram_(metric_op_t op);
+    static uint64_t counter_(metric_counter_t counter);
+    static void reset_();
+
+    static const char* op_name_(metric_op_t op);
+    static const char* counter_name_(metric_counter_t counter);
+
+    /**
+     * @brief Собраны ли метрики в эту сборку (PASSMAN_METRICS).
+     */
+    static bool enabled_();
+
+    /**
+     * @brief Таблица для человека: число, среднее, p50/p99/max по операциям и счётчики.
+     */
+    static std::string summary_();
+
+    static std::string to_json_();
+
+    /**
+     * @brief Текстовый формат Prometheus (histogram со временем в секундах).
+     */
+    static std::string to_prometheus_();
+
+    /**
+     * @brief Пишет метрики в файл: JSON, если имя оканчивается на .json,
+     *        иначе - текст Prometheus (для node_exporter textfile). Файл
+     *        заменяется атомарно (через временный и rename).
+     */
+    static bool export_(const std::string& path);
+};
+
+/**
+ * @brief Замер времени от конструктора до деструктора.
+ */
+class metrics_timer_t {
+public:
+    explicit metrics_timer_t(metric_op_t op) : m_op(op), m_start(std::chrono::steady_clock::now()) {}
+
+    ~metrics_timer_t() {
+        auto elapsed = std::chrono::steady_clock::now() - m_start;
+        metrics_t::record_(m_op, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+
+    metrics_timer_t(const metrics_timer_t&) = delete;
+    metrics_timer_t& operator=(const metrics_timer_t&) = delete;
+
+private:
+    metric_op_t m_op;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#ifdef PASSMAN_METRICS
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_TIMER_NAME_(line) METRICS_CONCAT_(metricsTimer_, line)
+/// Замеряет время до конца текущей области видимости.
+#define METRICS_TIME(op) metrics_timer_t METRICS_TIMER_NAME_(__LINE__)(op)
+#define METRICS_ADD(counter, value) metrics_t::add_((counter), static_cast<uint64_t>(value))
+#else
+#define METRICS_TIME(op) ((void)0)
+#define METRICS_ADD(counter, value) ((void)0)
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,116 @@
+#include "daemon/client.h"
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+
+static void print_usage() {
+    std::cerr << "Usage: passman_client <socket> get <id> [id...]\n"
+              << "       passman_client <socket> search <query> [limit]\n"
+              << "       passman_client <socket> add <title> <url> <username> [notes]\n"
+              << "       (add reads the password from stdin)\n";
+}
+
+/**
+ * @brief Разбирает неотрицательное число из аргумента командной строки.
+ * @return false, если аргумент не число целиком или не помещается в u32
+ */
+static bool parse_u32(const char* text, uint32_t& value) {
+    try {
+        size_t used = 0;
+        unsigned long parsed = std::stoul(text, &used);
+        if (text[used] != '\0' || text[0] == '-' || parsed > UINT32_MAX) {
+            return false;
+        }
+        value = static_cast<uint32_t>(parsed);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+static const char* status_text(status_t status) {
+    switch (status) {
+        case status_t::ok: return "ok";
+        case status_t::not_found: return "not found";
+        case status_t::bad_request: return "bad request";
+        default: return "error";
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        print_usage();
+        return 1;
+    }
+
+    std::string command = argv[2];
+    // Числовые аргументы: ID для get и limit для search
+    std::vector<int> ids;
+    uint32_t limit = 50;
+    bool numbersOk = true;
+    if (command == "get") {
+        for (int i = 3; i < argc && numbersOk; ++i) {
+            uint32_t id = 0;
+            numbersOk = parse_u32(argv[i], id) && id <= INT32_MAX;
+            ids.push_back(static_cast<int>(id));
+        }
+    } else if (command == "search" && argc == 5) {
+        numbersOk = parse_u32(argv[4], limit);
+    }
+    if (!numbersOk) {
+        print_usage();
+        return 1;
+    }
+
+    daemon_client_t client;
+    if (!client.connect_(argv[1])) {
+        return 1;
+    }
+
+    status_t status = status_t::bad_request;
+    if (command == "get" && argc == 4) {
+        password_entry_t entry{};
+        std::string password;
+        status = client.get_(ids[0], entry, password);
+        if (status == status_t::ok) {
+            std::cout << "Title: " << entry.m_title << "\n"
+                      << "URL: " << entry.m_url << "\n"
+                      << "Username: " << entry.m_username << "\n"
+                      << "Password: " << password << "\n"
+                      << "Notes: " << entry.m_notes << "\n";
+            std::fill(password.begin(), password.end(), '\0');
+        }
+    } else if (command == "get" && argc > 4) {
+        std::vector<password_entry_t> entries;
+        std::vector<std::string> passwords;
+        status = client.get_many_(ids, entries, passwords);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            std::cout << entries[i].m_id << "\t" << entries[i].m_title << "\t" << entries[i].m_url << "\t"
+                      << entries[i].m_username << "\t" << passwords[i] << "\n";
+            std::fill(passwords[i].begin(), passwords[i].end(), '\0');
+        }
+    } else if (command == "search" && (argc == 4 || argc == 5)) {
+        std::vector<password_entry_t> entries;
+        status = client.search_(argv[3], limit, entries);
+        for (const password_entry_t& entry : entries) {
+            std::cout << entry.m_id << "\t" << entry.m_title << "\t"
+                      << entry.m_url << "\t" << entry.m_username << "\n";
+        }
+    } else if (command == "add" && (argc == 6 || argc == 7)) {
+        std::string password;
+        std::getline(std::cin, password);
+        status = client.add_(argv[3], argv[4], argv[5], password, argc == 7 ? argv[6] : "");
+        std::fill(password.begin(), password.end(), '\0');
+    } else {
+        print_usage();
+        return 1;
+    }
+
+    if (status != status_t::ok) {
+        std::cerr << "Request failed: " << status_text(status) << "\n";
+        return 1;
+    }
+    return 0;
+}
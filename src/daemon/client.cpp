@@ -0,0 +1,236 @@
+#include "daemon/client.h"
+#include <openssl/crypto.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+bool write_all(int fd, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+bool read_all(int fd, unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t got = recv(fd, data, size, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        data += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool read_entry_fields(frame_reader_t& reader, password_entry_t& entry, std::string* password) {
+    uint32_t id = 0;
+    if (!reader.get_u32_(id) || !reader.get_string_(entry.m_title) ||
+        !reader.get_string_(entry.m_url) || !reader.get_string_(entry.m_username)) {
+        return false;
+    }
+    if (password && !reader.get_string_(*password)) {
+        return false;
+    }
+    entry.m_id = static_cast<int>(id);
+    entry.m_encryptedPassword.clear();
+    return reader.get_string_(entry.m_notes);
+}
+
+} // namespace
+
+daemon_client_t::daemon_client_t() : m_fd(-1) {}
+
+daemon_client_t::~daemon_client_t() {
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool daemon_client_t::connect_(const std::string& socketPath) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: invalid socket path: " << socketPath << std::endl;
+        return false;
+    }
+    std::memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_fd < 0 || connect(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::cerr << "Error connecting to " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (m_fd >= 0) {
+            close(m_fd);
+            m_fd = -1;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool daemon_client_t::round_trip_(std::vector<unsigned char> request, std::vector<unsigned char>& response) {
+    bool sent = m_fd >= 0 && write_all(m_fd, request.data(), request.size());
+    OPENSSL_cleanse(request.data(), request.size());
+    if (!sent) {
+        return false;
+    }
+
+    unsigned char header[c_frame_header_size];
+    if (!read_all(m_fd, header, sizeof(header))) {
+        return false;
+    }
+    // Длина - от другой стороны сокета: больше c_max_frame_size не выделяем, а поток
+    // после такого кадра уже не разобрать - соединение закрывается
+    uint32_t length = read_u32_le(header);
+    if (length == 0 || length > c_max_frame_size) {
+        std::cerr << "Error: invalid response frame length " << length << std::endl;
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    response.resize(length);
+    return read_all(m_fd, response.data(), length);
+}
+
+status_t daemon_client_t::get_(int id, password_entry_t& entry, std::string& password) {
+    frame_writer_t writer;
+    writer.put_u8_(static_cast<uint8_t>(opcode_t::get));
+    writer.put_u32_(static_cast<uint32_t>(id));
+
+    std::vector<unsigned char> response;
+    if (!round_trip_(writer.finish_(), response)) {
+        return status_t::error;
+    }
+
+    frame_reader_t reader(response.data(), response.size());
+    uint8_t status = 0;
+    reader.get_u8_(status);
+    if (static_cast<status_t>(status) == status_t::ok &&
+        !read_entry_fields(reader, entry, &password)) {
+        status = static_cast<uint8_t>(status_t::error);
+    }
+    OPENSSL_cleanse(response.data(), response.size());
+    return static_cast<status_t>(status);
+}
+
+status_t daemon_client_t::get_many_(
+    const std::vector<int>& ids,
+    std::vector<password_entry_t>& entries,
+    std::vector<std::string>& passwords
+) {
+    entries.clear();
+    passwords.clear();
+    if (ids.size() > c_max_batch_ids) {
+        return status_t::bad_request;
+    }
+
+    frame_writer_t writer;
+    writer.put_u8_(static_cast<uint8_t>(opcode_t::get_many));
+    writer.put_u32_(static_cast<uint32_t>(ids.size()));
+    for (int id : ids) {
+        writer.put_u32_(static_cast<uint32_t>(id));
+    }
+
+    std::vector<unsigned char> response;
+    if (!round_trip_(writer.finish_(), response)) {
+        return status_t::error;
+    }
+
+    frame_reader_t reader(response.data(), response.size());
+    uint8_t status = 0;
+    uint32_t count = 0;
+    reader.get_u8_(status);
+    if (static_cast<status_t>(status) == status_t::ok) {
+        if (!reader.get_u32_(count) || count > ids.size()) {
+            status = static_cast<uint8_t>(status_t::error);
+        } else {
+            entries.resize(count);
+            passwords.resize(count);
+            for (uint32_t i = 0; i < count; ++i) {
+                if (!read_entry_fields(reader, entries[i], &passwords[i])) {
+                    entries.clear();
+                    passwords.clear();
+                    status = static_cast<uint8_t>(status_t::error);
+                    break;
+                }
+            }
+        }
+    }
+    OPENSSL_cleanse(response.data(), response.size());
+    return static_cast<status_t>(status);
+}
+
+status_t daemon_client_t::search_(const std::string& query, uint32_t limit, std::vector<password_entry_t>& entries) {
+    frame_writer_t writer;
+    writer.put_u8_(static_cast<uint8_t>(opcode_t::search));
+    writer.put_string_(query);
+    writer.put_u32_(limit);
+
+    std::vector<unsigned char> response;
+    if (!round_trip_(writer.finish_(), response)) {
+        return status_t::error;
+    }
+
+    frame_reader_t reader(response.data(), response.size());
+    uint8_t status = 0;
+    uint32_t count = 0;
+    reader.get_u8_(status);
+    if (static_cast<status_t>(status) != status_t::ok) {
+        return static_cast<status_t>(status);
+    }
+    if (!reader.get_u32_(count) || count > c_max_search_results) {
+        return status_t::error;
+    }
+
+    entries.clear();
+    entries.resize(count);
+    for (password_entry_t& entry : entries) {
+        if (!read_entry_fields(reader, entry, nullptr)) {
+            entries.clear();
+            return status_t::error;
+        }
+    }
+    return status_t::ok;
+}
+
+status_t daemon_client_t::add_(
+    const std::string& title,
+    const std::string& url,
+    const std::string& username,
+    const std::string& password,
+    const std::string& notes
+) {
+    frame_writer_t writer;
+    writer.put_u8_(static_cast<uint8_t>(opcode_t::add));
+    writer.put_string_(title);
+    writer.put_string_(url);
+    writer.put_string_(username);
+    writer.put_string_(password);
+    writer.put_string_(notes);
+
+    std::vector<unsigned char> response;
+    if (!round_trip_(writer.finish_(), response)) {
+        return status_t::error;
+    }
+
+    frame_reader_t reader(response.data(), response.size());
+    uint8_t status = static_cast<uint8_t>(status_t::error);
+    reader.get_u8_(status);
+    return static_cast<status_t>(status);
+}
@@ -0,0 +1,472 @@
+#include "daemon/daemon.h"
+#include "daemon/protocol.h"
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const int c_max_events = 64;
+const size_t c_read_chunk = 64 * 1024;
+const size_t c_max_pending_output = 16u << 20; // клиент, не читающий ответы, отключается
+
+/**
+ * @brief Затирает буфер, в котором могли быть пароли, и освобождает его.
+ */
+void wipe(std::vector<unsigned char>& buf) {
+    if (!buf.empty()) {
+        OPENSSL_cleanse(buf.data(), buf.size());
+    }
+    buf.clear();
+}
+
+void append_status(std::vector<unsigned char>& out, status_t status) {
+    frame_writer_t writer;
+    writer.put_u8_(static_cast<uint8_t>(status));
+    std::vector<unsigned char> frame = writer.finish_();
+    out.insert(out.end(), frame.begin(), frame.end());
+}
+
+} // namespace
+
+daemon_t::daemon_t(database_t& db, const session_key_t& key, const std::string& socketPath)
+    : m_db(db), m_key(key), m_socketPath(socketPath), m_listenFd(-1), m_epollFd(-1), m_signalFd(-1) {}
+
+daemon_t::~daemon_t() {
+    while (!m_clients.empty()) {
+        close_client_(m_clients.begin()->first);
+    }
+    if (m_signalFd >= 0) {
+        close(m_signalFd);
+    }
+    if (m_epollFd >= 0) {
+        close(m_epollFd);
+    }
+    if (m_listenFd >= 0) {
+        close(m_listenFd);
+        unlink(m_socketPath.c_str());
+    }
+}
+
+/**
+ * @brief Создаёт слушающий сокет (убирая оставшийся от прошлого запуска).
+ */
+bool daemon_t::listen_() {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (m_socketPath.empty() || m_socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: invalid socket path: " << m_socketPath << std::endl;
+        return false;
+    }
+    std::memcpy(addr.sun_path, m_socketPath.c_str(), m_socketPath.size() + 1);
+
+    struct stat st{};
+    if (lstat(m_socketPath.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            std::cerr << "Error: " << m_socketPath << " exists and is not a socket" << std::endl;
+            return false;
+        }
+        unlink(m_socketPath.c_str());
+    }
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0) {
+        std::cerr << "Error creating socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Права 0600 с момента создания, без окна между bind и chmod
+    mode_t oldMask = umask(0177);
+    int rc = bind(m_listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    umask(oldMask);
+    if (rc < 0 || listen(m_listenFd, SOMAXCONN) < 0) {
+        std::cerr << "Error listening on " << m_socketPath << ": " << std::strerror(errno) << std::endl;
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool daemon_t::run_() {
+    if (!listen_()) {
+        return false;
+    }
+
+    // SIGINT/SIGTERM приходят через signalfd, чтобы цикл завершился штатно
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    m_signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFd < 0 || m_signalFd < 0) {
+        std::cerr << "Error initializing event loop: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = m_listenFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &ev);
+    ev.data.fd = m_signalFd;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_signalFd, &ev);
+
+    std::cout << "Listening on " << m_socketPath << std::endl;
+
+    epoll_event events[c_max_events];
+    bool running = true;
+    while (running) {
+        int n = epoll_wait(m_epollFd, events, c_max_events, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Error in event loop: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == m_signalFd) {
+                running = false;
+                continue;
+            }
+            if (fd == m_listenFd) {
+                accept_clients_();
+                continue;
+            }
+
+            auto it = m_clients.find(fd);
+            if (it == m_clients.end()) {
+                continue;
+            }
+            client_t& client = it->second;
+
+            bool alive = !(events[i].events & (EPOLLERR | EPOLLHUP)) || (events[i].events & EPOLLIN);
+            if (alive && (events[i].events & EPOLLIN)) {
+                alive = read_client_(client);
+            }
+            if (alive) {
+                alive = flush_client_(client);
+            }
+            if (!alive) {
+                close_client_(fd);
+            }
+        }
+    }
+
+    std::cout << "Daemon stopped" << std::endl;
+    return true;
+}
+
+void daemon_t::accept_clients_() {
+    while (true) {
+        int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "Error accepting client: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        // Только процессы того же пользователя
+        ucred cred{};
+        socklen_t len = sizeof(cred);
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0 || cred.uid != getuid()) {
+            close(fd);
+            continue;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            continue;
+        }
+        m_clients[fd] = client_t{fd, {}, {}, 0, false};
+    }
+}
+
+/**
+ * @brief Дочитывает доступные данные и обрабатывает все полные кадры.
+ * @return false, если клиент отключился или нарушил протокол
+ */
+bool daemon_t::read_client_(client_t& client) {
+    bool peerClosed = false;
+    while (true) {
+        size_t used = client.m_in.size();
+        client.m_in.resize(used + c_read_chunk);
+        ssize_t got = recv(client.m_fd, client.m_in.data() + used, c_read_chunk, 0);
+        client.m_in.resize(used + (got > 0 ? static_cast<size_t>(got) : 0));
+
+        if (got > 0) {
+            // Не копим больше одного кадра за раз: остаток дочитаем по следующему EPOLLIN
+            if (client.m_in.size() > c_frame_header_size + c_max_frame_size) {
+                break;
+            }
+            continue;
+        }
+        if (got == 0) {
+            peerClosed = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+        break;
+    }
+
+    size_t pos = 0;
+    while (client.m_in.size() - pos >= c_frame_header_size) {
+        uint32_t length = read_u32_le(client.m_in.data() + pos);
+        if (length == 0 || length > c_max_frame_size) {
+            return false;
+        }
+        if (client.m_in.size() - pos - c_frame_header_size < length) {
+            break;
+        }
+        if (client.m_out.size() - client.m_outPos > c_max_pending_output) {
+            return false;
+        }
+        handle_request_(client.m_in.data() + pos + c_frame_header_size, length, client.m_out);
+        pos += c_frame_header_size + length;
+    }
+
+    // В разобранных кадрах add были пароли
+    if (pos > 0) {
+        OPENSSL_cleanse(client.m_in.data(), pos);
+        client.m_in.erase(client.m_in.begin(), client.m_in.begin() + pos);
+    }
+
+    if (peerClosed) {
+        // Отвечаем на уже полученные запросы и закрываем соединение
+        flush_client_(client);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Отправляет накопленные ответы; остаток ждёт EPOLLOUT.
+ */
+bool daemon_t::flush_client_(client_t& client) {
+    while (client.m_outPos < client.m_out.size()) {
+        ssize_t sent = send(client.m_fd, client.m_out.data() + client.m_outPos,
+                            client.m_out.size() - client.m_outPos, MSG_NOSIGNAL);
+        if (sent > 0) {
+            client.m_outPos += static_cast<size_t>(sent);
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+
+    bool pending = client.m_outPos < client.m_out.size();
+    if (!pending) {
+        wipe(client.m_out);
+        client.m_outPos = 0;
+    }
+    if (pending != client.m_wantWrite) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | (pending ? uint32_t(EPOLLOUT) : 0u);
+        ev.data.fd = client.m_fd;
+        epoll_ctl(m_epollFd, EPOLL_CTL_MOD, client.m_fd, &ev);
+        client.m_wantWrite = pending;
+    }
+    return true;
+}
+
+void daemon_t::close_client_(int fd) {
+    auto it = m_clients.find(fd);
+    if (it != m_clients.end()) {
+        wipe(it->second.m_in);
+        wipe(it->second.m_out);
+        m_clients.erase(it);
+    }
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+}
+
+void daemon_t::handle_request_(const unsigned char* body, size_t size, std::vector<unsigned char>& out) {
+    frame_reader_t reader(body, size);
+    uint8_t op = 0;
+    if (!reader.get_u8_(op)) {
+        append_status(out, status_t::bad_request);
+        return;
+    }
+
+    frame_writer_t writer;
+
+    switch (static_cast<opcode_t>(op)) {
+        case opcode_t::get: {
+            uint32_t id = 0;
+            if (!reader.get_u32_(id) || !reader.at_end_()) {
+                append_status(out, status_t::bad_request);
+                return;
+            }
+
+            bool decrypted = true;
+            bool found = m_db.visit_entry_by_id_(static_cast<int>(id), [&](const password_entry_view_t& view) {
+                std::string password;
+                decrypted = m_encryption.decrypt_checked_(m_ctx, view.m_encryptedPassword, view.m_encryptedSize,
+                                                          m_key, password);
+                if (decrypted) {
+                    writer.put_u8_(static_cast<uint8_t>(status_t::ok));
+                    writer.put_u32_(static_cast<uint32_t>(view.m_id));
+                    writer.put_string_(view.m_title);
+                    writer.put_string_(view.m_url);
+                    writer.put_string_(view.m_username);
+                    writer.put_string_(password);
+                    writer.put_string_(view.m_notes);
+                }
+                OPENSSL_cleanse(&password[0], password.size());
+            });
+            if (!found) {
+                append_status(out, status_t::not_found);
+                return;
+            }
+            if (!decrypted) {
+                append_status(out, status_t::error);
+                return;
+            }
+            break;
+        }
+
+        case opcode_t::search: {
+            std::string query;
+            uint32_t limit = 0;
+            if (!reader.get_string_(query) || !reader.get_u32_(limit) || !reader.at_end_()) {
+                append_status(out, status_t::bad_request);
+                return;
+            }
+            limit = std::min(limit, c_max_search_results);
+
+            // Количество известно только после обхода - дописываем его в конце
+            writer.put_u8_(static_cast<uint8_t>(status_t::ok));
+            size_t countOffset = writer.put_u32_(0);
+            uint32_t count = 0;
+            // Обход прекращается, как только набрано limit записей
+            std::atomic<bool> full(limit == 0);
+            bool ok = full || m_db.for_each_entry_(query, [&](const password_entry_view_t& view) {
+                writer.put_u32_(static_cast<uint32_t>(view.m_id));
+                writer.put_string_(view.m_title);
+                writer.put_string_(view.m_url);
+                writer.put_string_(view.m_username);
+                writer.put_string_(view.m_notes);
+                if (++count >= limit) {
+                    full = true;
+                }
+            }, &full);
+            if (!ok && !full) {
+                append_status(out, status_t::error);
+                return;
+            }
+            writer.set_u32_(countOffset, count);
+            break;
+        }
+
+        case opcode_t::get_many: {
+            uint32_t count = 0;
+            if (!reader.get_u32_(count) || count > c_max_batch_ids) {
+                append_status(out, status_t::bad_request);
+                return;
+            }
+            std::vector<int> ids(count);
+            for (int& id : ids) {
+                uint32_t value = 0;
+                if (!reader.get_u32_(value)) {
+                    append_status(out, status_t::bad_request);
+                    return;
+                }
+                id = static_cast<int>(value);
+            }
+            if (!reader.at_end_()) {
+                append_status(out, status_t::bad_request);
+                return;
+            }
+
+            // Один запрос к базе и расшифровка всего пакета на пуле
+            std::vector<password_entry_t> entries;
+            if (!m_db.get_entries_by_ids_(ids, entries)) {
+                append_status(out, status_t::error);
+                return;
+            }
+            entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                         [](const password_entry_t& entry) { return entry.m_id == 0; }),
+                          entries.end());
+            std::vector<char> decrypted;
+            std::vector<std::string> passwords =
+                m_db.decrypt_entries_(entries.data(), entries.size(), m_key, &decrypted);
+
+            // Нерасшифрованный пароль - ошибка всего запроса (как у get), а не пустая строка
+            if (std::find(decrypted.begin(), decrypted.end(), 0) != decrypted.end()) {
+                for (std::string& password : passwords) {
+                    OPENSSL_cleanse(&password[0], password.size());
+                }
+                append_status(out, status_t::error);
+                return;
+            }
+
+            writer.put_u8_(static_cast<uint8_t>(status_t::ok));
+            writer.put_u32_(static_cast<uint32_t>(entries.size()));
+            for (size_t i = 0; i < entries.size(); ++i) {
+                writer.put_u32_(static_cast<uint32_t>(entries[i].m_id));
+                writer.put_string_(entries[i].m_title);
+                writer.put_string_(entries[i].m_url);
+                writer.put_string_(entries[i].m_username);
+                writer.put_string_(passwords[i]);
+                writer.put_string_(entries[i].m_notes);
+                OPENSSL_cleanse(&passwords[i][0], passwords[i].size());
+            }
+            break;
+        }
+
+        case opcode_t::add: {
+            import_row_t row;
+            if (!reader.get_string_(row.m_title) || !reader.get_string_(row.m_url) ||
+                !reader.get_string_(row.m_username) || !reader.get_string_(row.m_password) ||
+                !reader.get_string_(row.m_notes) || !reader.at_end_() || row.m_title.empty()) {
+                append_status(out, status_t::bad_request);
+                return;
+            }
+
+            bool added = m_db.add_entry_(row.m_title, row.m_url, row.m_username,
+                                         row.m_password, row.m_notes, m_key);
+            OPENSSL_cleanse(&row.m_password[0], row.m_password.size());
+            append_status(out, added ? status_t::ok : status_t::error);
+            return;
+        }
+
+        default:
+            append_status(out, status_t::bad_request);
+            return;
+    }
+
+    // Клиент не примет кадр больше c_max_frame_size (например, get_many с длинными заметками)
+    std::vector<unsigned char> frame = writer.finish_();
+    if (frame.size() - c_frame_header_size > c_max_frame_size) {
+        wipe(frame);
+        append_status(out, status_t::error);
+        return;
+    }
+    out.insert(out.end(), frame.begin(), frame.end());
+    wipe(frame);
+}
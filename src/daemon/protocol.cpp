@@ -0,0 +1,71 @@
+#include "daemon/protocol.h"
+
+frame_writer_t::frame_writer_t() : m_buf(c_frame_header_size, 0) {}
+
+void frame_writer_t::put_u8_(uint8_t value) {
+    m_buf.push_back(value);
+}
+
+size_t frame_writer_t::put_u32_(uint32_t value) {
+    size_t offset = m_buf.size();
+    m_buf.resize(offset + 4);
+    set_u32_(offset, value);
+    return offset;
+}
+
+void frame_writer_t::set_u32_(size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        m_buf[offset + i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+}
+
+void frame_writer_t::put_string_(std::string_view value) {
+    put_u32_(static_cast<uint32_t>(value.size()));
+    m_buf.insert(m_buf.end(), value.begin(), value.end());
+}
+
+std::vector<unsigned char> frame_writer_t::finish_() {
+    set_u32_(0, static_cast<uint32_t>(m_buf.size() - c_frame_header_size));
+
+    std::vector<unsigned char> frame;
+    frame.swap(m_buf);
+    m_buf.assign(c_frame_header_size, 0);
+    return frame;
+}
+
+frame_reader_t::frame_reader_t(const unsigned char* data, size_t size)
+    : m_data(data), m_size(size), m_pos(0) {}
+
+bool frame_reader_t::get_u8_(uint8_t& value) {
+    if (m_size - m_pos < 1) {
+        return false;
+    }
+    value = m_data[m_pos++];
+    return true;
+}
+
+bool frame_reader_t::get_u32_(uint32_t& value) {
+    if (m_size - m_pos < 4) {
+        return false;
+    }
+    value = read_u32_le(m_data + m_pos);
+    m_pos += 4;
+    return true;
+}
+
+bool frame_reader_t::get_string_(std::string& value) {
+    uint32_t length = 0;
+    if (!get_u32_(length) || m_size - m_pos < length) {
+        return false;
+    }
+    value.assign(reinterpret_cast<const char*>(m_data + m_pos), length);
+    m_pos += length;
+    return true;
+}
+
+uint32_t read_u32_le(const unsigned char* data) {
+    return static_cast<uint32_t>(data[0])
+         | (static_cast<uint32_t>(data[1]) << 8)
+         | (static_cast<uint32_t>(data[2]) << 16)
+         | (static_cast<uint32_t>(data[3]) << 24);
+}
@@ -0,0 +1,199 @@
+#include "database/async_database.h"
+#include <openssl/crypto.h>
+#include <algorithm>
+
+namespace {
+
+/**
+ * @brief Копия секрета для задачи исполнителя: исходная строка затирается сразу,
+ *        копия - когда задачу уничтожают (отменённая до начала задача не
+ *        выполняется, но уничтожается так же).
+ */
+std::shared_ptr<std::string> make_secret(std::string& value) {
+    std::shared_ptr<std::string> secret(new std::string(value), [](std::string* copy) {
+        OPENSSL_cleanse(&(*copy)[0], copy->size());
+        delete copy;
+    });
+    OPENSSL_cleanse(&value[0], value.size());
+    return secret;
+}
+
+} // namespace
+
+async_database_t::async_database_t(database_t& db) : m_db(db), m_stop(false) {
+    m_worker = std::thread(&async_database_t::run_, this);
+}
+
+async_database_t::~async_database_t() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        // Оставшиеся операции выполнятся отменёнными: их future получат значения
+        for (task_t& task : m_queue) {
+            task.m_cancelled->store(true);
+        }
+        if (m_running) {
+            m_running->store(true);
+        }
+    }
+    m_wakeup.notify_one();
+    m_worker.join();
+}
+
+size_t async_database_t::queued_() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size();
+}
+
+void async_database_t::enqueue_(task_t task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop) {
+            task.m_cancelled->store(true);
+        }
+        m_queue.push_back(std::move(task));
+    }
+    m_wakeup.notify_one();
+}
+
+void async_database_t::run_() {
+    while (true) {
+        task_t task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_running.reset();
+            m_wakeup.wait(lock, [&] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return; // m_stop и очередь разобрана
+            }
+            task = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_running = task.m_cancelled;
+        }
+        task.m_run();
+    }
+}
+
+pending_t<std::shared_ptr<const entry_result_set_t>> async_database_t::search_ranked_(
+    const std::string& query,
+    size_t limit
+) {
+    return submit_([query, limit](database_t& db, const std::atomic<bool>& cancelled) {
+        auto results = std::make_shared<entry_result_set_t>();
+        if (!db.search_ranked_(query, limit, *results, &cancelled)) {
+            return std::shared_ptr<const entry_result_set_t>();
+        }
+        return std::shared_ptr<const entry_result_set_t>(std::move(results));
+    });
+}
+
+pending_t<password_entry_t> async_database_t::get_entry_by_id_(int id) {
+    return submit_([id](database_t& db, const std::atomic<bool>&) { return db.get_entry_by_id_(id); });
+}
+
+pending_t<std::shared_ptr<const std::vector<password_entry_t>>> async_database_t::get_entries_by_ids_(
+    std::vector<int> ids
+) {
+    return submit_([ids = std::move(ids)](database_t& db, const std::atomic<bool>&) {
+        auto entries = std::make_shared<std::vector<password_entry_t>>();
+        if (!db.get_entries_by_ids_(ids, *entries)) {
+            return std::shared_ptr<const std::vector<password_entry_t>>();
+        }
+        return std::shared_ptr<const std::vector<password_entry_t>>(std::move(entries));
+    });
+}
+
+pending_t<std::shared_ptr<std::vector<std::string>>> async_database_t::get_decrypted_passwords_(
+    std::vector<int> ids,
+    const session_key_t& key
+) {
+    return submit_([ids = std::move(ids), &key](database_t& db, const std::atomic<bool>&) {
+        auto passwords = std::make_shared<std::vector<std::string>>();
+        if (!db.get_decrypted_passwords_(ids, key, *passwords)) {
+            for (std::string& password : *passwords) {
+                OPENSSL_cleanse(&password[0], password.size());
+            }
+            passwords.reset();
+        }
+        return passwords;
+    });
+}
+
+pending_t<bool> async_database_t::add_entry_(
+    std::string title,
+    std::string url,
+    std::string username,
+    std::string password,
+    std::string notes,
+    const session_key_t& key
+) {
+    return submit_([title = std::move(title), url = std::move(url), username = std::move(username),
+                    secret = make_secret(password), notes = std::move(notes),
+                    &key](database_t& db, const std::atomic<bool>&) {
+        return db.add_entry_(title, url, username, *secret, notes, key);
+    });
+}
+
+pending_t<bool> async_database_t::update_fields_(int id, entry_update_t update, const session_key_t& key) {
+    auto secret = make_secret(update.m_password);
+    update.m_password.clear();
+    return submit_([id, update = std::move(update), secret = std::move(secret),
+                    &key](database_t& db, const std::atomic<bool>&) {
+        entry_update_t withPassword = update;
+        withPassword.m_password = *secret;
+        bool ok = db.update_fields_(id, withPassword, key);
+        OPENSSL_cleanse(&withPassword.m_password[0], withPassword.m_password.size());
+        return ok;
+    });
+}
+
+pending_t<bool> async_database_t::delete_entry_(int id) {
+    return submit_([id](database_t& db, const std::atomic<bool>&) { return db.delete_entry_(id); });
+}
+
+pending_t<import_result_t> async_database_t::import_entries_(
+    std::unique_ptr<entry_reader_t> reader,
+    const session_key_t& key,
+    size_t batchSize
+) {
+    return submit_([reader = std::move(reader), &key, batchSize](database_t& db, const std::atomic<bool>&) {
+        return db.import_entries_(*reader, key, batchSize);
+    });
+}
+
+pending_t<bool> async_database_t::export_snapshot_(std::string path) {
+    return submit_([path = std::move(path)](database_t& db, const std::atomic<bool>&) {
+        return db.export_snapshot_(path);
+    });
+}
+
+pending_t<session_key_t> async_database_t::derive_key_(std::string masterPassword, const kdf_params_t& params) {
+    return submit_([secret = make_secret(masterPassword), params](database_t&, const std::atomic<bool>&) {
+        return session_key_t::derive_(*secret, params);
+    });
+}
+
+pending_t<bool> async_database_t::rekey_(
+    const session_key_t& oldKey,
+    const session_key_t& newKey,
+    size_t chunkSize,
+    rekey_callback_t progress,
+    const kdf_params_t* newParams
+) {
+    return submit_([&oldKey, &newKey, chunkSize, progress = std::move(progress), newParams](
+                       database_t& db, const std::atomic<bool>& cancelled) {
+        return db.rekey_(oldKey, newKey, chunkSize, progress, newParams, &cancelled);
+    });
+}
+
+pending_t<bool> async_database_t::rollback_rekey_(
+    const session_key_t& oldKey,
+    const session_key_t& newKey,
+    size_t chunkSize,
+    rekey_callback_t progress
+) {
+    return submit_([&oldKey, &newKey, chunkSize, progress = std::move(progress)](
+                       database_t& db, const std::atomic<bool>&) {
+        return db.rollback_rekey_(oldKey, newKey, chunkSize, progress);
+    });
+}
@@ -0,0 +1,215 @@
+#include "database/column_store.h"
+#include "database/text_search.h"
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+
+namespace {
+
+// Пересборка не раньше, чем наберётся столько мёртвых строк
+const size_t c_compact_min_dead = 1024;
+
+// Как часто (в строках) проверяется флаг отмены
+const size_t c_cancel_check_rows = 4096;
+
+inline bool is_cancelled(const std::atomic<bool>* cancelled) {
+    return cancelled && cancelled->load(std::memory_order_relaxed);
+}
+
+bool is_blank(const std::string& query) {
+    return std::all_of(query.begin(), query.end(), [](unsigned char c) { return std::isspace(c); });
+}
+
+} // namespace
+
+column_store_t::column_store_t() : m_dead(0), m_ordered(true) {}
+
+void column_store_t::append_(const password_entry_view_t& view) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    append_row_(view);
+}
+
+void column_store_t::replace_(const password_entry_view_t& view) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    remove_row_(view.m_id);
+    append_row_(view);
+}
+
+bool column_store_t::remove_(int id) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    return remove_row_(id);
+}
+
+void column_store_t::swap_(column_store_t& other) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    std::unique_lock<std::shared_mutex> otherLock(other.m_mutex);
+    for (int f = 0; f < c_field_count; ++f) {
+        std::swap(m_columns[f], other.m_columns[f]);
+    }
+    std::swap(m_ids, other.m_ids);
+    std::swap(m_alive, other.m_alive);
+    std::swap(m_rowById, other.m_rowById);
+    std::swap(m_dead, other.m_dead);
+    std::swap(m_ordered, other.m_ordered);
+}
+
+size_t column_store_t::size_() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_rowById.size();
+}
+
+void column_store_t::append_row_(const password_entry_view_t& view) {
+    const std::string_view texts[c_password] = {view.m_title, view.m_url, view.m_username, view.m_notes};
+    for (int f = 0; f < c_password; ++f) {
+        column_t& column = m_columns[f];
+        column.m_data.insert(column.m_data.end(), texts[f].begin(), texts[f].end());
+        column.m_offsets.push_back(column.m_data.size());
+    }
+    column_t& passwords = m_columns[c_password];
+    if (view.m_encryptedPassword) {
+        passwords.m_data.insert(passwords.m_data.end(), view.m_encryptedPassword,
+                                view.m_encryptedPassword + view.m_encryptedSize);
+    }
+    passwords.m_offsets.push_back(passwords.m_data.size());
+
+    if (!m_ids.empty() && view.m_id <= m_ids.back()) {
+        m_ordered = false;
+    }
+    m_rowById[view.m_id] = m_ids.size();
+    m_ids.push_back(view.m_id);
+    m_alive.push_back(1);
+}
+
+bool column_store_t::remove_row_(int id) {
+    auto it = m_rowById.find(id);
+    if (it == m_rowById.end()) {
+        return false;
+    }
+    m_alive[it->second] = 0;
+    m_rowById.erase(it);
+    ++m_dead;
+
+    if (m_dead >= c_compact_min_dead && m_dead > m_rowById.size()) {
+        compact_();
+    }
+    return true;
+}
+
+/**
+ * @brief Пересобирает колонки только из живых строк, по возрастанию ID.
+ */
+void column_store_t::compact_() {
+    std::vector<size_t> rows;
+    rows.reserve(m_rowById.size());
+    for (size_t row = 0; row < m_ids.size(); ++row) {
+        if (m_alive[row]) {
+            rows.push_back(row);
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [&](size_t a, size_t b) { return m_ids[a] < m_ids[b]; });
+
+    column_store_t compacted;
+    for (size_t row : rows) {
+        compacted.append_row_(view_(row));
+    }
+    for (int f = 0; f < c_field_count; ++f) {
+        m_columns[f] = std::move(compacted.m_columns[f]);
+    }
+    m_ids = std::move(compacted.m_ids);
+    m_alive = std::move(compacted.m_alive);
+    m_rowById = std::move(compacted.m_rowById);
+    m_dead = 0;
+    m_ordered = true;
+}
+
+password_entry_view_t column_store_t::view_(size_t row) const {
+    auto text = [&](field_t field) {
+        const column_t& column = m_columns[field];
+        size_t begin = column.m_offsets[row];
+        return std::string_view(column.m_data.data() + begin, column.m_offsets[row + 1] - begin);
+    };
+
+    password_entry_view_t view{};
+    view.m_id = m_ids[row];
+    view.m_title = text(c_title);
+    view.m_url = text(c_url);
+    view.m_username = text(c_username);
+    view.m_notes = text(c_notes);
+    const column_t& passwords = m_columns[c_password];
+    view.m_encryptedPassword = reinterpret_cast<const unsigned char*>(passwords.m_data.data()) +
+                               passwords.m_offsets[row];
+    view.m_encryptedSize = passwords.m_offsets[row + 1] - passwords.m_offsets[row];
+    return view;
+}
+
+bool column_store_t::scan_column_(field_t field, const std::string& foldedQuery,
+                                  std::vector<uint8_t>& matched, const std::atomic<bool>* cancelled) const {
+    const column_t& column = m_columns[field];
+    const char* data = column.m_data.data();
+    const size_t size = column.m_data.size();
+    const auto& offsets = column.m_offsets;
+
+    size_t pos = 0;
+    size_t row = 0;
+    while (pos < size) {
+        if (is_cancelled(cancelled)) {
+            return false;
+        }
+        size_t found = find_folded(data + pos, size - pos, foldedQuery);
+        if (found == std::string::npos) {
+            break;
+        }
+        found += pos;
+
+        // Строка, в которую попало начало совпадения (offsets не убывают)
+        row = static_cast<size_t>(std::upper_bound(offsets.begin() + row + 1, offsets.end(), found) -
+                                  offsets.begin()) - 1;
+        size_t rowEnd = offsets[row + 1];
+        if (found + foldedQuery.size() <= rowEnd) {
+            matched[row] = 1;
+            pos = rowEnd; // остаток строки уже не важен
+        } else {
+            pos = found + 1; // совпадение через границу строк
+        }
+    }
+    return true;
+}
+
+bool column_store_t::for_each_(const std::string& query, const entry_visitor_t& visitor,
+                               const std::atomic<bool>* cancelled) const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+    std::vector<size_t> rows;
+    if (is_blank(query)) {
+        rows.reserve(m_rowById.size());
+        for (size_t row = 0; row < m_ids.size(); ++row) {
+            if (m_alive[row]) {
+                rows.push_back(row);
+            }
+        }
+    } else {
+        std::string folded = fold_ascii(query);
+        std::vector<uint8_t> matched(m_ids.size(), 0);
+        for (field_t field : {c_title, c_url, c_username, c_notes}) {
+            if (!scan_column_(field, folded, matched, cancelled)) {
+                return false;
+            }
+        }
+        for (size_t row = 0; row < m_ids.size(); ++row) {
+            if (matched[row] && m_alive[row]) {
+                rows.push_back(row);
+            }
+        }
+    }
+
+    if (!m_ordered) {
+        std::sort(rows.begin(), rows.end(), [&](size_t a, size_t b) { return m_ids[a] < m_ids[b]; });
+    }
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (i % c_cancel_check_rows == 0 && is_cancelled(cancelled)) {
+            return false;
+        }
+        visitor(view_(rows[i]));
+    }
+    return true;
+}
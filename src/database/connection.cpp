@@ -0,0 +1,256 @@
+#include "database/connection.h"
+#include "metrics/metrics.h"
+#include <iostream>
+#include <string>
+
+namespace {
+
+/**
+ * @brief Тексты SQL-запросов, индексируются statement_id_t.
+ */
+const char* const c_statement_sql[] = {
+    // c_stmt_insert
+    "INSERT INTO passwords (title, url, username, password, notes) VALUES (?, ?, ?, ?, ?);",
+    // c_stmt_search
+    "SELECT id, title, url, username, password, notes FROM passwords "
+    "WHERE title LIKE ? ESCAPE '\\' OR url LIKE ? ESCAPE '\\' OR username LIKE ? ESCAPE '\\' "
+    "OR notes LIKE ? ESCAPE '\\';",
+    // c_stmt_delete
+    "DELETE FROM passwords WHERE id = ?;",
+    // c_stmt_get_password
+    "SELECT password FROM passwords WHERE id = ?;",
+    // c_stmt_get_by_id
+    "SELECT id, title, url, username, password, notes "
+    "FROM passwords WHERE id = ? LIMIT 1;",
+    // c_stmt_list_all
+    "SELECT id, title, url, username, password, notes FROM passwords ORDER BY id;",
+    // c_stmt_search_fts (веса bm25: title, url, username, notes)
+    "SELECT p.id, p.title, p.url, p.username, p.password, p.notes "
+    "FROM passwords_fts JOIN passwords p ON p.id = passwords_fts.rowid "
+    "WHERE passwords_fts MATCH ? "
+    "ORDER BY bm25(passwords_fts, 10.0, 5.0, 2.0, 1.0);",
+    // c_stmt_rekey_select
+    "SELECT id, password FROM passwords WHERE id > ? ORDER BY id LIMIT ?;",
+    // c_stmt_update_password
+    "UPDATE passwords SET password = ? WHERE id = ?;",
+    // c_stmt_rekey_mark
+    "INSERT OR REPLACE INTO rekey_state (id, last_id) VALUES (1, ?);",
+    // c_stmt_rekey_state
+    "SELECT last_id FROM rekey_state WHERE id = 1;",
+    // c_stmt_page_all (только метаданные, без BLOB с паролем)
+    "SELECT id, title, url, username, notes FROM passwords "
+    "WHERE id > ?1 ORDER BY id LIMIT ?2;",
+    // c_stmt_page_search
+    "SELECT id, title, url, username, notes FROM passwords "
+    "WHERE id > ?1 AND (title LIKE ?3 ESCAPE '\\' OR url LIKE ?3 ESCAPE '\\' "
+    "OR username LIKE ?3 ESCAPE '\\' OR notes LIKE ?3 ESCAPE '\\') "
+    "ORDER BY id LIMIT ?2;",
+    // c_stmt_page_fts
+    "SELECT p.id, p.title, p.url, p.username, p.notes "
+    "FROM passwords_fts JOIN passwords p ON p.id = passwords_fts.rowid "
+    "WHERE p.id > ?1 AND passwords_fts MATCH ?3 "
+    "ORDER BY p.id LIMIT ?2;",
+    // c_stmt_count_legacy (блоки не в формате AES-256-GCM)
+    "SELECT COUNT(*) FROM passwords WHERE length(password) < 29 OR substr(password, 1, 1) <> x'02';",
+    // c_stmt_header_select
+    "SELECT kdf, iterations, log_n, block_size, parallelism, salt, lanes FROM vault_header WHERE id = ?;",
+    // c_stmt_header_upsert
+    "INSERT OR REPLACE INTO vault_header (id, kdf, iterations, log_n, block_size, parallelism, salt, lanes) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?);",
+    // c_stmt_has_entries
+    "SELECT 1 FROM passwords LIMIT 1;",
+    // c_stmt_get_by_ids (?1 - JSON-массив ID)
+    "SELECT id, title, url, username, password, notes "
+    "FROM passwords WHERE id IN (SELECT value FROM json_each(?1));",
+    // c_stmt_get_passwords
+    "SELECT id, password FROM passwords WHERE id IN (SELECT value FROM json_each(?1));",
+    // c_stmt_first_gcm (блок AES-256-GCM для проверки ключа)
+    "SELECT password FROM passwords WHERE id > ? AND length(password) >= 29 AND substr(password, 1, 1) = x'02' "
+    "ORDER BY id LIMIT 1;",
+    // c_stmt_rekey_select_back (откат смены ключа - от маркера вниз)
+    "SELECT id, password FROM passwords WHERE id <= ? ORDER BY id DESC LIMIT ?;",
+    // c_stmt_rekey_count (сколько записей осталось перешифровать)
+    "SELECT COUNT(*) FROM passwords WHERE id > ?;",
+    // c_stmt_rekey_count_back (сколько записей откатить)
+    "SELECT COUNT(*) FROM passwords WHERE id <= ?;",
+    // c_stmt_key_check_select (контрольное значение мастер-пароля)
+    "SELECT key_check FROM vault_header WHERE id = ?;",
+    // c_stmt_key_check_update
+    "UPDATE vault_header SET key_check = ? WHERE id = ?;",
+};
+
+} // namespace
+
+storage_profile_t storage_profile_t::tuned_(const std::string& path) {
+    storage_profile_t profile;
+    profile.m_path = path;
+    return profile;
+}
+
+storage_profile_t storage_profile_t::sqlite_defaults_(const std::string& path) {
+    storage_profile_t profile;
+    profile.m_path = path;
+    profile.m_walMode = false;
+    profile.m_synchronous = sync_mode_t::full;
+    profile.m_mmapSize = 0;
+    profile.m_cacheSizeKib = 2000;
+    profile.m_tempStoreMemory = false;
+    profile.m_busyTimeoutMs = 0;
+    return profile;
+}
+
+storage_profile_t storage_profile_t::snapshot_(const std::string& path) {
+    storage_profile_t profile;
+    profile.m_path = path;
+    profile.m_snapshot = true;
+    return profile;
+}
+
+connection_t::connection_t() : m_db(nullptr), m_statements{}, m_updateStatements{} {}
+
+connection_t::~connection_t() {
+    finalize_statements_();
+    sqlite3_close(m_db); // безопасно для nullptr
+}
+
+bool connection_t::open_(const storage_profile_t& profile, bool readOnly) {
+    int flags = SQLITE_OPEN_NOMUTEX;
+    flags |= readOnly ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+
+    if (sqlite3_open_v2(profile.m_path.c_str(), &m_db, flags, nullptr) != SQLITE_OK) {
+        std::cerr << "Error opening database: " << sqlite3_errmsg(m_db) << std::endl;
+        return false;
+    }
+    return apply_profile_(profile, readOnly);
+}
+
+/**
+ * @brief Применяет PRAGMA профиля к только что открытому соединению.
+ *        Режим журнала относится ко всему файлу, его задаёт только пишущее соединение.
+ */
+bool connection_t::apply_profile_(const storage_profile_t& profile, bool readOnly) {
+    if (profile.m_busyTimeoutMs > 0) {
+        sqlite3_busy_timeout(m_db, profile.m_busyTimeoutMs);
+    }
+
+    const char* synchronous = "FULL";
+    if (profile.m_synchronous == sync_mode_t::off) {
+        synchronous = "OFF";
+    } else if (profile.m_synchronous == sync_mode_t::normal) {
+        synchronous = "NORMAL";
+    }
+
+    std::string pragmas;
+    if (profile.m_walMode && !readOnly) {
+        pragmas += "PRAGMA journal_mode=WAL;";
+    }
+    pragmas += std::string("PRAGMA synchronous=") + synchronous + ";";
+    pragmas += "PRAGMA mmap_size=" + std::to_string(profile.m_mmapSize) + ";";
+    pragmas += "PRAGMA cache_size=-" + std::to_string(profile.m_cacheSizeKib) + ";";
+    if (profile.m_tempStoreMemory) {
+        pragmas += "PRAGMA temp_store=MEMORY;";
+    }
+
+    return exec_(pragmas.c_str(), "storage profile");
+}
+
+bool connection_t::prepare_statements_(bool withFts) {
+    finalize_statements_();
+
+    bool ok = true;
+    for (int i = 0; i < c_stmt_count; ++i) {
+        // Выражения над passwords_fts готовятся только при наличии индекса
+        if ((i == c_stmt_search_fts || i == c_stmt_page_fts) && !withFts) {
+            continue;
+        }
+        METRICS_TIME(c_op_sql_prepare);
+        if (sqlite3_prepare_v3(m_db, c_statement_sql[i], -1, SQLITE_PREPARE_PERSISTENT,
+                               &m_statements[i], nullptr) != SQLITE_OK) {
+            std::cerr << "Error preparing statement: " << sqlite3_errmsg(m_db) << std::endl;
+            m_statements[i] = nullptr;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void connection_t::finalize_statements_() {
+    for (sqlite3_stmt*& stmt : m_statements) {
+        sqlite3_finalize(stmt); // безопасно для nullptr
+        stmt = nullptr;
+    }
+    for (sqlite3_stmt*& stmt : m_updateStatements) {
+        sqlite3_finalize(stmt);
+        stmt = nullptr;
+    }
+}
+
+sqlite3_stmt* connection_t::statement_(statement_id_t id, const char* what) {
+    sqlite3_stmt* stmt = m_statements[id];
+    if (!stmt) {
+        std::cerr << "Error: " << what << " statement is not prepared "
+                  << "(was init_database_ called?)" << std::endl;
+    }
+    return stmt;
+}
+
+sqlite3_stmt* connection_t::update_statement_(unsigned fields) {
+    fields &= c_field_all;
+    if (m_updateStatements[fields] || fields == 0) {
+        return m_updateStatements[fields];
+    }
+
+    // Столбцы в порядке битов entry_field_t; номер параметра = номер бита + 1
+    static const char* const columns[] = {"title", "url", "username", "password", "notes"};
+    std::string sql = "UPDATE passwords SET ";
+    for (int bit = 0; bit < 5; ++bit) {
+        if (fields & (1u << bit)) {
+            if (sql.back() != ' ') {
+                sql += ", ";
+            }
+            sql += columns[bit];
+            sql += " = ?" + std::to_string(bit + 1);
+        }
+    }
+    sql += " WHERE id = ?6 RETURNING id, title, url, username, password, notes;";
+
+    METRICS_TIME(c_op_sql_prepare);
+    if (sqlite3_prepare_v3(m_db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT,
+                           &m_updateStatements[fields], nullptr) != SQLITE_OK) {
+        std::cerr << "Error preparing update: " << sqlite3_errmsg(m_db) << std::endl;
+        m_updateStatements[fields] = nullptr;
+    }
+    return m_updateStatements[fields];
+}
+
+bool connection_t::exec_(const char* sql, const char* what) {
+    METRICS_TIME(c_op_sql_exec);
+    char* errMsg = nullptr;
+    if (sqlite3_exec(m_db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Error in " << what << ": " << (errMsg ? errMsg : sqlite3_errmsg(m_db)) << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+void connection_t::flush_cache_metrics_() {
+#ifdef PASSMAN_METRICS
+    int hits = 0, misses = 0, highwater = 0;
+    if (m_db && sqlite3_db_status(m_db, SQLITE_DBSTATUS_CACHE_HIT, &hits, &highwater, 1) == SQLITE_OK &&
+        sqlite3_db_status(m_db, SQLITE_DBSTATUS_CACHE_MISS, &misses, &highwater, 1) == SQLITE_OK) {
+        METRICS_ADD(c_counter_sqlite_cache_hits, hits);
+        METRICS_ADD(c_counter_sqlite_cache_misses, misses);
+    }
+#endif
+}
+
+int prepare_statement(sqlite3* db, const char* sql, sqlite3_stmt** stmt) {
+    METRICS_TIME(c_op_sql_prepare);
+    return sqlite3_prepare_v2(db, sql, -1, stmt, nullptr);
+}
+
+int step_statement(sqlite3_stmt* stmt) {
+    METRICS_TIME(c_op_sql_step);
+    return sqlite3_step(stmt);
+}
@@ -0,0 +1,47 @@
+#include "database/cursor.h"
+
+entry_cursor_t::entry_cursor_t(database_t& db, const std::string& query, size_t pageSize)
+    : m_db(db), m_query(query), m_pageSize(pageSize == 0 ? 1 : pageSize), m_lastId(0), m_finished(false) {}
+
+bool entry_cursor_t::next_page_(std::vector<password_entry_t>& page) {
+    if (m_finished) {
+        page.clear();
+        return false;
+    }
+
+    if (!m_db.list_page_(m_query, m_lastId, m_pageSize, page) || page.empty()) {
+        m_finished = true;
+        page.clear();
+        return false;
+    }
+
+    m_lastId = page.back().m_id;
+    // Неполная страница - последняя, лишний запрос не нужен
+    if (page.size() < m_pageSize) {
+        m_finished = true;
+    }
+    return true;
+}
+
+size_t entry_cursor_t::next_page_(const entry_visitor_t& visitor) {
+    if (m_finished) {
+        return 0;
+    }
+
+    size_t count = 0;
+    bool ok = m_db.visit_page_(m_query, m_lastId, m_pageSize, [&](const password_entry_view_t& view) {
+        m_lastId = view.m_id;
+        ++count;
+        visitor(view);
+    });
+
+    if (!ok || count < m_pageSize) {
+        m_finished = true;
+    }
+    return count;
+}
+
+void entry_cursor_t::rewind_() {
+    m_lastId = 0;
+    m_finished = false;
+}
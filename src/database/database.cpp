@@ -1,17 +1,371 @@
 #include "database/database.h"
+#include "database/entry_cache.h"
+#include "database/snapshot.h"
+#include "database/column_store.h"
+#include "database/fuzzy_search.h"
+#include <openssl/crypto.h>
 #include <iostream>
+#include <cctype>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
 
-database_t::database_t() {
-    if (sqlite3_open("passwords.db", &m_db) != SQLITE_OK) {
-        std::cerr << "Error opening database: " << sqlite3_errmsg(m_db) << std::endl;
+namespace {
+
+/**
+ * @brief true, если запрос пустой или состоит из одних пробелов.
+ */
+bool is_blank(const std::string& query) {
+    for (unsigned char c : query) {
+        if (!std::isspace(c)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Шаблон LIKE для поиска подстроки query: '%', '_' и '\' в запросе
+ *        экранируются (ESCAPE '\'), чтобы SQL-путь совпадал по смыслу с
+ *        колоночным хранилищем и снимком, где запрос - буквальная подстрока.
+ */
+std::string like_substring(const std::string& query) {
+    std::string pattern = "%";
+    for (char c : query) {
+        if (c == '%' || c == '_' || c == '\\') {
+            pattern += '\\';
+        }
+        pattern += c;
+    }
+    pattern += '%';
+    return pattern;
+}
+
+/**
+ * @brief Индекс FTS5 во внешнем контенте (строки хранятся только в passwords)
+ *        и триггеры, поддерживающие его в актуальном состоянии.
+ */
+const char* const c_fts_schema_sql =
+    "CREATE VIRTUAL TABLE IF NOT EXISTS passwords_fts USING fts5("
+    "title, url, username, notes, "
+    "content='passwords', content_rowid='id', "
+    "prefix='2 3', tokenize='unicode61 remove_diacritics 2'"
+    ");"
+    "CREATE TRIGGER IF NOT EXISTS passwords_fts_ai AFTER INSERT ON passwords BEGIN "
+    "INSERT INTO passwords_fts(rowid, title, url, username, notes) "
+    "VALUES (new.id, new.title, new.url, new.username, new.notes); "
+    "END;"
+    "CREATE TRIGGER IF NOT EXISTS passwords_fts_ad AFTER DELETE ON passwords BEGIN "
+    "INSERT INTO passwords_fts(passwords_fts, rowid, title, url, username, notes) "
+    "VALUES ('delete', old.id, old.title, old.url, old.username, old.notes); "
+    "END;"
+    // Смена одного лишь пароля индекс не трогает
+    "CREATE TRIGGER IF NOT EXISTS passwords_fts_au AFTER UPDATE OF title, url, username, notes ON passwords BEGIN "
+    "INSERT INTO passwords_fts(passwords_fts, rowid, title, url, username, notes) "
+    "VALUES ('delete', old.id, old.title, old.url, old.username, old.notes); "
+    "INSERT INTO passwords_fts(rowid, title, url, username, notes) "
+    "VALUES (new.id, new.title, new.url, new.username, new.notes); "
+    "END;";
+
+/**
+ * @brief Превращает пользовательский запрос в выражение FTS5:
+ *        каждое слово - префиксный запрос "слово"*, слова объединяются через AND.
+ * @return Пустая строка, если в запросе нет ни одного индексируемого слова.
+ */
+std::string build_fts_query(const std::string& query) {
+    std::string result;
+    size_t pos = 0;
+    while (pos < query.size()) {
+        while (pos < query.size() && std::isspace(static_cast<unsigned char>(query[pos]))) {
+            ++pos;
+        }
+        size_t end = pos;
+        while (end < query.size() && !std::isspace(static_cast<unsigned char>(query[end]))) {
+            ++end;
+        }
+        if (end == pos) {
+            break;
+        }
+
+        std::string token = query.substr(pos, end - pos);
+        pos = end;
+
+        // Слова только из пунктуации токенизатор всё равно выбросит
+        bool indexable = false;
+        for (unsigned char c : token) {
+            if (std::isalnum(c) || c >= 0x80) {
+                indexable = true;
+                break;
+            }
+        }
+        if (!indexable) {
+            continue;
+        }
+
+        if (!result.empty()) {
+            result += ' ';
+        }
+        result += '"';
+        for (char c : token) {
+            if (c == '"') {
+                result += '"'; // кавычки внутри строки FTS5 удваиваются
+            }
+            result += c;
+        }
+        result += "\"*";
+    }
+    return result;
+}
+
+/**
+ * @brief Сбрасывает выражение и его параметры при выходе из области видимости,
+ *        чтобы следующий вызов мог сразу привязать новые значения.
+ */
+class statement_guard_t {
+private:
+    sqlite3_stmt* m_stmt;
+
+public:
+    explicit statement_guard_t(sqlite3_stmt* stmt) : m_stmt(stmt) {}
+    ~statement_guard_t() {
+        sqlite3_reset(m_stmt);
+        sqlite3_clear_bindings(m_stmt);
+    }
+
+    statement_guard_t(const statement_guard_t&) = delete;
+    statement_guard_t& operator=(const statement_guard_t&) = delete;
+};
+
+// Строки vault_header: текущие параметры KDF и ожидающие конца смены мастер-пароля
+const int c_header_current = 1;
+const int c_header_pending = 2;
+
+bool read_kdf_row(connection_t& conn, int row, kdf_params_t& params) {
+    sqlite3_stmt* stmt = conn.statement_(c_stmt_header_select, "vault header");
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
+
+    sqlite3_bind_int(stmt, 1, row);
+    if (step_statement(stmt) != SQLITE_ROW) {
+        return false;
+    }
+    params.m_algorithm = static_cast<kdf_algorithm_t>(sqlite3_column_int(stmt, 0));
+    params.m_iterations = static_cast<uint32_t>(sqlite3_column_int64(stmt, 1));
+    params.m_scryptLogN = static_cast<uint32_t>(sqlite3_column_int64(stmt, 2));
+    params.m_scryptR = static_cast<uint32_t>(sqlite3_column_int64(stmt, 3));
+    params.m_scryptP = static_cast<uint32_t>(sqlite3_column_int64(stmt, 4));
+    const unsigned char* salt = reinterpret_cast<const unsigned char*>(sqlite3_column_blob(stmt, 5));
+    params.m_salt.assign(salt, salt + sqlite3_column_bytes(stmt, 5));
+    params.m_lanes = static_cast<uint32_t>(sqlite3_column_int64(stmt, 6));
+    return true;
+}
+
+bool write_kdf_row(connection_t& conn, int row, const kdf_params_t& params) {
+    sqlite3_stmt* stmt = conn.statement_(c_stmt_header_upsert, "vault header update");
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
+
+    sqlite3_bind_int(stmt, 1, row);
+    sqlite3_bind_int(stmt, 2, static_cast<int>(params.m_algorithm));
+    sqlite3_bind_int64(stmt, 3, params.m_iterations);
+    sqlite3_bind_int64(stmt, 4, params.m_scryptLogN);
+    sqlite3_bind_int64(stmt, 5, params.m_scryptR);
+    sqlite3_bind_int64(stmt, 6, params.m_scryptP);
+    sqlite3_bind_blob(stmt, 7, params.m_salt.data(), static_cast<int>(params.m_salt.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 8, params.m_lanes);
+    return step_statement(stmt) == SQLITE_DONE;
+}
+
+// Текст, который шифруется ключом хранилища для контрольного значения
+const char* const c_key_check_text = "passman key check";
+
+bool write_key_check(connection_t& conn, int row, const std::vector<unsigned char>& check) {
+    sqlite3_stmt* stmt = conn.statement_(c_stmt_key_check_update, "key check update");
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
+
+    sqlite3_bind_blob(stmt, 1, check.data(), static_cast<int>(check.size()), SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, row);
+    return step_statement(stmt) == SQLITE_DONE;
+}
+
+/**
+ * @brief Контекст шифра текущего потока для одиночных операций: ключ GCM
+ *        разворачивается один раз, а не на каждую запись.
+ */
+cipher_context_t& thread_cipher_context() {
+    thread_local cipher_context_t ctx;
+    return ctx;
+}
+
+/**
+ * @brief Сбрасывает кеш записей при выходе из области видимости.
+ */
+class cache_reset_t {
+private:
+    entry_cache_t* m_cache;
+
+public:
+    explicit cache_reset_t(entry_cache_t* cache) : m_cache(cache) {}
+    ~cache_reset_t() {
+        if (m_cache) {
+            m_cache->clear_();
+        }
+    }
+
+    cache_reset_t(const cache_reset_t&) = delete;
+    cache_reset_t& operator=(const cache_reset_t&) = delete;
+};
+
+/**
+ * @brief Вызывает reload при выходе из области видимости (если он задан).
+ */
+class columns_reload_t {
+private:
+    std::function<void()> m_reload;
+
+public:
+    explicit columns_reload_t(std::function<void()> reload) : m_reload(std::move(reload)) {}
+    ~columns_reload_t() {
+        if (m_reload) {
+            m_reload();
+        }
+    }
+
+    columns_reload_t(const columns_reload_t&) = delete;
+    columns_reload_t& operator=(const columns_reload_t&) = delete;
+};
+
+/**
+ * @brief Текстовая колонка как string_view над буфером SQLite (NULL - пустая строка).
+ */
+std::string_view column_view(sqlite3_stmt* stmt, int column) {
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+    if (!text) {
+        return {};
+    }
+    return std::string_view(text, static_cast<size_t>(sqlite3_column_bytes(stmt, column)));
+}
+
+/**
+ * @brief ID -> позиции в запросе пакета (один ID может встретиться несколько раз).
+ */
+using id_positions_t = std::unordered_map<int, std::vector<size_t>>;
+
+/**
+ * @brief JSON-массив ID для json_each(?) в запросах пакета.
+ */
+std::string json_id_list(const id_positions_t& positions) {
+    std::string json = "[";
+    for (const auto& item : positions) {
+        if (json.size() > 1) {
+            json += ',';
+        }
+        json += std::to_string(item.first);
+    }
+    json += ']';
+    return json;
+}
+
+} // namespace
+
+void password_entry_view_t::to_entry_(password_entry_t& entry) const {
+    entry.m_id = m_id;
+    entry.m_title.assign(m_title.data(), m_title.size());
+    entry.m_url.assign(m_url.data(), m_url.size());
+    entry.m_username.assign(m_username.data(), m_username.size());
+    if (m_encryptedPassword) {
+        entry.m_encryptedPassword.assign(m_encryptedPassword, m_encryptedPassword + m_encryptedSize);
+    } else {
+        entry.m_encryptedPassword.clear();
     }
+    entry.m_notes.assign(m_notes.data(), m_notes.size());
+}
+
+password_entry_view_t password_entry_view_t::of_(const password_entry_t& entry) {
+    password_entry_view_t view{};
+    view.m_id = entry.m_id;
+    view.m_title = entry.m_title;
+    view.m_url = entry.m_url;
+    view.m_username = entry.m_username;
+    view.m_encryptedPassword = entry.m_encryptedPassword.data();
+    view.m_encryptedSize = entry.m_encryptedPassword.size();
+    view.m_notes = entry.m_notes;
+    return view;
+}
+
+password_entry_view_t password_entry_view_t::of_(const pmr_password_entry_t& entry) {
+    password_entry_view_t view{};
+    view.m_id = entry.m_id;
+    view.m_title = entry.m_title;
+    view.m_url = entry.m_url;
+    view.m_username = entry.m_username;
+    view.m_encryptedPassword = entry.m_encryptedPassword.data();
+    view.m_encryptedSize = entry.m_encryptedPassword.size();
+    view.m_notes = entry.m_notes;
+    return view;
+}
+
+database_t::database_t() : database_t(storage_profile_t()) {}
+
+database_t::database_t(const storage_profile_t& profile) : m_profile(profile), m_ftsEnabled(false), m_fuzzyGeneration(0) {
+    if (m_profile.m_snapshot) {
+        m_snapshot.reset(new snapshot_t());
+        m_snapshot->open_(m_profile.m_path);
+        return;
+    }
+    m_writer.open_(m_profile, false);
 }
 
 database_t::~database_t() {
-    sqlite3_close(m_db);
+    // Читатели закрываются раньше писателя, чтобы последний закрытый
+    // (пишущий) дескриптор выполнил checkpoint WAL
+    m_idleReaders.clear();
+    m_readers.clear();
+}
+
+database_t::lease_t::lease_t(database_t& owner, bool forWrite) : m_owner(owner), m_conn(nullptr) {
+    if (forWrite || owner.m_readers.empty()) {
+        m_writerLock = std::unique_lock<std::mutex>(owner.m_writerMutex);
+        m_conn = &owner.m_writer;
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(owner.m_poolMutex);
+    owner.m_readerReleased.wait(lock, [&] { return !owner.m_idleReaders.empty(); });
+    m_conn = owner.m_idleReaders.back();
+    owner.m_idleReaders.pop_back();
+}
+
+database_t::lease_t::~lease_t() {
+    // Соединение ещё принадлежит этому потоку - счётчики кеша читаются безопасно
+    m_conn->flush_cache_metrics_();
+    if (m_writerLock.owns_lock()) {
+        return; // мьютекс писателя освободит unique_lock
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_owner.m_poolMutex);
+        m_owner.m_idleReaders.push_back(m_conn);
+    }
+    m_owner.m_readerReleased.notify_one();
 }
 
 void database_t::init_database_() {
+    // Снимок готов к чтению сразу после отображения
+    if (m_snapshot) {
+        return;
+    }
+
+    lease_t lease(*this, true);
+    connection_t& conn = lease.conn();
+
     const char* sql = 
         "CREATE TABLE IF NOT EXISTS passwords ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT, "
@@ -20,34 +374,127 @@ void database_t::init_database_() {
         "username TEXT NOT NULL, "
         "password BLOB NOT NULL, "
         "notes TEXT NOT NULL"
+        ");"
+        // Маркер прерванной смены мастер-пароля (не более одной строки)
+        "CREATE TABLE IF NOT EXISTS rekey_state ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1), "
+        "last_id INTEGER NOT NULL"
+        ");"
+        // Параметры KDF и соль хранилища: id 1 - текущие, id 2 - на время смены
+        // мастер-пароля. Нет строки - старая схема (PBKDF2-SHA1, c_static_salt)
+        "CREATE TABLE IF NOT EXISTS vault_header ("
+        "id INTEGER PRIMARY KEY CHECK (id IN (1, 2)), "
+        "kdf INTEGER NOT NULL, "
+        "iterations INTEGER NOT NULL, "
+        "log_n INTEGER NOT NULL, "
+        "block_size INTEGER NOT NULL, "
+        "parallelism INTEGER NOT NULL, "
+        "salt BLOB NOT NULL, "
+        "lanes INTEGER NOT NULL DEFAULT 1, "
+        // Блок GCM с c_key_check_text под ключом хранилища: проверяет мастер-пароль
+        "key_check BLOB"
         ");";
 
+    conn.exec_(sql, "creating tables");
+
+    // Заголовки, созданные до появления полос KDF, - без столбца lanes
+    {
+        sqlite3_stmt* stmt = nullptr;
+        const char* probeSql = "SELECT lanes FROM vault_header LIMIT 0;";
+        bool hasLanes = prepare_statement(conn.handle_(), probeSql, &stmt) == SQLITE_OK;
+        sqlite3_finalize(stmt);
+        if (!hasLanes) {
+            conn.exec_("ALTER TABLE vault_header ADD COLUMN lanes INTEGER NOT NULL DEFAULT 1;",
+                       "upgrading vault header");
+        }
+    }
+    // ... и до появления контрольного значения ключа - без столбца key_check
+    {
+        sqlite3_stmt* stmt = nullptr;
+        const char* probeSql = "SELECT key_check FROM vault_header LIMIT 0;";
+        bool hasKeyCheck = prepare_statement(conn.handle_(), probeSql, &stmt) == SQLITE_OK;
+        sqlite3_finalize(stmt);
+        if (!hasKeyCheck) {
+            conn.exec_("ALTER TABLE vault_header ADD COLUMN key_check BLOB;", "upgrading vault header");
+        }
+    }
+
+    m_ftsEnabled = init_fts_index_(conn);
+    conn.prepare_statements_(m_ftsEnabled);
+    open_readers_();
+}
+
+/**
+ * @brief Открывает пул соединений-читателей (после создания схемы).
+ *        Для базы в памяти пул не создаётся: у каждого соединения была бы своя база.
+ */
+void database_t::open_readers_() {
+    std::lock_guard<std::mutex> lock(m_poolMutex);
+    m_idleReaders.clear();
+    m_readers.clear();
+
+    if (m_profile.m_path.empty() || m_profile.m_path == ":memory:") {
+        return;
+    }
+
+    for (int i = 0; i < m_profile.m_readConnections; ++i) {
+        std::unique_ptr<connection_t> reader(new connection_t());
+        if (!reader->open_(m_profile, true) || !reader->prepare_statements_(m_ftsEnabled)) {
+            std::cerr << "Error opening read connection, continuing with "
+                      << m_readers.size() << " readers" << std::endl;
+            break;
+        }
+        m_idleReaders.push_back(reader.get());
+        m_readers.push_back(std::move(reader));
+    }
+}
+
+/**
+ * @brief Создаёт индекс FTS5 и триггеры; при первом создании индексирует
+ *        уже существующие записи.
+ * @return false, если SQLite собран без FTS5 (поиск тогда идёт через LIKE)
+ */
+bool database_t::init_fts_index_(connection_t& conn) {
+    bool existed = false;
+    {
+        sqlite3_stmt* stmt = nullptr;
+        const char* sql = "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'passwords_fts';";
+        if (prepare_statement(conn.handle_(), sql, &stmt) == SQLITE_OK) {
+            existed = (step_statement(stmt) == SQLITE_ROW);
+        }
+        sqlite3_finalize(stmt);
+    }
+
     char* errMsg = nullptr;
-    if (sqlite3_exec(m_db, sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
-        std::cerr << "Error creating table: " << errMsg << std::endl;
+    if (sqlite3_exec(conn.handle_(), c_fts_schema_sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+        std::cerr << "Full-text index unavailable, falling back to LIKE search: "
+                  << errMsg << std::endl;
         sqlite3_free(errMsg);
+        return false;
+    }
+
+    if (!existed) {
+        const char* rebuildSql = "INSERT INTO passwords_fts(passwords_fts) VALUES ('rebuild');";
+        if (!conn.exec_(rebuildSql, "building full-text index")) {
+            return false;
+        }
     }
+    return true;
 }
 
-bool database_t::add_entry_(
+bool database_t::insert_entry_(
+    connection_t& conn,
     const std::string& title,
     const std::string& url,
     const std::string& username,
-    const std::string& password,
-    const std::string& notes,
-    const std::string& masterPassword
+    const std::vector<unsigned char>& encryptedPassword,
+    const std::string& notes
 ) {
-    // Генерируем ключ и шифруем пароль
-    std::vector<unsigned char> key = m_encryption.derive_key_(masterPassword);
-    std::vector<unsigned char> encryptedPassword = m_encryption.encrypt_aes_(password, key);
-
-    const char* sql = "INSERT INTO passwords (title, url, username, password, notes) VALUES (?, ?, ?, ?, ?);";
-    sqlite3_stmt* stmt = nullptr;
-
-    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Error preparing insert statement: " << sqlite3_errmsg(m_db) << std::endl;
+    sqlite3_stmt* stmt = conn.statement_(c_stmt_insert, "insert");
+    if (!stmt) {
         return false;
     }
+    statement_guard_t guard(stmt);
 
     sqlite3_bind_text(stmt, 1, title.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, url.c_str(), -1, SQLITE_STATIC);
@@ -55,89 +502,369 @@ bool database_t::add_entry_(
     sqlite3_bind_blob(stmt, 4, encryptedPassword.data(), (int)encryptedPassword.size(), SQLITE_STATIC);
     sqlite3_bind_text(stmt, 5, notes.c_str(), -1, SQLITE_STATIC);
 
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-    sqlite3_finalize(stmt);
-    return success;
+    return step_statement(stmt) == SQLITE_DONE;
 }
 
-std::vector<password_entry_t> database_t::search_entries_(
-    const std::string& query,
-    const std::string& /* masterPassword */
+bool database_t::add_entry_(
+    const std::string& title,
+    const std::string& url,
+    const std::string& username,
+    const std::string& password,
+    const std::string& notes,
+    const session_key_t& key
+) {
+    if (reject_write_("adding entries")) {
+        return false;
+    }
+
+    // Шифруем пароль ключом сессии (PBKDF2 уже выполнен при разблокировке)
+    std::vector<unsigned char> encryptedPassword = m_encryption.encrypt_aes_(thread_cipher_context(), password, key);
+
+    lease_t lease(*this, true);
+    if (!insert_entry_(lease.conn(), title, url, username, encryptedPassword, notes)) {
+        return false;
+    }
+    if (m_columns) {
+        password_entry_view_t view{static_cast<int>(sqlite3_last_insert_rowid(lease.conn().handle_())),
+                                   title, url, username, encryptedPassword.data(), encryptedPassword.size(),
+                                   notes};
+        m_columns->append_(view);
+    }
+    invalidate_fuzzy_();
+    return true;
+}
+
+import_result_t database_t::import_entries_(
+    entry_reader_t& reader,
+    const session_key_t& key,
+    size_t batchSize
 ) {
+    import_result_t result{true, "", 0, 0, 0.0, 0.0};
+    if (reject_write_("import")) {
+        result.m_ok = false;
+        result.m_error = "vault snapshot is read-only";
+        return result;
+    }
+    if (batchSize == 0) {
+        batchSize = 1;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+
+    // Пакет читается целиком, шифруется параллельно и вставляется одной транзакцией
+    std::vector<import_row_t> batch;
+    std::vector<std::vector<unsigned char>> encrypted;
+    std::vector<int> insertedIds; // для колоночного хранилища, 0 - строка не вставлена
+    batch.reserve(batchSize);
+
+    bool readerDone = false;
+    while (!readerDone && result.m_ok) {
+        batch.clear();
+        while (batch.size() < batchSize) {
+            // Строка читается сразу в пакет: пароль не остаётся в промежуточной копии
+            batch.emplace_back();
+            if (!reader.next_(batch.back())) {
+                batch.pop_back();
+                readerDone = true;
+                break;
+            }
+        }
+        if (batch.empty()) {
+            break;
+        }
+
+        encrypted.assign(batch.size(), {});
+        m_cryptoPool.parallel_for_(batch.size(), [&](cipher_context_t& ctx, size_t i) {
+            std::string& password = batch[i].m_password;
+            encrypted[i] = m_encryption.encrypt_aes_(ctx, password, key);
+            OPENSSL_cleanse(&password[0], password.size());
+        });
+
+        // Писатель захватывается на пакет, чтобы читатели не ждали весь импорт
+        lease_t lease(*this, true);
+        connection_t& conn = lease.conn();
+        if (!conn.exec_("BEGIN IMMEDIATE;", "import transaction")) {
+            result.m_ok = false;
+            result.m_error = conn.errmsg_();
+            result.m_failed += batch.size(); // пакет прочитан, но не записан
+            break;
+        }
+
+        size_t batchImported = 0; // пропадут, если COMMIT не удастся
+        insertedIds.assign(batch.size(), 0);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            const import_row_t& entry = batch[i];
+            if (insert_entry_(conn, entry.m_title, entry.m_url, entry.m_username, encrypted[i], entry.m_notes)) {
+                ++batchImported;
+                insertedIds[i] = static_cast<int>(sqlite3_last_insert_rowid(conn.handle_()));
+            } else {
+                ++result.m_failed;
+            }
+        }
+
+        if (conn.exec_("COMMIT;", "import commit")) {
+            result.m_imported += batchImported;
+            invalidate_fuzzy_();
+            for (size_t i = 0; m_columns && i < batch.size(); ++i) {
+                if (insertedIds[i] != 0) {
+                    const import_row_t& entry = batch[i];
+                    m_columns->append_(password_entry_view_t{insertedIds[i], entry.m_title, entry.m_url,
+                                                             entry.m_username, encrypted[i].data(),
+                                                             encrypted[i].size(), entry.m_notes});
+                }
+            }
+        } else {
+            result.m_ok = false;
+            result.m_error = conn.errmsg_();
+            result.m_failed += batchImported; // вставки пакета откатываются
+            conn.exec_("ROLLBACK;", "import rollback");
+        }
+    }
+
+    if (!reader.error_().empty()) {
+        result.m_ok = false;
+        result.m_error = reader.error_();
+    }
+
+    result.m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (result.m_seconds > 0.0) {
+        result.m_rowsPerSecond = result.m_imported / result.m_seconds;
+    }
+    return result;
+}
+
+std::vector<password_entry_t> database_t::search_entries_(const std::string& query) {
     std::vector<password_entry_t> results;
-    const char* sql = 
-        "SELECT id, title, url, username, password, notes FROM passwords "
-        "WHERE title LIKE ? OR url LIKE ? OR username LIKE ? OR notes LIKE ?;";
+    for_each_entry_(query, [&](const password_entry_view_t& view) {
+        results.emplace_back();
+        view.to_entry_(results.back());
+    });
+    return results;
+}
 
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Error preparing search statement: " << sqlite3_errmsg(m_db) << std::endl;
-        return results;
+bool database_t::search_entries_(const std::string& query, entry_result_set_t& results) {
+    results.clear_();
+    return for_each_entry_(query, [&](const password_entry_view_t& view) {
+        pmr_password_entry_t& entry = results.append_();
+        entry.m_id = view.m_id;
+        entry.m_title.assign(view.m_title.data(), view.m_title.size());
+        entry.m_url.assign(view.m_url.data(), view.m_url.size());
+        entry.m_username.assign(view.m_username.data(), view.m_username.size());
+        if (view.m_encryptedPassword) {
+            entry.m_encryptedPassword.assign(view.m_encryptedPassword,
+                                             view.m_encryptedPassword + view.m_encryptedSize);
+        }
+        entry.m_notes.assign(view.m_notes.data(), view.m_notes.size());
+    });
+}
+
+bool database_t::for_each_entry_(const std::string& query, const entry_visitor_t& visitor,
+                                 const std::atomic<bool>* cancelled) {
+    if (m_columns) {
+        return m_columns->for_each_(query, visitor, cancelled);
+    }
+    if (m_snapshot) {
+        return m_snapshot->for_each_(query, visitor, cancelled);
     }
 
-    std::string likeQuery = "%" + query + "%";
+    lease_t lease(*this, false);
+    connection_t& conn = lease.conn();
+
+    // Пустой запрос - все записи по порядку ID
+    if (is_blank(query)) {
+        sqlite3_stmt* stmt = conn.statement_(c_stmt_list_all, "list");
+        if (!stmt) {
+            return false;
+        }
+        statement_guard_t guard(stmt);
+        return visit_rows_(stmt, true, visitor, cancelled);
+    }
+
+    std::string ftsQuery = m_ftsEnabled ? build_fts_query(query) : std::string();
+    if (!ftsQuery.empty()) {
+        sqlite3_stmt* stmt = conn.statement_(c_stmt_search_fts, "full-text search");
+        if (!stmt) {
+            return false;
+        }
+        statement_guard_t guard(stmt);
+
+        sqlite3_bind_text(stmt, 1, ftsQuery.c_str(), -1, SQLITE_STATIC);
+        return visit_rows_(stmt, true, visitor, cancelled);
+    }
+
+    // Запасной путь: поиск подстроки полным сканированием
+    sqlite3_stmt* stmt = conn.statement_(c_stmt_search, "search");
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
+
+    std::string likeQuery = like_substring(query);
     for (int i = 1; i <= 4; ++i) {
         sqlite3_bind_text(stmt, i, likeQuery.c_str(), -1, SQLITE_STATIC);
     }
+    return visit_rows_(stmt, true, visitor, cancelled);
+}
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        password_entry_t entry;
-        entry.m_id = sqlite3_column_int(stmt, 0);
-        entry.m_title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        entry.m_url = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        entry.m_username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+bool database_t::list_page_(
+    const std::string& query,
+    int afterId,
+    size_t limit,
+    std::vector<password_entry_t>& page
+) {
+    // Строки страницы переиспользуются, чтобы не выделять память заново
+    size_t count = 0;
+    bool ok = visit_page_(query, afterId, limit, [&](const password_entry_view_t& view) {
+        if (count == page.size()) {
+            page.emplace_back();
+        }
+        view.to_entry_(page[count++]);
+    });
+    page.resize(count);
+    return ok;
+}
 
-        const unsigned char* encryptedData = 
-            reinterpret_cast<const unsigned char*>(sqlite3_column_blob(stmt, 4));
-        int dataSize = sqlite3_column_bytes(stmt, 4);
-        entry.m_encryptedPassword.assign(encryptedData, encryptedData + dataSize);
+bool database_t::visit_page_(
+    const std::string& query,
+    int afterId,
+    size_t limit,
+    const entry_visitor_t& visitor
+) {
+    if (m_snapshot) {
+        return m_snapshot->visit_page_(query, afterId, limit, visitor);
+    }
 
-        entry.m_notes = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    lease_t lease(*this, false);
+    connection_t& conn = lease.conn();
 
-        results.push_back(entry);
+    sqlite3_stmt* stmt = nullptr;
+    std::string pattern;
+    if (is_blank(query)) {
+        stmt = conn.statement_(c_stmt_page_all, "page");
+    } else {
+        pattern = m_ftsEnabled ? build_fts_query(query) : std::string();
+        if (!pattern.empty()) {
+            stmt = conn.statement_(c_stmt_page_fts, "full-text page");
+        } else {
+            pattern = like_substring(query);
+            stmt = conn.statement_(c_stmt_page_search, "search page");
+        }
     }
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
 
-    sqlite3_finalize(stmt);
-    return results;
+    sqlite3_bind_int(stmt, 1, afterId);
+    sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(limit));
+    if (!pattern.empty()) {
+        sqlite3_bind_text(stmt, 3, pattern.c_str(), -1, SQLITE_STATIC);
+    }
+
+    return visit_rows_(stmt, false, visitor);
+}
+
+/**
+ * @brief Обходит строки выражения, передавая в visitor представления без копирования.
+ * @param withPassword Колонки (id, title, url, username, password, notes), иначе
+ *                     проекция без пароля (id, title, url, username, notes)
+ */
+bool database_t::visit_rows_(sqlite3_stmt* stmt, bool withPassword, const entry_visitor_t& visitor,
+                             const std::atomic<bool>* cancelled) {
+    password_entry_view_t view{};
+
+    int rc;
+    while ((rc = step_statement(stmt)) == SQLITE_ROW) {
+        if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+            return false; // выражение сбросит statement_guard_t вызывающего
+        }
+        view.m_id = sqlite3_column_int(stmt, 0);
+        view.m_title = column_view(stmt, 1);
+        view.m_url = column_view(stmt, 2);
+        view.m_username = column_view(stmt, 3);
+        if (withPassword) {
+            view.m_encryptedPassword = reinterpret_cast<const unsigned char*>(sqlite3_column_blob(stmt, 4));
+            view.m_encryptedSize = static_cast<size_t>(sqlite3_column_bytes(stmt, 4));
+            view.m_notes = column_view(stmt, 5);
+        } else {
+            view.m_notes = column_view(stmt, 4);
+        }
+        visitor(view);
+    }
+
+    if (rc != SQLITE_DONE) {
+        std::cerr << "Error reading entries: " << sqlite3_errmsg(sqlite3_db_handle(stmt)) << std::endl;
+        return false;
+    }
+    return true;
 }
 
 bool database_t::delete_entry_(int id) {
-    const char* sql = "DELETE FROM passwords WHERE id = ?;";
-    sqlite3_stmt* stmt = nullptr;
-    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Error preparing delete statement: " << sqlite3_errmsg(m_db) << std::endl;
+    if (reject_write_("deleting entries")) {
         return false;
     }
+    lease_t lease(*this, true);
+    sqlite3_stmt* stmt = lease.conn().statement_(c_stmt_delete, "delete");
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
 
     sqlite3_bind_int(stmt, 1, id);
-    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-    sqlite3_finalize(stmt);
-    return success;
+    bool ok = step_statement(stmt) == SQLITE_DONE;
+    if (m_cache) {
+        m_cache->invalidate_(id);
+    }
+    if (ok && m_columns) {
+        m_columns->remove_(id);
+    }
+    if (ok) {
+        invalidate_fuzzy_();
+    }
+    return ok;
 }
 
-std::string database_t::get_decrypted_password_(int id, const std::string& masterPassword) {
+std::string database_t::get_decrypted_password_(int id, const session_key_t& key) {
     std::string decrypted;
-    const char* sql = "SELECT password FROM passwords WHERE id = ?;";
-    sqlite3_stmt* stmt = nullptr;
 
-    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Error preparing get password statement: " << sqlite3_errmsg(m_db) << std::endl;
+    // Снимок читается прямо из отображения, кеш ему не нужен
+    if (m_snapshot) {
+        m_snapshot->visit_(id, [&](const password_entry_view_t& view) {
+            decrypted = m_encryption.decrypt_aes_(thread_cipher_context(), view.m_encryptedPassword,
+                                                  view.m_encryptedSize, key);
+        });
+        return decrypted;
+    }
+
+    uint64_t generation = 0;
+    if (m_cache) {
+        if (m_cache->get_secret_(id, decrypted)) {
+            return decrypted;
+        }
+        generation = m_cache->generation_();
+    }
+
+    lease_t lease(*this, false);
+    sqlite3_stmt* stmt = lease.conn().statement_(c_stmt_get_password, "get password");
+    if (!stmt) {
         return "";
     }
+    statement_guard_t guard(stmt);
 
     sqlite3_bind_int(stmt, 1, id);
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    if (step_statement(stmt) == SQLITE_ROW) {
         const unsigned char* data = 
             reinterpret_cast<const unsigned char*>(sqlite3_column_blob(stmt, 0));
         int size = sqlite3_column_bytes(stmt, 0);
 
-        std::vector<unsigned char> encryptedData(data, data + size);
-        std::vector<unsigned char> key = m_encryption.derive_key_(masterPassword);
-
-        decrypted = m_encryption.decrypt_aes_(encryptedData, key);
+        // В кеш попадает только расшифрованный пароль: пустая строка после
+        // неудачи (например, ключом до смены мастер-пароля) закрепилась бы до TTL
+        bool ok = m_encryption.decrypt_checked_(thread_cipher_context(), data, size, key, decrypted);
+        if (ok && m_cache) {
+            m_cache->put_secret_(id, decrypted, generation);
+        }
     }
 
-    sqlite3_finalize(stmt);
     return decrypted;
 }
 
@@ -148,109 +875,861 @@ bool database_t::update_entry_(
     const std::string& newUsername,
     const std::string& newPassword,
     const std::string& newNotes,
-    const std::string& masterPassword
+    const session_key_t& key
+) {
+    entry_update_t update{0, newTitle, newUrl, newUsername, newPassword, newNotes};
+    const std::string* values[] = {&newTitle, &newUrl, &newUsername, &newPassword, &newNotes};
+    for (int bit = 0; bit < 5; ++bit) {
+        if (!values[bit]->empty()) {
+            update.m_fields |= 1u << bit;
+        }
+    }
+    return update_fields_(id, update, key);
+}
+
+bool database_t::update_fields_(int id, const entry_update_t& update, const session_key_t& key) {
+    if (reject_write_("editing entries")) {
+        return false;
+    }
+    unsigned fields = update.m_fields & c_field_all;
+    if (!fields) {
+        // Менять нечего - только проверяем, что запись есть
+        return visit_entry_by_id_(id, [](const password_entry_view_t&) {});
+    }
+
+    // Шифруем до захвата писателя, чтобы не держать его на время AES
+    std::vector<unsigned char> encryptedPass;
+    if (fields & c_field_password) {
+        encryptedPass = m_encryption.encrypt_aes_(thread_cipher_context(), update.m_password, key);
+    }
+
+    lease_t lease(*this, true);
+    sqlite3_stmt* stmt = lease.conn().update_statement_(fields);
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
+
+    if (fields & c_field_title) {
+        sqlite3_bind_text(stmt, 1, update.m_title.c_str(), -1, SQLITE_STATIC);
+    }
+    if (fields & c_field_url) {
+        sqlite3_bind_text(stmt, 2, update.m_url.c_str(), -1, SQLITE_STATIC);
+    }
+    if (fields & c_field_username) {
+        sqlite3_bind_text(stmt, 3, update.m_username.c_str(), -1, SQLITE_STATIC);
+    }
+    if (fields & c_field_password) {
+        sqlite3_bind_blob(stmt, 4, encryptedPass.data(), (int)encryptedPass.size(), SQLITE_STATIC);
+    }
+    if (fields & c_field_notes) {
+        sqlite3_bind_text(stmt, 5, update.m_notes.c_str(), -1, SQLITE_STATIC);
+    }
+    sqlite3_bind_int(stmt, 6, id);
+
+    // RETURNING отдаёт запись после изменения; строки нет - нет и записи с таким ID
+    bool found = false;
+    bool ok = visit_rows_(stmt, true, [&](const password_entry_view_t& view) {
+        found = true;
+        if (m_columns) {
+            m_columns->replace_(view);
+        }
+    });
+    if (m_cache) {
+        m_cache->invalidate_(id);
+    }
+    // Нечёткий индекс хранит только метаданные
+    if (ok && found && (fields & ~c_field_password)) {
+        invalidate_fuzzy_();
+    }
+    return ok && found;
+}
+
+std::vector<std::string> database_t::decrypt_entries_(
+    const password_entry_t* entries,
+    size_t count,
+    const session_key_t& key,
+    std::vector<char>* decrypted
 ) {
-    // 1) Сначала прочитаем текущие данные
-    const char* selectSql = "SELECT title, url, username, password, notes FROM passwords WHERE id = ?;";
-    sqlite3_stmt* selectStmt = nullptr;
+    std::vector<ciphertext_ref_t> ciphertexts(count);
+    for (size_t i = 0; i < count; ++i) {
+        ciphertexts[i] = {entries[i].m_encryptedPassword.data(), entries[i].m_encryptedPassword.size()};
+    }
+    return m_cryptoPool.decrypt_batch_(ciphertexts, key, decrypted);
+}
+
+size_t database_t::legacy_entry_count_() {
+    if (m_snapshot) {
+        size_t count = 0;
+        m_snapshot->for_each_("", [&](const password_entry_view_t& view) {
+            if (view.m_encryptedSize < encryption_t::c_gcm_overhead ||
+                view.m_encryptedPassword[0] != encryption_t::c_format_gcm) {
+                ++count;
+            }
+        });
+        return count;
+    }
+
+    lease_t lease(*this, false);
+    sqlite3_stmt* stmt = lease.conn().statement_(c_stmt_count_legacy, "count legacy");
+    if (!stmt) {
+        return 0;
+    }
+    statement_guard_t guard(stmt);
+
+    if (step_statement(stmt) != SQLITE_ROW) {
+        return 0;
+    }
+    return static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+}
 
-    if (sqlite3_prepare_v2(m_db, selectSql, -1, &selectStmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Error preparing select statement: " << sqlite3_errmsg(m_db) << std::endl;
+bool database_t::migrate_cipher_(const session_key_t& key, size_t chunkSize, const rekey_callback_t& progress) {
+    // Перешифровка тем же ключом: rekey_ расшифровывает любой формат, а пишет GCM
+    return rekey_(key, key, chunkSize, progress);
+}
+
+bool database_t::rekey_in_progress_(int* lastId) {
+    if (m_snapshot) {
         return false;
     }
-    sqlite3_bind_int(selectStmt, 1, id);
+    lease_t lease(*this, false);
+    return rekey_state_(lease.conn(), lastId);
+}
 
-    std::string oldTitle, oldUrl, oldUsername, oldNotes;
-    std::vector<unsigned char> oldEncryptedPass;
+/**
+ * @brief Читает маркер прерванной смены мастер-пароля на уже захваченном соединении.
+ */
+bool database_t::rekey_state_(connection_t& conn, int* lastId) {
+    sqlite3_stmt* stmt = conn.statement_(c_stmt_rekey_state, "rekey state");
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
 
-    if (sqlite3_step(selectStmt) == SQLITE_ROW) {
-        oldTitle = reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 0));
-        oldUrl = reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 1));
-        oldUsername = reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 2));
+    if (step_statement(stmt) != SQLITE_ROW) {
+        return false;
+    }
+    if (lastId) {
+        *lastId = sqlite3_column_int(stmt, 0);
+    }
+    return true;
+}
 
-        const unsigned char* data = 
-            reinterpret_cast<const unsigned char*>(sqlite3_column_blob(selectStmt, 3));
-        int size = sqlite3_column_bytes(selectStmt, 3);
-        oldEncryptedPass.assign(data, data + size);
+bool database_t::rekey_(
+    const session_key_t& oldKey,
+    const session_key_t& newKey,
+    size_t chunkSize,
+    const rekey_callback_t& progress,
+    const kdf_params_t* newParams,
+    const std::atomic<bool>* cancelled
+) {
+    if (reject_write_("changing the master password")) {
+        return false;
+    }
+    if (chunkSize == 0) {
+        chunkSize = 1;
+    }
 
-        oldNotes = reinterpret_cast<const char*>(sqlite3_column_text(selectStmt, 4));
-    } else {
-        // Записи с таким ID нет
-        sqlite3_finalize(selectStmt);
+    // Писатель занят на всё время смены ключа; читатели видят записи,
+    // зашифрованные старым или новым ключом (как и при прерванном запуске)
+    lease_t lease(*this, true);
+    connection_t& conn = lease.conn();
+
+    // Пароли в базе меняются - кеш сбрасывается при любом выходе,
+    // а колоночное хранилище перечитывается с уже перешифрованными паролями
+    cache_reset_t cacheReset(m_cache.get());
+    columns_reload_t columnsReload(m_columns ? [&] { reload_columns_(conn); } : std::function<void()>());
+
+    int lastId = 0;
+    bool resuming = rekey_state_(conn, &lastId);
+
+    // При возобновлении убеждаемся, что newKey - тот же, что и в прерванном запуске
+    if (resuming && lastId > 0) {
+        sqlite3_stmt* stmt = conn.statement_(c_stmt_get_password, "get password");
+        if (!stmt) {
+            return false;
+        }
+        statement_guard_t guard(stmt);
+        sqlite3_bind_int(stmt, 1, lastId);
+        if (step_statement(stmt) == SQLITE_ROW) {
+            // Этот блок записан прерванным запуском, значит, он в GCM: ключ проверяет только тег
+            cipher_context_t ctx;
+            std::string probe;
+            bool authenticated = false;
+            const unsigned char* data = reinterpret_cast<const unsigned char*>(sqlite3_column_blob(stmt, 0));
+            m_encryption.decrypt_checked_(ctx, data, sqlite3_column_bytes(stmt, 0), newKey, probe, &authenticated);
+            std::fill(probe.begin(), probe.end(), '\0');
+            if (!authenticated) {
+                std::cerr << "Error: the new master password does not match the interrupted rotation" << std::endl;
+                return false;
+            }
+        }
+    }
+
+    // Дополнение CBC не проверяет ключ: при смене ключа старые блоки CBC
+    // сначала переводятся в GCM тем же ключом (migrate_cipher_)
+    if (!resuming && !oldKey.equals_(newKey)) {
+        sqlite3_stmt* stmt = conn.statement_(c_stmt_count_legacy, "count legacy");
+        if (!stmt) {
+            return false;
+        }
+        statement_guard_t guard(stmt);
+        if (step_statement(stmt) != SQLITE_ROW || sqlite3_column_int64(stmt, 0) > 0) {
+            std::cerr << "Error: upgrade the entries in the old AES-128-CBC format before "
+                      << "changing the master password" << std::endl;
+            return false;
+        }
+    }
+
+    // Старый ключ проверяется контрольным значением заголовка или тегом первого
+    // ещё не перешифрованного блока GCM. Без такой проверки перешифровка тем же
+    // ключом не начинается: дополнение CBC пропускает неверный ключ, и мусор
+    // навсегда стал бы аутентифицированным блоком GCM
+    key_check_t check = check_key_(conn, oldKey, lastId);
+    if (check == key_check_t::mismatch) {
+        std::cerr << "Error: could not decrypt entries with the old master password" << std::endl;
+        return false;
+    }
+    if (check == key_check_t::unknown && oldKey.equals_(newKey) && !(resuming && lastId > 0)) {
+        std::cerr << "Error: the master password cannot be verified "
+                  << "(no key check in the vault header and no AES-256-GCM entries)" << std::endl;
         return false;
     }
 
-    sqlite3_finalize(selectStmt);
+    rekey_progress_t state{0, 0, lastId};
+    {
+        sqlite3_stmt* countStmt = conn.statement_(c_stmt_rekey_count, "rekey count");
+        if (!countStmt) {
+            return false;
+        }
+        statement_guard_t guard(countStmt);
+        sqlite3_bind_int(countStmt, 1, lastId);
+        if (step_statement(countStmt) == SQLITE_ROW) {
+            state.m_total = static_cast<size_t>(sqlite3_column_int64(countStmt, 0));
+        }
+    }
+
+    sqlite3_stmt* selectStmt = conn.statement_(c_stmt_rekey_select, "rekey select");
+    sqlite3_stmt* updateStmt = conn.statement_(c_stmt_update_password, "update password");
+    sqlite3_stmt* markStmt = conn.statement_(c_stmt_rekey_mark, "rekey mark");
+    if (!selectStmt || !updateStmt || !markStmt) {
+        return false;
+    }
 
-    // 2) Если новое поле пустое, используем старое
-    std::string finalTitle = newTitle.empty() ? oldTitle : newTitle;
-    std::string finalUrl = newUrl.empty() ? oldUrl : newUrl;
-    std::string finalUsername = newUsername.empty() ? oldUsername : newUsername;
-    std::string finalNotes = newNotes.empty() ? oldNotes : newNotes;
+    std::vector<int> ids;
+    std::vector<std::vector<unsigned char>> blobs;
+    std::vector<std::vector<unsigned char>> reencrypted;
+    ids.reserve(chunkSize);
+    blobs.reserve(chunkSize);
 
-    // 3) Пароль - если пустой, не меняем
-    std::vector<unsigned char> finalEncryptedPass;
-    if (newPassword.empty()) {
-        // Оставляем зашифрованный
-        finalEncryptedPass = oldEncryptedPass;
-    } else {
-        // Перешифровываем
-        std::vector<unsigned char> key = m_encryption.derive_key_(masterPassword);
-        finalEncryptedPass = m_encryption.encrypt_aes_(newPassword, key);
+    while (true) {
+        // Маркер уже зафиксирован с последним пакетом - остановка безопасна
+        if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (!conn.exec_("BEGIN IMMEDIATE;", "rekey transaction")) {
+            return false;
+        }
+
+        // 1) Следующий пакет по курсору
+        ids.clear();
+        blobs.clear();
+        {
+            statement_guard_t guard(selectStmt);
+            sqlite3_bind_int(selectStmt, 1, state.m_lastId);
+            sqlite3_bind_int64(selectStmt, 2, static_cast<sqlite3_int64>(chunkSize));
+            while (step_statement(selectStmt) == SQLITE_ROW) {
+                ids.push_back(sqlite3_column_int(selectStmt, 0));
+                const unsigned char* data = reinterpret_cast<const unsigned char*>(sqlite3_column_blob(selectStmt, 1));
+                blobs.emplace_back(data, data + sqlite3_column_bytes(selectStmt, 1));
+            }
+        }
+        if (ids.empty()) {
+            break; // транзакция остаётся открытой для снятия маркера
+        }
+
+        // 2) Перешифровываем параллельно
+        reencrypted.assign(ids.size(), {});
+        std::atomic<bool> failed(false);
+        m_cryptoPool.parallel_for_(ids.size(), [&](cipher_context_t& ctx, size_t i) {
+            std::string plaintext;
+            if (!m_encryption.decrypt_checked_(ctx, blobs[i].data(), blobs[i].size(), oldKey, plaintext)) {
+                failed = true;
+            } else {
+                reencrypted[i] = m_encryption.encrypt_aes_(ctx, plaintext, newKey);
+            }
+            std::fill(plaintext.begin(), plaintext.end(), '\0');
+        });
+        if (failed) {
+            std::cerr << "Error: could not decrypt entries with the old master password" << std::endl;
+            conn.exec_("ROLLBACK;", "rekey rollback");
+            return false;
+        }
+
+        // 3) Записываем пакет и маркер одной транзакцией
+        bool ok = true;
+        for (size_t i = 0; i < ids.size() && ok; ++i) {
+            statement_guard_t guard(updateStmt);
+            sqlite3_bind_blob(updateStmt, 1, reencrypted[i].data(), (int)reencrypted[i].size(), SQLITE_STATIC);
+            sqlite3_bind_int(updateStmt, 2, ids[i]);
+            ok = (step_statement(updateStmt) == SQLITE_DONE);
+        }
+        if (ok) {
+            statement_guard_t guard(markStmt);
+            sqlite3_bind_int(markStmt, 1, ids.back());
+            ok = (step_statement(markStmt) == SQLITE_DONE);
+        }
+        // Новые параметры KDF ждут в строке pending, пока маркер не снят
+        if (ok && newParams && state.m_processed == 0) {
+            ok = write_kdf_row(conn, c_header_pending, *newParams);
+        }
+        if (!ok || !conn.exec_("COMMIT;", "rekey commit")) {
+            std::cerr << "Error writing re-encrypted entries: " << conn.errmsg_() << std::endl;
+            conn.exec_("ROLLBACK;", "rekey rollback");
+            return false;
+        }
+
+        state.m_processed += ids.size();
+        state.m_lastId = ids.back();
+        if (progress) {
+            progress(state);
+        }
+    }
+
+    // Все записи перешифрованы - снимаем маркер, делаем новые параметры KDF текущими
+    // и записываем контрольное значение нового ключа (в хранилище без заголовка - некуда)
+    bool finished = conn.exec_("DELETE FROM rekey_state;", "rekey finish");
+    if (finished && newParams) {
+        finished = write_kdf_row(conn, c_header_current, *newParams) &&
+                   conn.exec_("DELETE FROM vault_header WHERE id = 2;", "rekey finish");
+    } else if (finished) {
+        finished = conn.exec_("DELETE FROM vault_header WHERE id = 1 AND EXISTS "
+                              "(SELECT 1 FROM vault_header WHERE id = 2);"
+                              "UPDATE vault_header SET id = 1 WHERE id = 2;", "rekey finish");
+    }
+    if (finished) {
+        finished = write_key_check(conn, c_header_current,
+                                   m_encryption.encrypt_aes_(thread_cipher_context(), c_key_check_text, newKey));
+    }
+    if (!finished || !conn.exec_("COMMIT;", "rekey commit")) {
+        conn.exec_("ROLLBACK;", "rekey rollback");
+        return false;
+    }
+    return true;
+}
+
+bool database_t::rollback_rekey_(
+    const session_key_t& oldKey,
+    const session_key_t& newKey,
+    size_t chunkSize,
+    const rekey_callback_t& progress
+) {
+    if (reject_write_("changing the master password")) {
+        return false;
+    }
+    if (chunkSize == 0) {
+        chunkSize = 1;
+    }
+
+    lease_t lease(*this, true);
+    connection_t& conn = lease.conn();
+
+    int lastId = 0;
+    if (!rekey_state_(conn, &lastId)) {
+        return true; // смена не начиналась или уже завершена
+    }
+
+    cache_reset_t cacheReset(m_cache.get());
+    columns_reload_t columnsReload(m_columns ? [&] { reload_columns_(conn); } : std::function<void()>());
+
+    rekey_progress_t state{0, 0, lastId};
+    {
+        sqlite3_stmt* countStmt = conn.statement_(c_stmt_rekey_count_back, "rekey rollback count");
+        if (!countStmt) {
+            return false;
+        }
+        statement_guard_t guard(countStmt);
+        sqlite3_bind_int(countStmt, 1, lastId);
+        if (step_statement(countStmt) == SQLITE_ROW) {
+            state.m_total = static_cast<size_t>(sqlite3_column_int64(countStmt, 0));
+        }
     }
 
-    // 4) Выполним UPDATE
-    const char* updateSql = 
-        "UPDATE passwords SET title = ?, url = ?, username = ?, password = ?, notes = ? WHERE id = ?;";
-    sqlite3_stmt* updateStmt = nullptr;
-    if (sqlite3_prepare_v2(m_db, updateSql, -1, &updateStmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Error preparing update statement: " << sqlite3_errmsg(m_db) << std::endl;
+    sqlite3_stmt* selectStmt = conn.statement_(c_stmt_rekey_select_back, "rekey rollback select");
+    sqlite3_stmt* updateStmt = conn.statement_(c_stmt_update_password, "update password");
+    sqlite3_stmt* markStmt = conn.statement_(c_stmt_rekey_mark, "rekey mark");
+    if (!selectStmt || !updateStmt || !markStmt) {
         return false;
     }
 
-    sqlite3_bind_text(updateStmt, 1, finalTitle.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(updateStmt, 2, finalUrl.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(updateStmt, 3, finalUsername.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_blob(updateStmt, 4, finalEncryptedPass.data(), (int)finalEncryptedPass.size(), SQLITE_STATIC);
-    sqlite3_bind_text(updateStmt, 5, finalNotes.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(updateStmt, 6, id);
+    std::vector<int> ids;
+    std::vector<std::vector<unsigned char>> blobs;
+    std::vector<std::vector<unsigned char>> reencrypted;
+    ids.reserve(chunkSize);
+    blobs.reserve(chunkSize);
+
+    while (true) {
+        if (!conn.exec_("BEGIN IMMEDIATE;", "rekey rollback transaction")) {
+            return false;
+        }
+
+        ids.clear();
+        blobs.clear();
+        if (state.m_lastId > 0) {
+            statement_guard_t guard(selectStmt);
+            sqlite3_bind_int(selectStmt, 1, state.m_lastId);
+            sqlite3_bind_int64(selectStmt, 2, static_cast<sqlite3_int64>(chunkSize));
+            while (step_statement(selectStmt) == SQLITE_ROW) {
+                ids.push_back(sqlite3_column_int(selectStmt, 0));
+                const unsigned char* data = reinterpret_cast<const unsigned char*>(sqlite3_column_blob(selectStmt, 1));
+                blobs.emplace_back(data, data + sqlite3_column_bytes(selectStmt, 1));
+            }
+        }
+        if (ids.empty()) {
+            break; // транзакция остаётся открытой для снятия маркера
+        }
 
-    bool success = (sqlite3_step(updateStmt) == SQLITE_DONE);
-    sqlite3_finalize(updateStmt);
-    return success;
+        // Всё ниже маркера записано смену назад в GCM - newKey проверяется тегом
+        reencrypted.assign(ids.size(), {});
+        std::atomic<bool> failed(false);
+        m_cryptoPool.parallel_for_(ids.size(), [&](cipher_context_t& ctx, size_t i) {
+            std::string plaintext;
+            bool authenticated = false;
+            m_encryption.decrypt_checked_(ctx, blobs[i].data(), blobs[i].size(), newKey, plaintext, &authenticated);
+            if (!authenticated) {
+                failed = true;
+            } else {
+                reencrypted[i] = m_encryption.encrypt_aes_(ctx, plaintext, oldKey);
+            }
+            std::fill(plaintext.begin(), plaintext.end(), '\0');
+        });
+        if (failed) {
+            std::cerr << "Error: could not decrypt entries with the new master password" << std::endl;
+            conn.exec_("ROLLBACK;", "rekey rollback");
+            return false;
+        }
+
+        bool ok = true;
+        for (size_t i = 0; i < ids.size() && ok; ++i) {
+            statement_guard_t guard(updateStmt);
+            sqlite3_bind_blob(updateStmt, 1, reencrypted[i].data(), (int)reencrypted[i].size(), SQLITE_STATIC);
+            sqlite3_bind_int(updateStmt, 2, ids[i]);
+            ok = (step_statement(updateStmt) == SQLITE_DONE);
+        }
+        if (ok) {
+            statement_guard_t guard(markStmt);
+            sqlite3_bind_int(markStmt, 1, ids.back() - 1);
+            ok = (step_statement(markStmt) == SQLITE_DONE);
+        }
+        if (!ok || !conn.exec_("COMMIT;", "rekey commit")) {
+            std::cerr << "Error writing re-encrypted entries: " << conn.errmsg_() << std::endl;
+            conn.exec_("ROLLBACK;", "rekey rollback");
+            return false;
+        }
+
+        state.m_processed += ids.size();
+        state.m_lastId = ids.back() - 1;
+        if (progress) {
+            progress(state);
+        }
+    }
+
+    // Всё снова под oldKey - снимаем маркер, ожидающие параметры KDF не нужны
+    bool finished = conn.exec_("DELETE FROM rekey_state;", "rekey rollback finish") &&
+                    conn.exec_("DELETE FROM vault_header WHERE id = 2;", "rekey rollback finish");
+    if (!finished || !conn.exec_("COMMIT;", "rekey commit")) {
+        conn.exec_("ROLLBACK;", "rekey rollback");
+        return false;
+    }
+    return true;
+}
+
+bool database_t::load_kdf_params_(kdf_params_t& params, bool pending) {
+    if (m_snapshot) {
+        if (pending || !m_snapshot->is_open_()) {
+            return false;
+        }
+        params = m_snapshot->kdf_params_();
+        return true;
+    }
+    lease_t lease(*this, false);
+    return read_kdf_row(lease.conn(), pending ? c_header_pending : c_header_current, params);
+}
+
+bool database_t::store_kdf_params_(const kdf_params_t& params) {
+    if (reject_write_("writing the vault header")) {
+        return false;
+    }
+    lease_t lease(*this, true);
+    return write_kdf_row(lease.conn(), c_header_current, params);
+}
+
+/**
+ * @brief Проверяет ключ контрольным значением текущего заголовка, а без него -
+ *        тегом первого блока GCM с id > afterId (блоки до маркера смены ключа
+ *        зашифрованы уже новым ключом).
+ */
+key_check_t database_t::check_key_(connection_t& conn, const session_key_t& key, int afterId) {
+    std::vector<unsigned char> blob;
+    {
+        sqlite3_stmt* stmt = conn.statement_(c_stmt_key_check_select, "key check");
+        if (!stmt) {
+            return key_check_t::unknown;
+        }
+        statement_guard_t guard(stmt);
+        sqlite3_bind_int(stmt, 1, c_header_current);
+        if (step_statement(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) == SQLITE_BLOB) {
+            const unsigned char* data = reinterpret_cast<const unsigned char*>(sqlite3_column_blob(stmt, 0));
+            blob.assign(data, data + sqlite3_column_bytes(stmt, 0));
+        }
+    }
+    bool fromHeader = !blob.empty();
+    if (!fromHeader) {
+        sqlite3_stmt* stmt = conn.statement_(c_stmt_first_gcm, "first gcm");
+        if (!stmt) {
+            return key_check_t::unknown;
+        }
+        statement_guard_t guard(stmt);
+        sqlite3_bind_int(stmt, 1, afterId);
+        if (step_statement(stmt) != SQLITE_ROW) {
+            return key_check_t::unknown;
+        }
+        const unsigned char* data = reinterpret_cast<const unsigned char*>(sqlite3_column_blob(stmt, 0));
+        blob.assign(data, data + sqlite3_column_bytes(stmt, 0));
+    }
+
+    std::string probe;
+    bool authenticated = false;
+    m_encryption.decrypt_checked_(thread_cipher_context(), blob.data(), blob.size(), key, probe, &authenticated);
+    bool match = authenticated && (!fromHeader || probe == c_key_check_text);
+    std::fill(probe.begin(), probe.end(), '\0');
+    return match ? key_check_t::match : key_check_t::mismatch;
+}
+
+key_check_t database_t::verify_key_(const session_key_t& key) {
+    if (m_snapshot) {
+        return key_check_t::unknown;
+    }
+    lease_t lease(*this, false);
+    int lastId = 0;
+    rekey_state_(lease.conn(), &lastId);
+    return check_key_(lease.conn(), key, lastId);
+}
+
+bool database_t::store_key_check_(const session_key_t& key) {
+    if (reject_write_("writing the key check")) {
+        return false;
+    }
+    lease_t lease(*this, true);
+    connection_t& conn = lease.conn();
+    if (!write_key_check(conn, c_header_current,
+                         m_encryption.encrypt_aes_(thread_cipher_context(), c_key_check_text, key))) {
+        return false;
+    }
+    if (sqlite3_changes(conn.handle_()) != 1) {
+        std::cerr << "Error: the vault has no header to store the key check in" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool database_t::has_entries_() {
+    if (m_snapshot) {
+        return m_snapshot->size_() > 0;
+    }
+    lease_t lease(*this, false);
+    sqlite3_stmt* stmt = lease.conn().statement_(c_stmt_has_entries, "has entries");
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
+    return step_statement(stmt) == SQLITE_ROW;
+}
+
+void database_t::enable_cache_(size_t capacity, std::chrono::milliseconds secretTtl) {
+    if (capacity == 0) {
+        m_cache.reset();
+    } else {
+        m_cache.reset(new entry_cache_t(capacity, secretTtl));
+    }
+}
+
+cache_stats_t database_t::cache_stats_() const {
+    return m_cache ? m_cache->stats_() : cache_stats_t{};
 }
 
 password_entry_t database_t::get_entry_by_id_(int id) {
     password_entry_t entry{};
     entry.m_id = 0; // Укажем 0, пока не найдём
 
-    const char* sql = "SELECT id, title, url, username, password, notes "
-                      "FROM passwords WHERE id = ? LIMIT 1;";
-    sqlite3_stmt* stmt = nullptr;
+    visit_entry_by_id_(id, [&](const password_entry_view_t& view) {
+        view.to_entry_(entry);
+    });
+    return entry;
+}
 
-    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "Error preparing get_entry_by_id statement: "
-                  << sqlite3_errmsg(m_db) << std::endl;
-        return entry;
+bool database_t::visit_entry_by_id_(int id, const entry_visitor_t& visitor) {
+    if (m_snapshot) {
+        return m_snapshot->visit_(id, visitor);
     }
 
+    uint64_t generation = 0;
+    if (m_cache) {
+        password_entry_t cached{};
+        if (m_cache->get_(id, cached)) {
+            visitor(password_entry_view_t::of_(cached));
+            return true;
+        }
+        generation = m_cache->generation_();
+    }
+
+    lease_t lease(*this, false);
+    sqlite3_stmt* stmt = lease.conn().statement_(c_stmt_get_by_id, "get_entry_by_id");
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
+
     sqlite3_bind_int(stmt, 1, id);
 
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        entry.m_id = sqlite3_column_int(stmt, 0);
-        entry.m_title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        entry.m_url = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        entry.m_username = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+    bool found = false;
+    visit_rows_(stmt, true, [&](const password_entry_view_t& view) {
+        found = true;
+        if (m_cache) {
+            password_entry_t entry{};
+            view.to_entry_(entry);
+            m_cache->put_(entry, generation);
+        }
+        visitor(view);
+    });
+    return found;
+}
 
-        const unsigned char* data =
-            reinterpret_cast<const unsigned char*>(sqlite3_column_blob(stmt, 4));
-        int size = sqlite3_column_bytes(stmt, 4);
-        entry.m_encryptedPassword.assign(data, data + size);
+bool database_t::get_entries_by_ids_(const std::vector<int>& ids, std::vector<password_entry_t>& entries) {
+    entries.assign(ids.size(), password_entry_t{});
 
-        entry.m_notes = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    if (m_snapshot) {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            m_snapshot->visit_(ids[i], [&](const password_entry_view_t& view) {
+                view.to_entry_(entries[i]);
+            });
+        }
+        return true;
     }
 
-    sqlite3_finalize(stmt);
-    return entry;
+    uint64_t generation = m_cache ? m_cache->generation_() : 0;
+    id_positions_t pending;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (!m_cache || !m_cache->get_(ids[i], entries[i])) {
+            pending[ids[i]].push_back(i);
+        }
+    }
+    if (pending.empty()) {
+        return true;
+    }
+
+    lease_t lease(*this, false);
+    sqlite3_stmt* stmt = lease.conn().statement_(c_stmt_get_by_ids, "get_entries_by_ids");
+    if (!stmt) {
+        return false;
+    }
+    statement_guard_t guard(stmt);
+
+    std::string idList = json_id_list(pending);
+    sqlite3_bind_text(stmt, 1, idList.c_str(), static_cast<int>(idList.size()), SQLITE_STATIC);
+
+    return visit_rows_(stmt, true, [&](const password_entry_view_t& view) {
+        auto it = pending.find(view.m_id);
+        if (it == pending.end()) {
+            return;
+        }
+        password_entry_t& first = entries[it->second.front()];
+        view.to_entry_(first);
+        for (size_t k = 1; k < it->second.size(); ++k) {
+            entries[it->second[k]] = first;
+        }
+        if (m_cache) {
+            m_cache->put_(first, generation);
+        }
+    });
 }
 
+bool database_t::get_decrypted_passwords_(
+    const std::vector<int>& ids,
+    const session_key_t& key,
+    std::vector<std::string>& passwords
+) {
+    passwords.assign(ids.size(), std::string());
+
+    // Снимок читается прямо из отображения, кеш ему не нужен
+    bool useCache = m_cache && !m_snapshot;
+    uint64_t generation = useCache ? m_cache->generation_() : 0;
+    id_positions_t pending;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (!useCache || !m_cache->get_secret_(ids[i], passwords[i])) {
+            pending[ids[i]].push_back(i);
+        }
+    }
+    if (pending.empty()) {
+        return true;
+    }
+
+    std::vector<ciphertext_ref_t> ciphertexts;
+    std::vector<int> foundIds;
+    std::vector<unsigned char> blobs;
+
+    if (m_snapshot) {
+        for (const auto& item : pending) {
+            m_snapshot->visit_(item.first, [&](const password_entry_view_t& view) {
+                ciphertexts.push_back({view.m_encryptedPassword, view.m_encryptedSize});
+                foundIds.push_back(view.m_id);
+            });
+        }
+    } else {
+        lease_t lease(*this, false);
+        sqlite3_stmt* stmt = lease.conn().statement_(c_stmt_get_passwords, "get_decrypted_passwords");
+        if (!stmt) {
+            return false;
+        }
+        statement_guard_t guard(stmt);
+
+        std::string idList = json_id_list(pending);
+        sqlite3_bind_text(stmt, 1, idList.c_str(), static_cast<int>(idList.size()), SQLITE_STATIC);
+
+        // Блоки SQLite живут до следующего шага - копируем их в общий буфер
+        std::vector<size_t> offsets{0};
+        int rc;
+        while ((rc = step_statement(stmt)) == SQLITE_ROW) {
+            const unsigned char* data = reinterpret_cast<const unsigned char*>(sqlite3_column_blob(stmt, 1));
+            int size = sqlite3_column_bytes(stmt, 1);
+            blobs.insert(blobs.end(), data, data + size);
+            offsets.push_back(blobs.size());
+            foundIds.push_back(sqlite3_column_int(stmt, 0));
+        }
+        if (rc != SQLITE_DONE) {
+            std::cerr << "Error reading passwords: " << sqlite3_errmsg(lease.conn().handle_()) << std::endl;
+            return false;
+        }
+        for (size_t k = 0; k < foundIds.size(); ++k) {
+            ciphertexts.push_back({blobs.data() + offsets[k], offsets[k + 1] - offsets[k]});
+        }
+    }
+
+    // Весь пакет - одним ключом сессии на всех ядрах
+    std::vector<char> succeeded;
+    std::vector<std::string> decrypted = m_cryptoPool.decrypt_batch_(ciphertexts, key, &succeeded);
+    for (size_t k = 0; k < decrypted.size(); ++k) {
+        for (size_t position : pending[foundIds[k]]) {
+            passwords[position] = decrypted[k];
+        }
+        if (useCache && succeeded[k]) {
+            m_cache->put_secret_(foundIds[k], decrypted[k], generation);
+        }
+    }
+    return true;
+}
+
+bool database_t::export_snapshot_(const std::string& path) {
+    if (rekey_in_progress_()) {
+        std::cerr << "Error: finish the interrupted master password change before exporting" << std::endl;
+        return false;
+    }
+
+    kdf_params_t params;
+    if (!load_kdf_params_(params)) {
+        params = kdf_params_t::legacy_();
+    }
+
+    std::vector<password_entry_t> entries;
+    bool ok = for_each_entry_("", [&](const password_entry_view_t& view) {
+        entries.emplace_back();
+        view.to_entry_(entries.back());
+    });
+    return ok && snapshot_t::write_(path, entries, params);
+}
+
+bool database_t::load_column_store_() {
+    std::unique_ptr<column_store_t> columns(new column_store_t());
+    bool ok = for_each_entry_("", [&](const password_entry_view_t& view) {
+        columns->append_(view);
+    });
+    if (!ok) {
+        return false;
+    }
+    m_columns = std::move(columns);
+    return true;
+}
+
+void database_t::reload_columns_(connection_t& conn) {
+    sqlite3_stmt* stmt = conn.statement_(c_stmt_list_all, "list");
+    if (!stmt) {
+        return;
+    }
+    statement_guard_t guard(stmt);
+
+    column_store_t fresh;
+    if (visit_rows_(stmt, true, [&](const password_entry_view_t& view) { fresh.append_(view); })) {
+        m_columns->swap_(fresh);
+    }
+}
+
+bool database_t::search_ranked_(const std::string& query, size_t limit, entry_result_set_t& results,
+                                const std::atomic<bool>* cancelled) {
+    results.clear_();
+
+    std::shared_ptr<const fuzzy_index_t> index;
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_fuzzyMutex);
+        index = m_fuzzy;
+        generation = m_fuzzyGeneration;
+    }
+    if (!index) {
+        // Индекс строится без m_fuzzyMutex: for_each_entry_ берёт аренду, а
+        // писатели под арендой вызывают invalidate_fuzzy_. Если за время
+        // построения индекс сбросили, он уже устарел - результат годится для
+        // этого запроса, но не сохраняется.
+        std::shared_ptr<fuzzy_index_t> fresh(new fuzzy_index_t());
+        bool ok = for_each_entry_("", [&](const password_entry_view_t& view) {
+            fresh->append_(view);
+        }, cancelled);
+        if (!ok) {
+            return false;
+        }
+        index = fresh;
+
+        std::lock_guard<std::mutex> lock(m_fuzzyMutex);
+        if (m_fuzzyGeneration == generation && !m_fuzzy) {
+            m_fuzzy = index;
+        }
+    }
+
+    std::vector<fuzzy_hit_t> hits;
+    if (!index->search_(query, limit, hits, cancelled)) {
+        return false;
+    }
+    for (const fuzzy_hit_t& hit : hits) {
+        password_entry_view_t view = index->view_(hit.m_row);
+        pmr_password_entry_t& entry = results.append_();
+        entry.m_id = view.m_id;
+        entry.m_title.assign(view.m_title.data(), view.m_title.size());
+        entry.m_url.assign(view.m_url.data(), view.m_url.size());
+        entry.m_username.assign(view.m_username.data(), view.m_username.size());
+        entry.m_notes.assign(view.m_notes.data(), view.m_notes.size());
+    }
+    return true;
+}
+
+void database_t::invalidate_fuzzy_() {
+    std::lock_guard<std::mutex> lock(m_fuzzyMutex);
+    m_fuzzy.reset();
+    ++m_fuzzyGeneration;
+}
+
+bool database_t::reject_write_(const char* what) const {
+    if (!m_snapshot) {
+        return false;
+    }
+    std::cerr << "Error: " << what << " is not possible, the vault snapshot is read-only" << std::endl;
+    return true;
+}
@@ -0,0 +1,140 @@
+#include "database/entry_cache.h"
+#include <openssl/crypto.h>
+#include <algorithm>
+
+entry_cache_t::entry_cache_t(size_t capacity, std::chrono::milliseconds secretTtl)
+    : m_capacity(std::max<size_t>(capacity, 1)), m_secretTtl(secretTtl), m_generation(0), m_stats{} {
+    m_index.reserve(m_capacity);
+}
+
+entry_cache_t::~entry_cache_t() {
+    clear_();
+}
+
+uint64_t entry_cache_t::generation_() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_generation;
+}
+
+bool entry_cache_t::get_(int id, password_entry_t& entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(id);
+    if (it == m_index.end() || !it->second->m_hasEntry) {
+        ++m_stats.m_misses;
+        return false;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    entry = it->second->m_entry;
+    ++m_stats.m_hits;
+    return true;
+}
+
+void entry_cache_t::put_(const password_entry_t& entry, uint64_t generation) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (generation != m_generation) {
+        return;
+    }
+    node_t& node = touch_(entry.m_id);
+    node.m_entry = entry;
+    node.m_hasEntry = true;
+}
+
+bool entry_cache_t::get_secret_(int id, std::string& secret) {
+    if (m_secretTtl.count() <= 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_index.find(id);
+    if (it == m_index.end() || !it->second->m_hasSecret) {
+        ++m_stats.m_secretMisses;
+        return false;
+    }
+
+    node_t& node = *it->second;
+    if (clock_t::now() >= node.m_secretExpires) {
+        drop_secret_(node);
+        if (!node.m_hasEntry) {
+            erase_(it->second);
+        }
+        ++m_stats.m_secretMisses;
+        return false;
+    }
+
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    secret = node.m_secret;
+    ++m_stats.m_secretHits;
+    return true;
+}
+
+void entry_cache_t::put_secret_(int id, const std::string& secret, uint64_t generation) {
+    if (m_secretTtl.count() <= 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (generation != m_generation) {
+        return;
+    }
+    node_t& node = touch_(id);
+    drop_secret_(node);
+    node.m_secret = secret;
+    node.m_hasSecret = true;
+    node.m_secretExpires = clock_t::now() + m_secretTtl;
+}
+
+void entry_cache_t::invalidate_(int id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+    auto it = m_index.find(id);
+    if (it != m_index.end()) {
+        erase_(it->second);
+    }
+}
+
+void entry_cache_t::clear_() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+    while (!m_lru.empty()) {
+        erase_(m_lru.begin());
+    }
+}
+
+cache_stats_t entry_cache_t::stats_() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    cache_stats_t stats = m_stats;
+    stats.m_size = m_lru.size();
+    return stats;
+}
+
+entry_cache_t::node_t& entry_cache_t::touch_(int id) {
+    auto it = m_index.find(id);
+    if (it != m_index.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return *it->second;
+    }
+
+    if (m_lru.size() >= m_capacity) {
+        erase_(std::prev(m_lru.end()));
+        ++m_stats.m_evictions;
+    }
+
+    m_lru.push_front(node_t{id, false, password_entry_t{}, false, std::string(), clock_t::time_point()});
+    m_index[id] = m_lru.begin();
+    return m_lru.front();
+}
+
+void entry_cache_t::drop_secret_(node_t& node) {
+    if (!node.m_secret.empty()) {
+        OPENSSL_cleanse(&node.m_secret[0], node.m_secret.size());
+    }
+    node.m_secret.clear();
+    node.m_hasSecret = false;
+}
+
+void entry_cache_t::erase_(lru_t::iterator it) {
+    drop_secret_(*it);
+    m_index.erase(it->m_id);
+    m_lru.erase(it);
+}
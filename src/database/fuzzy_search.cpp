@@ -0,0 +1,431 @@
+#include "database/fuzzy_search.h"
+#include "database/text_search.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+// Как часто (в записях) проверяется флаг отмены
+const size_t c_cancel_check_rows = 4096;
+
+// Опечатки ищутся в словах из c_min_typo_token..c_max_typo_token символов
+// (в коротких одна правка превращает почти любое поле в совпадение; длинные
+// не помещаются в 64-битный столбец typo_distance)
+const size_t c_min_typo_token = 5;
+const size_t c_max_typo_token = 64;
+
+// Надбавка за поле, в котором нашлось слово: title, url, username, notes
+const int c_field_bonus[4] = {30, 25, 15, 0};
+
+// Оценки подпоследовательности: за символ, за начало слова, за символ
+// сразу после предыдущего совпавшего, штраф за начало и продолжение пропуска
+const int c_sub_match = 16;
+const int c_sub_boundary = 8;
+const int c_sub_consecutive = 8;
+const int c_sub_gap_start = 3;
+const int c_sub_gap_extend = 1;
+
+inline unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+inline bool is_word_char(unsigned char c) {
+    return std::isalnum(c) || c >= 0x80;
+}
+
+/**
+ * @brief Начинается ли в позиции pos слово: после разделителя или
+ *        переход строчная -> заглавная (camelCase).
+ */
+inline bool is_boundary(std::string_view text, size_t pos) {
+    if (pos == 0) {
+        return true;
+    }
+    unsigned char prev = static_cast<unsigned char>(text[pos - 1]);
+    unsigned char cur = static_cast<unsigned char>(text[pos]);
+    return !is_word_char(prev) || (std::islower(prev) && std::isupper(cur));
+}
+
+/**
+ * @brief Поле записи: исходный текст (для границ слов с учётом регистра)
+ *        и он же с A-Z, приведёнными к a-z (для сравнения).
+ */
+struct field_ref_t {
+    std::string_view m_raw;
+    std::string_view m_folded;
+};
+
+int substring_score(const field_ref_t& field, const std::string& token) {
+    size_t pos = field.m_folded.find(token);
+    if (pos == std::string_view::npos) {
+        return 0;
+    }
+    int score = 100;
+    if (pos == 0) {
+        score += 40;
+    } else if (is_boundary(field.m_raw, pos)) {
+        score += 20;
+    }
+    if (token.size() == field.m_folded.size()) {
+        score += 40;
+    }
+    return score;
+}
+
+/**
+ * @brief Оценка подпоследовательности (40..90) или 0. Как в fzf: сначала
+ *        самый левый конец совпадения, затем самое короткое окно, которое в нём
+ *        заканчивается, и оценка символов этого окна.
+ */
+int subsequence_score(const field_ref_t& field, const std::string& token) {
+    const std::string_view text = field.m_folded;
+    const size_t m = token.size();
+
+    // Самый левый конец: следующий символ слова ищется memchr
+    size_t end = 0;
+    for (size_t j = 0, from = 0; j < m; ++j) {
+        const void* found = from < text.size() ? std::memchr(text.data() + from, token[j], text.size() - from)
+                                               : nullptr;
+        if (!found) {
+            return 0;
+        }
+        end = static_cast<size_t>(static_cast<const char*>(found) - text.data());
+        from = end + 1;
+    }
+
+    size_t start = end;
+    for (size_t k = m, i = end + 1; k > 0 && i > 0; --i) {
+        if (text[i - 1] == token[k - 1]) {
+            start = i - 1;
+            --k;
+        }
+    }
+
+    int raw = 0;
+    bool inGap = false;
+    bool prevMatched = false;
+    for (size_t i = start, j = 0; i <= end && j < m; ++i) {
+        if (text[i] == token[j]) {
+            raw += c_sub_match;
+            if (is_boundary(field.m_raw, i)) {
+                raw += c_sub_boundary;
+            }
+            if (prevMatched) {
+                raw += c_sub_consecutive;
+            }
+            prevMatched = true;
+            inGap = false;
+            ++j;
+        } else {
+            raw -= inGap ? c_sub_gap_extend : c_sub_gap_start;
+            prevMatched = false;
+            inGap = true;
+        }
+    }
+    if (raw <= 0) {
+        return 0; // символы слишком разбросаны
+    }
+    const int best = static_cast<int>(m) * (c_sub_match + c_sub_boundary + c_sub_consecutive);
+    return 40 + std::min(50, 50 * raw / best);
+}
+
+/**
+ * @brief Наименьшее расстояние Дамерау-Левенштейна (ограниченное: без
+ *        повторных правок переставленной пары) от слова до подстроки text.
+ *
+ * Битово-параллельный алгоритм Хюрё (Myers + перестановки): столбец матрицы
+ * расстояний хранится как разности соседних клеток в двух словах по 64 бита,
+ * так что на символ текста - десяток операций. Нулевая строка матрицы нулевая
+ * (совпадение может начаться где угодно), ответ - минимум по последней строке.
+ */
+int typo_distance(std::string_view text, const fuzzy_query_t::token_t& token) {
+    const uint64_t last = uint64_t(1) << (token.m_text.size() - 1);
+    uint64_t vp = ~uint64_t(0);
+    uint64_t vn = 0;
+    uint64_t d0 = 0;
+    uint64_t prevEq = 0;
+    int distance = static_cast<int>(token.m_text.size());
+    int best = distance;
+
+    for (unsigned char c : text) {
+        const uint64_t eq = token.m_peq[c];
+        const uint64_t transposed = ((~d0 & eq) << 1) & prevEq;
+        d0 = (((eq & vp) + vp) ^ vp) | eq | vn | transposed;
+        uint64_t hp = vn | ~(d0 | vp);
+        uint64_t hn = d0 & vp;
+        distance += static_cast<int>((hp & last) != 0) - static_cast<int>((hn & last) != 0);
+        best = std::min(best, distance);
+        hp <<= 1;
+        hn <<= 1;
+        vp = hn | ~(d0 | hp);
+        vn = hp & d0;
+        prevEq = eq;
+    }
+    return best;
+}
+
+/**
+ * @brief Оценка записи по разобранному запросу; 0 - не подходит.
+ *
+ * Для каждого слова берётся лучшее поле (с надбавкой за поле): сначала
+ * подстроки и подпоследовательности, и только если их нет ни в одном
+ * поле - опечатки. Поле пропускается без чтения, если в нём нет символов
+ * слова (для опечаток - больше, чем допустимо правок).
+ * @param masks Маски символов полей
+ * @param typoTokens Бит i - искать ли опечатки для слова i (у индекса - только
+ *        если запись прошла отбор по биграммам)
+ */
+int score_fields(const std::vector<fuzzy_query_t::token_t>& tokens,
+                 const field_ref_t (&fields)[4],
+                 const uint64_t (&masks)[4],
+                 uint32_t typoTokens) {
+    int total = 0;
+    for (size_t t = 0; t < tokens.size(); ++t) {
+        const fuzzy_query_t::token_t& token = tokens[t];
+        int best = 0;
+        for (int f = 0; f < 4; ++f) {
+            if ((token.m_mask & ~masks[f]) != 0) {
+                continue;
+            }
+            int score = substring_score(fields[f], token.m_text);
+            if (score == 0 && token.m_text.size() > 1) {
+                score = subsequence_score(fields[f], token.m_text);
+            }
+            if (score > 0) {
+                best = std::max(best, score + c_field_bonus[f]);
+            }
+        }
+        if (best == 0 && token.m_typos > 0 && t < 32 && (typoTokens >> t & 1)) {
+            for (int f = 0; f < 4; ++f) {
+                const std::string_view text = fields[f].m_folded;
+                if (text.size() + token.m_typos < token.m_text.size() ||
+                    __builtin_popcountll(token.m_mask & ~masks[f]) > token.m_typos) {
+                    continue;
+                }
+                int distance = typo_distance(text, token);
+                if (distance <= token.m_typos) {
+                    best = std::max(best, 25 - (distance - 1) * 12 + c_field_bonus[f]);
+                }
+            }
+        }
+        if (best == 0) {
+            return 0; // каждое слово должно найтись
+        }
+        total += best;
+    }
+    return total;
+}
+
+/**
+ * @brief Порядок выдачи: выше оценка, при равенстве - меньше ID.
+ */
+inline bool better_hit(const fuzzy_hit_t& a, const fuzzy_hit_t& b) {
+    return a.m_score != b.m_score ? a.m_score > b.m_score : a.m_id < b.m_id;
+}
+
+inline bool is_cancelled(const std::atomic<bool>* cancelled) {
+    return cancelled && cancelled->load(std::memory_order_relaxed);
+}
+
+} // namespace
+
+fuzzy_query_t::fuzzy_query_t(const std::string& query) {
+    size_t pos = 0;
+    while (pos < query.size()) {
+        while (pos < query.size() && std::isspace(static_cast<unsigned char>(query[pos]))) {
+            ++pos;
+        }
+        size_t end = pos;
+        while (end < query.size() && !std::isspace(static_cast<unsigned char>(query[end]))) {
+            ++end;
+        }
+        if (end == pos) {
+            break;
+        }
+
+        token_t token;
+        token.m_text = fold_ascii(std::string_view(query).substr(pos, end - pos));
+        token.m_mask = char_mask(token.m_text);
+        for (size_t i = 0; i + 1 < token.m_text.size(); ++i) {
+            token.m_bigrams.push_back(bigram(token.m_text[i], token.m_text[i + 1]));
+        }
+        token.m_peq.fill(0);
+        for (size_t i = 0; i < token.m_text.size() && i < c_max_typo_token; ++i) {
+            token.m_peq[static_cast<unsigned char>(token.m_text[i])] |= uint64_t(1) << i;
+        }
+        std::sort(token.m_bigrams.begin(), token.m_bigrams.end());
+        token.m_bigrams.erase(std::unique(token.m_bigrams.begin(), token.m_bigrams.end()), token.m_bigrams.end());
+
+        const size_t length = token.m_text.size();
+        if (length < c_min_typo_token || length > c_max_typo_token) {
+            token.m_typos = 0;
+        } else {
+            token.m_typos = length <= 8 ? 1 : 2;
+        }
+        m_tokens.push_back(std::move(token));
+        pos = end;
+    }
+}
+
+int fuzzy_query_t::score_(std::string_view title, std::string_view url,
+                          std::string_view username, std::string_view notes) const {
+    const std::string_view raw[4] = {title, url, username, notes};
+    std::string folded[4];
+    field_ref_t fields[4];
+    uint64_t masks[4];
+    for (int f = 0; f < 4; ++f) {
+        folded[f] = fold_ascii(raw[f]);
+        fields[f] = field_ref_t{raw[f], folded[f]};
+        masks[f] = char_mask(folded[f]);
+    }
+    return score_fields(m_tokens, fields, masks, ~uint32_t(0));
+}
+
+uint64_t fuzzy_query_t::char_mask(std::string_view text) {
+    uint64_t mask = 0;
+    for (unsigned char c : text) {
+        c = fold(c);
+        unsigned bit;
+        if (c >= 'a' && c <= 'z') {
+            bit = c - 'a';
+        } else if (c >= '0' && c <= '9') {
+            bit = 26 + (c - '0');
+        } else {
+            bit = 36 + c % 28;
+        }
+        mask |= uint64_t(1) << bit;
+    }
+    return mask;
+}
+
+uint16_t fuzzy_query_t::bigram(char first, char second) {
+    return static_cast<uint16_t>(fold(static_cast<unsigned char>(first)) << 8 |
+                                 fold(static_cast<unsigned char>(second)));
+}
+
+fuzzy_index_t::fuzzy_index_t() : m_postings(65536) {}
+
+void fuzzy_index_t::append_(const password_entry_view_t& view) {
+    const uint32_t row = static_cast<uint32_t>(m_ids.size());
+    const std::string_view fields[c_fields] = {view.m_title, view.m_url, view.m_username, view.m_notes};
+
+    uint64_t mask = 0;
+    for (std::string_view field : fields) {
+        m_fieldMasks.push_back(fuzzy_query_t::char_mask(field));
+        mask |= m_fieldMasks.back();
+        m_text.insert(m_text.end(), field.begin(), field.end());
+        for (char c : field) {
+            m_folded.push_back(static_cast<char>(fold(static_cast<unsigned char>(c))));
+        }
+        m_offsets.push_back(m_text.size());
+        for (size_t i = 0; i + 1 < field.size(); ++i) {
+            std::vector<uint32_t>& rows = m_postings[fuzzy_query_t::bigram(field[i], field[i + 1])];
+            if (rows.empty() || rows.back() != row) {
+                rows.push_back(row);
+            }
+        }
+    }
+    m_ids.push_back(view.m_id);
+    m_masks.push_back(mask);
+}
+
+password_entry_view_t fuzzy_index_t::view_(size_t row) const {
+    auto text = [&](int field) {
+        size_t begin = m_offsets[row * c_fields + field];
+        return std::string_view(m_text.data() + begin, m_offsets[row * c_fields + field + 1] - begin);
+    };
+
+    password_entry_view_t view{};
+    view.m_id = m_ids[row];
+    view.m_title = text(0);
+    view.m_url = text(1);
+    view.m_username = text(2);
+    view.m_notes = text(3);
+    view.m_encryptedPassword = nullptr;
+    view.m_encryptedSize = 0;
+    return view;
+}
+
+bool fuzzy_index_t::search_(const std::string& query, size_t limit, std::vector<fuzzy_hit_t>& hits,
+                            const std::atomic<bool>* cancelled) const {
+    hits.clear();
+    fuzzy_query_t parsed(query);
+    const size_t n = m_ids.size();
+    if (parsed.empty_() || limit == 0 || n == 0) {
+        return true;
+    }
+
+    // Отбор кандидатов: для каждого слова - по маске символов или по общим
+    // биграммам; во втором случае в typoTokens отмечается, что для слова
+    // стоит искать опечатки
+    const std::vector<fuzzy_query_t::token_t>& tokens = parsed.tokens_();
+    std::vector<uint8_t> candidate(n, 1);
+    std::vector<uint32_t> typoTokens(n, 0);
+    std::vector<uint16_t> shared;
+    for (size_t t = 0; t < tokens.size(); ++t) {
+        const fuzzy_query_t::token_t& token = tokens[t];
+        size_t threshold = 0;
+        if (token.m_typos > 0 && t < 32) {
+            shared.assign(n, 0);
+            for (uint16_t gram : token.m_bigrams) {
+                for (uint32_t row : m_postings[gram]) {
+                    ++shared[row]; // не больше 64 различных биграмм в слове
+                }
+            }
+            // Каждая правка портит не больше трёх биграмм, но хотя бы две должны совпасть
+            size_t lost = 3 * static_cast<size_t>(token.m_typos);
+            threshold = token.m_bigrams.size() > lost + 2 ? token.m_bigrams.size() - lost : 2;
+        }
+        for (size_t row = 0; row < n; ++row) {
+            if (!candidate[row]) {
+                continue;
+            }
+            bool typoCandidate = threshold > 0 && shared[row] >= threshold &&
+                                 __builtin_popcountll(token.m_mask & ~m_masks[row]) <= token.m_typos;
+            if (typoCandidate) {
+                typoTokens[row] |= uint32_t(1) << t;
+            }
+            candidate[row] = (token.m_mask & ~m_masks[row]) == 0 || typoCandidate;
+        }
+        if (is_cancelled(cancelled)) {
+            return false;
+        }
+    }
+
+    // Лучшие limit записей: в вершине кучи - худшая из них
+    for (size_t row = 0; row < n; ++row) {
+        if (row % c_cancel_check_rows == 0 && is_cancelled(cancelled)) {
+            hits.clear();
+            return false;
+        }
+        if (!candidate[row]) {
+            continue;
+        }
+        field_ref_t fields[c_fields];
+        uint64_t masks[c_fields];
+        for (int f = 0; f < c_fields; ++f) {
+            masks[f] = m_fieldMasks[row * c_fields + f];
+            size_t begin = m_offsets[row * c_fields + f];
+            size_t size = m_offsets[row * c_fields + f + 1] - begin;
+            fields[f] = field_ref_t{std::string_view(m_text.data() + begin, size),
+                                    std::string_view(m_folded.data() + begin, size)};
+        }
+        int score = score_fields(tokens, fields, masks, typoTokens[row]);
+        if (score == 0) {
+            continue;
+        }
+
+        fuzzy_hit_t hit{row, m_ids[row], score};
+        if (hits.size() < limit) {
+            hits.push_back(hit);
+            std::push_heap(hits.begin(), hits.end(), better_hit);
+        } else if (better_hit(hit, hits.front())) {
+            std::pop_heap(hits.begin(), hits.end(), better_hit);
+            hits.back() = hit;
+            std::push_heap(hits.begin(), hits.end(), better_hit);
+        }
+    }
+    std::sort_heap(hits.begin(), hits.end(), better_hit);
+    return true;
+}
@@ -0,0 +1,365 @@
+#include "database/import.h"
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Записывает значение в поле записи по имени колонки/ключа.
+ * @return false, если имя не относится к записи (такие поля игнорируются)
+ */
+bool assign_field(import_row_t& row, std::string name, std::string value) {
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (name == "title" || name == "name") {
+        row.m_title = std::move(value);
+    } else if (name == "url") {
+        row.m_url = std::move(value);
+    } else if (name == "username" || name == "login") {
+        row.m_username = std::move(value);
+    } else if (name == "password") {
+        row.m_password = std::move(value);
+    } else if (name == "notes") {
+        row.m_notes = std::move(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Читатель CSV (RFC 4180): поля в кавычках, "" внутри кавычек, CRLF/LF.
+ */
+class csv_reader_t : public entry_reader_t {
+private:
+    std::streambuf* m_buf;
+    std::string m_error;
+    std::vector<std::string> m_columns; // имена колонок из заголовка
+    std::vector<std::string> m_fields;  // переиспользуется между записями
+    size_t m_line;
+    bool m_headerRead;
+
+    /**
+     * @brief Читает одну запись CSV в m_fields.
+     * @return false в конце ввода или при ошибке
+     */
+    bool read_record_() {
+        m_fields.clear();
+
+        int c = m_buf->sbumpc();
+        if (c == std::char_traits<char>::eof()) {
+            return false;
+        }
+
+        std::string field;
+        bool quoted = false;
+        ++m_line;
+
+        while (true) {
+            if (quoted) {
+                if (c == std::char_traits<char>::eof()) {
+                    m_error = "unterminated quoted field at line " + std::to_string(m_line);
+                    return false;
+                }
+                if (c == '"') {
+                    if (m_buf->sgetc() == '"') {
+                        field += '"';
+                        m_buf->sbumpc();
+                    } else {
+                        quoted = false;
+                    }
+                } else {
+                    if (c == '\n') {
+                        ++m_line;
+                    }
+                    field += static_cast<char>(c);
+                }
+            } else if (c == '"' && field.empty()) {
+                quoted = true;
+            } else if (c == ',') {
+                m_fields.push_back(std::move(field));
+                field.clear();
+            } else if (c == '\n' || c == std::char_traits<char>::eof()) {
+                if (!field.empty() && field.back() == '\r') {
+                    field.pop_back();
+                }
+                m_fields.push_back(std::move(field));
+                return true;
+            } else {
+                field += static_cast<char>(c);
+            }
+            c = m_buf->sbumpc();
+        }
+    }
+
+public:
+    explicit csv_reader_t(std::istream& input)
+        : m_buf(input.rdbuf()), m_line(0), m_headerRead(false) {}
+
+    bool next_(import_row_t& row) override {
+        if (!m_headerRead) {
+            m_headerRead = true;
+            if (!read_record_()) {
+                return false;
+            }
+            m_columns = m_fields;
+
+            import_row_t probe;
+            bool known = false;
+            for (const std::string& column : m_columns) {
+                known = assign_field(probe, column, "") || known;
+            }
+            if (!known) {
+                m_error = "CSV header must name the columns (title,url,username,password,notes)";
+                return false;
+            }
+        }
+
+        while (read_record_()) {
+            // Пустые строки пропускаем
+            if (m_fields.size() == 1 && m_fields[0].empty()) {
+                continue;
+            }
+
+            row = import_row_t{};
+            size_t count = std::min(m_fields.size(), m_columns.size());
+            for (size_t i = 0; i < count; ++i) {
+                assign_field(row, m_columns[i], std::move(m_fields[i]));
+            }
+            return true;
+        }
+        return false;
+    }
+
+    const std::string& error_() const override {
+        return m_error;
+    }
+};
+
+/**
+ * @brief Потоковый читатель JSON-массива плоских объектов.
+ *        Значения-строки берутся как есть, числа и true/false - текстом, null - пустая строка.
+ */
+class json_reader_t : public entry_reader_t {
+private:
+    std::streambuf* m_buf;
+    std::string m_error;
+    bool m_started;
+    bool m_finished;
+
+    int peek_non_space_() {
+        int c = m_buf->sgetc();
+        while (c != std::char_traits<char>::eof() && std::isspace(c)) {
+            m_buf->sbumpc();
+            c = m_buf->sgetc();
+        }
+        return c;
+    }
+
+    bool expect_(char expected) {
+        if (peek_non_space_() != expected) {
+            m_error = std::string("expected '") + expected + "' in JSON input";
+            return false;
+        }
+        m_buf->sbumpc();
+        return true;
+    }
+
+    static void append_utf8(std::string& out, unsigned long cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool read_hex4_(unsigned long& value) {
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            int c = m_buf->sbumpc();
+            if (!std::isxdigit(c)) {
+                m_error = "invalid \\u escape in JSON string";
+                return false;
+            }
+            value = value * 16 + (std::isdigit(c) ? c - '0' : std::tolower(c) - 'a' + 10);
+        }
+        return true;
+    }
+
+    bool read_string_(std::string& out) {
+        out.clear();
+        if (!expect_('"')) {
+            return false;
+        }
+        while (true) {
+            int c = m_buf->sbumpc();
+            if (c == std::char_traits<char>::eof()) {
+                m_error = "unterminated JSON string";
+                return false;
+            }
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out += static_cast<char>(c);
+                continue;
+            }
+
+            c = m_buf->sbumpc();
+            switch (c) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned long cp;
+                if (!read_hex4_(cp)) {
+                    return false;
+                }
+                // Суррогатная пара UTF-16: за старшим обязан идти младший (DC00-DFFF),
+                // одиночный суррогат не кодируется в UTF-8
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    unsigned long low = 0;
+                    if (m_buf->sbumpc() != '\\' || m_buf->sbumpc() != 'u' || !read_hex4_(low) ||
+                        low < 0xDC00 || low > 0xDFFF) {
+                        m_error = "invalid surrogate pair in JSON string";
+                        return false;
+                    }
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    m_error = "invalid surrogate pair in JSON string";
+                    return false;
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                m_error = "invalid escape in JSON string";
+                return false;
+            }
+        }
+    }
+
+    /**
+     * @brief Читает значение поля: строку или скаляр (число, true, false, null).
+     */
+    bool read_value_(std::string& out) {
+        int c = peek_non_space_();
+        if (c == '"') {
+            return read_string_(out);
+        }
+        if (c == '{' || c == '[') {
+            m_error = "nested JSON values are not supported";
+            return false;
+        }
+
+        out.clear();
+        while (c != std::char_traits<char>::eof() && c != ',' && c != '}' && !std::isspace(c)) {
+            out += static_cast<char>(c);
+            m_buf->sbumpc();
+            c = m_buf->sgetc();
+        }
+        if (out.empty()) {
+            m_error = "missing JSON value";
+            return false;
+        }
+        if (out == "null") {
+            out.clear();
+        }
+        return true;
+    }
+
+public:
+    explicit json_reader_t(std::istream& input)
+        : m_buf(input.rdbuf()), m_started(false), m_finished(false) {}
+
+    bool next_(import_row_t& row) override {
+        if (m_finished) {
+            return false;
+        }
+
+        if (!m_started) {
+            m_started = true;
+            if (!expect_('[')) {
+                m_finished = true;
+                return false;
+            }
+            if (peek_non_space_() == ']') {
+                m_buf->sbumpc();
+                m_finished = true;
+                return false;
+            }
+        } else {
+            int c = peek_non_space_();
+            m_buf->sbumpc();
+            if (c == ']') {
+                m_finished = true;
+                return false;
+            }
+            if (c != ',') {
+                m_error = "expected ',' or ']' between JSON objects";
+                m_finished = true;
+                return false;
+            }
+        }
+
+        row = import_row_t{};
+        if (!expect_('{')) {
+            m_finished = true;
+            return false;
+        }
+
+        std::string key, value;
+        if (peek_non_space_() == '}') {
+            m_buf->sbumpc();
+            return true;
+        }
+        while (true) {
+            if (!read_string_(key) || !expect_(':') || !read_value_(value)) {
+                m_finished = true;
+                return false;
+            }
+            assign_field(row, key, std::move(value));
+
+            int c = peek_non_space_();
+            m_buf->sbumpc();
+            if (c == '}') {
+                return true;
+            }
+            if (c != ',') {
+                m_error = "expected ',' or '}' in JSON object";
+                m_finished = true;
+                return false;
+            }
+        }
+    }
+
+    const std::string& error_() const override {
+        return m_error;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<entry_reader_t> make_entry_reader(std::istream& input, import_format_t format) {
+    if (format == import_format_t::json) {
+        return std::unique_ptr<entry_reader_t>(new json_reader_t(input));
+    }
+    return std::unique_ptr<entry_reader_t>(new csv_reader_t(input));
+}
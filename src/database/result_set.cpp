@@ -0,0 +1,39 @@
+#include "database/result_set.h"
+
+pmr_password_entry_t::pmr_password_entry_t(const allocator_type& alloc)
+    : m_id(0),
+      m_title(alloc),
+      m_url(alloc),
+      m_username(alloc),
+      m_encryptedPassword(alloc),
+      m_notes(alloc) {}
+
+pmr_password_entry_t::pmr_password_entry_t(const pmr_password_entry_t& other, const allocator_type& alloc)
+    : m_id(other.m_id),
+      m_title(other.m_title, alloc),
+      m_url(other.m_url, alloc),
+      m_username(other.m_username, alloc),
+      m_encryptedPassword(other.m_encryptedPassword, alloc),
+      m_notes(other.m_notes, alloc) {}
+
+pmr_password_entry_t::pmr_password_entry_t(pmr_password_entry_t&& other, const allocator_type& alloc)
+    : m_id(other.m_id),
+      m_title(std::move(other.m_title), alloc),
+      m_url(std::move(other.m_url), alloc),
+      m_username(std::move(other.m_username), alloc),
+      m_encryptedPassword(std::move(other.m_encryptedPassword), alloc),
+      m_notes(std::move(other.m_notes), alloc) {}
+
+entry_result_set_t::entry_result_set_t(size_t initialBytes)
+    : m_arena(initialBytes), m_entries(&m_arena) {}
+
+pmr_password_entry_t& entry_result_set_t::append_() {
+    m_entries.emplace_back();
+    return m_entries.back();
+}
+
+void entry_result_set_t::clear_() {
+    // Сначала вектор должен забыть о своём буфере, иначе release() оставит его висящим
+    std::pmr::vector<pmr_password_entry_t>(&m_arena).swap(m_entries);
+    m_arena.release();
+}
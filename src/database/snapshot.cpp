@@ -0,0 +1,307 @@
+#include "database/snapshot.h"
+#include "database/text_search.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char c_magic[8] = {'P', 'M', 'S', 'N', 'A', 'P', 0, 0};
+const uint32_t c_version = 1;
+const uint32_t c_byte_order = 0x01020304;
+
+bool is_blank(const std::string& query) {
+    return std::all_of(query.begin(), query.end(), [](unsigned char c) { return std::isspace(c); });
+}
+
+/**
+ * @brief Пишет буфер целиком (write может записать часть).
+ */
+bool write_all(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+snapshot_t::snapshot_t() : m_base(nullptr), m_size(0), m_header(nullptr), m_index(nullptr) {}
+
+snapshot_t::~snapshot_t() {
+    close_();
+}
+
+bool snapshot_t::open_(const std::string& path) {
+    close_();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Error opening snapshot " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(snapshot_header_t)) {
+        std::cerr << "Error: " << path << " is not a vault snapshot" << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* base = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "Error mapping snapshot " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    // Проверяется только заголовок: секции должны лежать внутри файла и не пересекаться
+    const snapshot_header_t* header = static_cast<const snapshot_header_t*>(base);
+    uint64_t indexEnd = header->m_indexOffset + uint64_t(header->m_entryCount) * sizeof(snapshot_record_t);
+    bool valid = std::memcmp(header->m_magic, c_magic, sizeof(c_magic)) == 0 &&
+                 header->m_version == c_version &&
+                 header->m_byteOrder == c_byte_order &&
+                 header->m_headerSize == sizeof(snapshot_header_t) &&
+                 header->m_fileSize == size &&
+                 header->m_indexOffset == sizeof(snapshot_header_t) &&
+                 header->m_stringsOffset == indexEnd &&
+                 header->m_stringsOffset <= size &&
+                 header->m_stringsSize <= size - header->m_stringsOffset &&
+                 header->m_blobsOffset == header->m_stringsOffset + header->m_stringsSize &&
+                 header->m_blobsSize == size - header->m_blobsOffset &&
+                 header->m_kdfSaltSize <= sizeof(header->m_kdfSalt);
+    if (!valid) {
+        std::cerr << "Error: " << path << " is not a supported vault snapshot" << std::endl;
+        ::munmap(base, size);
+        return false;
+    }
+
+    // Индекс читается случайным доступом (двоичный поиск)
+    ::madvise(base, size, MADV_RANDOM);
+
+    m_base = static_cast<const unsigned char*>(base);
+    m_size = size;
+    m_header = header;
+    m_index = reinterpret_cast<const snapshot_record_t*>(m_base + header->m_indexOffset);
+    return true;
+}
+
+void snapshot_t::close_() {
+    if (m_base) {
+        ::munmap(const_cast<unsigned char*>(m_base), m_size);
+    }
+    m_base = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+    m_index = nullptr;
+}
+
+size_t snapshot_t::size_() const {
+    return m_header ? m_header->m_entryCount : 0;
+}
+
+kdf_params_t snapshot_t::kdf_params_() const {
+    kdf_params_t params{};
+    if (!m_header) {
+        return params;
+    }
+    params.m_algorithm = static_cast<kdf_algorithm_t>(m_header->m_kdfAlgorithm);
+    params.m_iterations = m_header->m_kdfIterations;
+    params.m_scryptLogN = m_header->m_kdfScryptLogN;
+    params.m_scryptR = m_header->m_kdfScryptR;
+    params.m_scryptP = m_header->m_kdfScryptP;
+    params.m_lanes = m_header->m_kdfLanes;
+    params.m_salt.assign(m_header->m_kdfSalt, m_header->m_kdfSalt + m_header->m_kdfSaltSize);
+    return params;
+}
+
+bool snapshot_t::view_(const snapshot_record_t& record, bool withPassword, password_entry_view_t& view) const {
+    const char* strings = reinterpret_cast<const char*>(m_base + m_header->m_stringsOffset);
+    std::string_view* fields[4] = {&view.m_title, &view.m_url, &view.m_username, &view.m_notes};
+    for (int i = 0; i < 4; ++i) {
+        uint64_t offset = record.m_fields[i][0];
+        uint64_t length = record.m_fields[i][1];
+        if (offset + length > m_header->m_stringsSize) {
+            return false;
+        }
+        *fields[i] = std::string_view(strings + offset, length);
+    }
+
+    view.m_id = record.m_id;
+    view.m_encryptedPassword = nullptr;
+    view.m_encryptedSize = 0;
+    if (withPassword) {
+        if (uint64_t(record.m_blobOffset) + record.m_blobSize > m_header->m_blobsSize) {
+            return false;
+        }
+        view.m_encryptedPassword = m_base + m_header->m_blobsOffset + record.m_blobOffset;
+        view.m_encryptedSize = record.m_blobSize;
+    }
+    return true;
+}
+
+bool snapshot_t::matches_(const password_entry_view_t& view, const std::string& foldedQuery) {
+    for (std::string_view field : {view.m_title, view.m_url, view.m_username, view.m_notes}) {
+        if (find_folded(field.data(), field.size(), foldedQuery) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool snapshot_t::visit_(int id, const entry_visitor_t& visitor) const {
+    if (!m_header) {
+        return false;
+    }
+    const snapshot_record_t* end = m_index + m_header->m_entryCount;
+    const snapshot_record_t* it = std::lower_bound(m_index, end, id,
+        [](const snapshot_record_t& record, int value) { return record.m_id < value; });
+    if (it == end || it->m_id != id) {
+        return false;
+    }
+
+    password_entry_view_t view{};
+    if (!view_(*it, true, view)) {
+        std::cerr << "Error: snapshot entry " << id << " is corrupted" << std::endl;
+        return false;
+    }
+    visitor(view);
+    return true;
+}
+
+bool snapshot_t::for_each_(const std::string& query, const entry_visitor_t& visitor,
+                           const std::atomic<bool>* cancelled) const {
+    if (!m_header) {
+        return false;
+    }
+    bool all = is_blank(query);
+    std::string folded = fold_ascii(query);
+    password_entry_view_t view{};
+    for (uint32_t i = 0; i < m_header->m_entryCount; ++i) {
+        if (cancelled && (i & 1023) == 0 && cancelled->load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (!view_(m_index[i], true, view)) {
+            std::cerr << "Error: snapshot entry " << m_index[i].m_id << " is corrupted" << std::endl;
+            return false;
+        }
+        if (all || matches_(view, folded)) {
+            visitor(view);
+        }
+    }
+    return true;
+}
+
+bool snapshot_t::visit_page_(const std::string& query, int afterId, size_t limit,
+                             const entry_visitor_t& visitor) const {
+    if (!m_header) {
+        return false;
+    }
+    bool all = is_blank(query);
+    std::string folded = fold_ascii(query);
+    const snapshot_record_t* end = m_index + m_header->m_entryCount;
+    const snapshot_record_t* it = std::upper_bound(m_index, end, afterId,
+        [](int value, const snapshot_record_t& record) { return value < record.m_id; });
+
+    password_entry_view_t view{};
+    for (size_t count = 0; it != end && count < limit; ++it) {
+        if (!view_(*it, false, view)) {
+            std::cerr << "Error: snapshot entry " << it->m_id << " is corrupted" << std::endl;
+            return false;
+        }
+        if (all || matches_(view, folded)) {
+            visitor(view);
+            ++count;
+        }
+    }
+    return true;
+}
+
+bool snapshot_t::write_(const std::string& path,
+                        const std::vector<password_entry_t>& entries,
+                        const kdf_params_t& params) {
+    snapshot_header_t header{};
+    if (params.m_salt.size() > sizeof(header.m_kdfSalt) || entries.size() > UINT32_MAX) {
+        std::cerr << "Error: vault cannot be stored as a snapshot" << std::endl;
+        return false;
+    }
+
+    // Индекс и обе секции собираются в памяти; смещения 32-битные
+    std::vector<snapshot_record_t> index(entries.size());
+    std::string strings;
+    std::vector<unsigned char> blobs;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const password_entry_t& entry = entries[i];
+        snapshot_record_t& record = index[i];
+        record.m_id = entry.m_id;
+        const std::string* fields[4] = {&entry.m_title, &entry.m_url, &entry.m_username, &entry.m_notes};
+        for (int f = 0; f < 4; ++f) {
+            record.m_fields[f][0] = static_cast<uint32_t>(strings.size());
+            record.m_fields[f][1] = static_cast<uint32_t>(fields[f]->size());
+            strings += *fields[f];
+        }
+        record.m_blobOffset = static_cast<uint32_t>(blobs.size());
+        record.m_blobSize = static_cast<uint32_t>(entry.m_encryptedPassword.size());
+        blobs.insert(blobs.end(), entry.m_encryptedPassword.begin(), entry.m_encryptedPassword.end());
+
+        if (strings.size() > UINT32_MAX || blobs.size() > UINT32_MAX) {
+            std::cerr << "Error: vault is too large for a snapshot" << std::endl;
+            return false;
+        }
+    }
+
+    std::memcpy(header.m_magic, c_magic, sizeof(c_magic));
+    header.m_version = c_version;
+    header.m_byteOrder = c_byte_order;
+    header.m_headerSize = sizeof(snapshot_header_t);
+    header.m_entryCount = static_cast<uint32_t>(entries.size());
+    header.m_indexOffset = sizeof(snapshot_header_t);
+    header.m_stringsOffset = header.m_indexOffset + index.size() * sizeof(snapshot_record_t);
+    header.m_stringsSize = strings.size();
+    header.m_blobsOffset = header.m_stringsOffset + strings.size();
+    header.m_blobsSize = blobs.size();
+    header.m_fileSize = header.m_blobsOffset + blobs.size();
+    header.m_kdfAlgorithm = static_cast<uint32_t>(params.m_algorithm);
+    header.m_kdfIterations = params.m_iterations;
+    header.m_kdfScryptLogN = params.m_scryptLogN;
+    header.m_kdfScryptR = params.m_scryptR;
+    header.m_kdfScryptP = params.m_scryptP;
+    header.m_kdfLanes = params.m_lanes;
+    header.m_kdfSaltSize = static_cast<uint32_t>(params.m_salt.size());
+    std::copy(params.m_salt.begin(), params.m_salt.end(), header.m_kdfSalt);
+
+    // Временный файл и rename: открытый кем-то старый снимок остаётся целым
+    std::string tmpPath = path + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        std::cerr << "Error creating snapshot " << tmpPath << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    bool ok = write_all(fd, &header, sizeof(header)) &&
+              write_all(fd, index.data(), index.size() * sizeof(snapshot_record_t)) &&
+              write_all(fd, strings.data(), strings.size()) &&
+              write_all(fd, blobs.data(), blobs.size()) &&
+              ::fsync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+    if (!ok || ::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error writing snapshot " << path << ": " << std::strerror(errno) << std::endl;
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,159 @@
+#include "database/text_search.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define PASSMAN_X86_SIMD 1
+#endif
+
+namespace {
+
+inline unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c + ('a' - 'A')) : c;
+}
+
+/**
+ * @brief Совпадают ли size байт data с образцом без учёта регистра.
+ */
+inline bool equal_folded(const char* data, const char* needle, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        if (fold(static_cast<unsigned char>(data[i])) != static_cast<unsigned char>(needle[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Скалярный поиск с позиции from (он же - хвост для SIMD-вариантов).
+ */
+size_t find_scalar(const char* data, size_t size, const std::string& needle, size_t from) {
+    const size_t m = needle.size();
+    const unsigned char first = static_cast<unsigned char>(needle[0]);
+    for (size_t i = from; i + m <= size; ++i) {
+        if (fold(static_cast<unsigned char>(data[i])) == first &&
+            equal_folded(data + i + 1, needle.data() + 1, m - 1)) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+#ifdef PASSMAN_X86_SIMD
+
+/**
+ * @brief A-Z -> a-z для 16 байт. Сравнение знаковое, поэтому байты >= 0x80
+ *        (UTF-8) в диапазон не попадают и не меняются.
+ */
+inline __m128i fold_sse2(__m128i bytes) {
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmplt_epi8(bytes, _mm_set1_epi8('Z' + 1)));
+    return _mm_add_epi8(bytes, _mm_and_si128(upper, _mm_set1_epi8('a' - 'A')));
+}
+
+size_t find_sse2(const char* data, size_t size, const std::string& needle) {
+    const size_t m = needle.size();
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= size; i += 16) {
+        __m128i blockFirst = fold_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+        __m128i blockLast = fold_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + m - 1)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+        while (mask) {
+            size_t candidate = i + static_cast<size_t>(__builtin_ctz(mask));
+            if (m <= 2 || equal_folded(data + candidate + 1, needle.data() + 1, m - 2)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(data, size, needle, i);
+}
+
+__attribute__((target("avx2")))
+inline __m256i fold_avx2(__m256i bytes) {
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('A' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), bytes));
+    return _mm256_add_epi8(bytes, _mm256_and_si256(upper, _mm256_set1_epi8('a' - 'A')));
+}
+
+__attribute__((target("avx2")))
+size_t find_avx2(const char* data, size_t size, const std::string& needle) {
+    const size_t m = needle.size();
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[m - 1]);
+
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= size; i += 32) {
+        __m256i blockFirst = fold_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+        __m256i blockLast = fold_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + m - 1)));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last))));
+        while (mask) {
+            size_t candidate = i + static_cast<size_t>(__builtin_ctz(mask));
+            if (m <= 2 || equal_folded(data + candidate + 1, needle.data() + 1, m - 2)) {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+    return find_scalar(data, size, needle, i);
+}
+
+#endif // PASSMAN_X86_SIMD
+
+#ifndef PASSMAN_X86_SIMD
+size_t find_scalar_from_start(const char* data, size_t size, const std::string& needle) {
+    return find_scalar(data, size, needle, 0);
+}
+#endif
+
+using find_fn_t = size_t (*)(const char*, size_t, const std::string&);
+
+struct search_impl_t {
+    find_fn_t m_find;
+    const char* m_name;
+};
+
+search_impl_t select_impl() {
+#ifdef PASSMAN_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {find_avx2, "avx2"};
+    }
+    return {find_sse2, "sse2"};
+#else
+    return {find_scalar_from_start, "scalar"};
+#endif
+}
+
+const search_impl_t& impl() {
+    static const search_impl_t selected = select_impl();
+    return selected;
+}
+
+} // namespace
+
+std::string fold_ascii(std::string_view text) {
+    std::string folded(text);
+    for (char& c : folded) {
+        c = static_cast<char>(fold(static_cast<unsigned char>(c)));
+    }
+    return folded;
+}
+
+size_t find_folded(const char* data, size_t size, const std::string& foldedNeedle) {
+    if (foldedNeedle.empty()) {
+        return 0;
+    }
+    if (foldedNeedle.size() > size) {
+        return std::string::npos;
+    }
+    return impl().m_find(data, size, foldedNeedle);
+}
+
+const char* text_search_isa() {
+    return impl().m_name;
+}
@@ -0,0 +1,144 @@
+#include "encryption/crypto_pool.h"
+#include "encryption/session_key.h"
+#include <algorithm>
+
+namespace {
+
+/// Сколько элементов поток забирает за раз (меньше конкуренции за счётчик).
+const size_t c_chunk_size = 32;
+
+} // namespace
+
+crypto_pool_t::crypto_pool_t(size_t threadCount)
+    : m_threadCount(threadCount),
+      m_task(nullptr),
+      m_taskSize(0),
+      m_next(0),
+      m_busyWorkers(0),
+      m_generation(0),
+      m_stopping(false) {
+    if (m_threadCount == 0) {
+        m_threadCount = std::thread::hardware_concurrency();
+    }
+    if (m_threadCount == 0) {
+        m_threadCount = 1;
+    }
+    m_contexts.emplace_back(new cipher_context_t());
+}
+
+crypto_pool_t::~crypto_pool_t() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void crypto_pool_t::start_workers_() {
+    for (size_t i = 1; i < m_threadCount; ++i) {
+        m_contexts.emplace_back(new cipher_context_t());
+    }
+    for (size_t i = 1; i < m_threadCount; ++i) {
+        m_workers.emplace_back(&crypto_pool_t::worker_loop_, this, i);
+    }
+}
+
+void crypto_pool_t::worker_loop_(size_t index) {
+    cipher_context_t& ctx = *m_contexts[index];
+    uint64_t seenGeneration = 0;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+        if (m_stopping) {
+            return;
+        }
+        seenGeneration = m_generation;
+
+        lock.unlock();
+        process_chunks_(ctx);
+        lock.lock();
+
+        if (--m_busyWorkers == 0) {
+            m_done.notify_one();
+        }
+    }
+}
+
+void crypto_pool_t::process_chunks_(cipher_context_t& ctx) {
+    while (true) {
+        size_t begin = m_next.fetch_add(c_chunk_size);
+        if (begin >= m_taskSize) {
+            return;
+        }
+        size_t end = std::min(begin + c_chunk_size, m_taskSize);
+        for (size_t i = begin; i < end; ++i) {
+            (*m_task)(ctx, i);
+        }
+    }
+}
+
+void crypto_pool_t::parallel_for_(size_t count, const task_t& task) {
+    std::lock_guard<std::mutex> batchLock(m_batchMutex);
+
+    // Маленькие пакеты дешевле выполнить в текущем потоке
+    if (m_threadCount == 1 || count <= c_chunk_size) {
+        for (size_t i = 0; i < count; ++i) {
+            task(*m_contexts[0], i);
+        }
+        return;
+    }
+
+    if (m_workers.empty()) {
+        start_workers_();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_taskSize = count;
+        m_next.store(0);
+        m_busyWorkers = m_workers.size();
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    process_chunks_(*m_contexts[0]);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&] { return m_busyWorkers == 0; });
+    m_task = nullptr;
+    m_taskSize = 0;
+}
+
+std::vector<std::string> crypto_pool_t::decrypt_batch_(
+    const std::vector<ciphertext_ref_t>& ciphertexts,
+    const session_key_t& key,
+    std::vector<char>* decrypted
+) {
+    std::vector<std::string> plaintexts(ciphertexts.size());
+    if (decrypted) {
+        decrypted->assign(ciphertexts.size(), 0);
+    }
+    parallel_for_(ciphertexts.size(), [&](cipher_context_t& ctx, size_t i) {
+        bool ok = m_encryption.decrypt_checked_(ctx, ciphertexts[i].m_data, ciphertexts[i].m_size, key, plaintexts[i]);
+        if (decrypted) {
+            (*decrypted)[i] = ok;
+        }
+    });
+    return plaintexts;
+}
+
+std::vector<std::vector<unsigned char>> crypto_pool_t::encrypt_batch_(
+    const std::vector<std::string>& plaintexts,
+    const session_key_t& key
+) {
+    std::vector<std::vector<unsigned char>> ciphertexts(plaintexts.size());
+    parallel_for_(plaintexts.size(), [&](cipher_context_t& ctx, size_t i) {
+        ciphertexts[i] = m_encryption.encrypt_aes_(ctx, plaintexts[i], key);
+    });
+    return ciphertexts;
+}
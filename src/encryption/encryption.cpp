@@ -1,74 +1,297 @@
 #include "encryption/encryption.h"
-#include "config.h"
+#include "encryption/session_key.h"
+#include "encryption/kdf.h"
+#include "metrics/metrics.h"
 #include <openssl/evp.h>
 #include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <cstring>
 #include <iostream>
 
-encryption_t::encryption_t() {}
+namespace {
+
+const size_t c_nonce_size = 12;
+const size_t c_tag_size = 16;
 
 /**
- * @brief Generates an AES key from a master password using PBKDF2.
+ * @brief AES-256-GCM: [версия][nonce][шифртекст][тег], версия - в AAD.
+ * @return Число записанных байт или 0 при ошибке
  */
-std::vector<unsigned char> encryption_t::derive_key_(const std::string& masterPassword) {
-    std::vector<unsigned char> key(32); // 16 байт - ключ, 16 байт - IV
+size_t seal_gcm(cipher_context_t& context, const unsigned char* plaintext, size_t size,
+                const unsigned char* key, uint64_t keyId, unsigned char* out) {
+    METRICS_TIME(c_op_encrypt);
+    EVP_CIPHER_CTX* ctx = context.get_();
+    if (!ctx) return 0;
 
-    PKCS5_PBKDF2_HMAC_SHA1(
-        masterPassword.c_str(), masterPassword.length(),
-        c_static_salt.data(), c_static_salt.size(),
-        10000, // Количество итераций
-        key.size(), key.data()
-    );
+    unsigned char* nonce = out + 1;
+    unsigned char* body = nonce + c_nonce_size;
+    out[0] = encryption_t::c_format_gcm;
+    if (!context.prepare_gcm_(true, key, keyId) || !context.next_nonce_(nonce)) return 0;
 
-    return key;
+    int len = 0, body_len = 0;
+    bool ok = EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce) == 1;
+    ok = ok && EVP_EncryptUpdate(ctx, nullptr, &len, out, 1) == 1; // AAD
+    ok = ok && EVP_EncryptUpdate(ctx, body, &len, plaintext, static_cast<int>(size)) == 1;
+    body_len = len;
+    ok = ok && EVP_EncryptFinal_ex(ctx, body + body_len, &len) == 1;
+    body_len += len;
+    ok = ok && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, c_tag_size, body + body_len) == 1;
+    if (ok) {
+        METRICS_ADD(c_counter_bytes_encrypted, size);
+    }
+
+    return ok ? 1 + c_nonce_size + body_len + c_tag_size : 0;
 }
 
 /**
- * @brief Encrypts a plaintext password using AES-128-CBC.
+ * @brief Расшифровка AES-256-GCM с проверкой тега.
  */
-std::vector<unsigned char> encryption_t::encrypt_aes_(const std::string& plaintext, const std::vector<unsigned char>& key) {
-    std::vector<unsigned char> iv(key.begin() + 16, key.begin() + 32); // IV = последние 16 байт ключа
-    std::vector<unsigned char> ciphertext(plaintext.size() + EVP_MAX_BLOCK_LENGTH);
-    int len, ciphertext_len;
+bool open_gcm(cipher_context_t& context, const unsigned char* ciphertext, size_t size,
+              const unsigned char* key, uint64_t keyId, unsigned char* out, size_t& written) {
+    written = 0;
+    EVP_CIPHER_CTX* ctx = context.get_();
+    if (!ctx || size < encryption_t::c_gcm_overhead || !context.prepare_gcm_(false, key, keyId)) return false;
 
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) return {};
+    const unsigned char* nonce = ciphertext + 1;
+    const unsigned char* body = nonce + c_nonce_size;
+    size_t body_size = size - encryption_t::c_gcm_overhead;
+    unsigned char* tag = const_cast<unsigned char*>(body + body_size); // OpenSSL только читает тег
 
-    EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr, key.data(), iv.data());
+    int len = 0, plaintext_len = 0;
+    bool ok = EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, nonce) == 1;
+    ok = ok && EVP_DecryptUpdate(ctx, nullptr, &len, ciphertext, 1) == 1; // AAD
+    ok = ok && EVP_DecryptUpdate(ctx, out, &len, body, static_cast<int>(body_size)) == 1;
+    plaintext_len = len;
+    ok = ok && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, c_tag_size, tag) == 1;
+    ok = ok && EVP_DecryptFinal_ex(ctx, out + plaintext_len, &len) == 1;
+
+    if (!ok) return false;
+    written = plaintext_len + len;
+    return true;
+}
 
-    EVP_EncryptUpdate(ctx, ciphertext.data(), &len, reinterpret_cast<const unsigned char*>(plaintext.data()), plaintext.size());
-    ciphertext_len = len;
+/**
+ * @brief Старый формат AES-128-CBC: первые 16 байт ключа - ключ, последние 16 - IV.
+ * @return false, если не сошлось дополнение (неверный ключ или повреждённые данные)
+ */
+bool open_legacy_cbc(cipher_context_t& context, const unsigned char* ciphertext, size_t size,
+                     const unsigned char* key, unsigned char* out, size_t& written) {
+    written = 0;
+    EVP_CIPHER_CTX* ctx = context.get_();
+    if (!ctx) return false;
+    context.reset_gcm_();
 
-    EVP_EncryptFinal_ex(ctx, ciphertext.data() + len, &len);
-    ciphertext_len += len;
+    const unsigned char* iv = key + 16; // IV = последние 16 байт ключа
+    int len = 0, plaintext_len = 0;
 
-    ciphertext.resize(ciphertext_len);
-    EVP_CIPHER_CTX_free(ctx);
+    bool ok = EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr, key, iv) == 1;
+    ok = ok && EVP_DecryptUpdate(ctx, out, &len, ciphertext, static_cast<int>(size)) == 1;
+    plaintext_len = len;
+    ok = ok && EVP_DecryptFinal_ex(ctx, out + plaintext_len, &len) == 1;
 
-    return ciphertext;
+    if (!ok) return false;
+    written = plaintext_len + len;
+    return true;
 }
 
 /**
- * @brief Decrypts an AES-128-CBC encrypted password.
+ * @brief Выбирает формат только по байту версии: 0x02 - GCM, иначе старый CBC.
+ *        Неверный тег GCM - ошибка: откат на CBC дал бы "успех" с мусором
+ *        при неверном ключе примерно в 1 случае из 256.
+ * @param authenticated Если задан: прошёл ли блок проверку тега GCM
  */
-std::string encryption_t::decrypt_aes_(const std::vector<unsigned char>& ciphertext, const std::vector<unsigned char>& key) {
-    std::vector<unsigned char> iv(key.begin() + 16, key.begin() + 32); // IV = последние 16 байт ключа
-    std::vector<unsigned char> plaintext(ciphertext.size());
-    int len, plaintext_len;
+bool decrypt_with_key(cipher_context_t& ctx, const unsigned char* ciphertext, size_t size,
+                      const unsigned char* key, uint64_t keyId, unsigned char* out, size_t& written,
+                      bool* authenticated = nullptr) {
+    METRICS_TIME(c_op_decrypt);
+    bool ok = false;
+    bool gcm = size > 0 && ciphertext[0] == encryption_t::c_format_gcm;
+    if (gcm) {
+        ok = open_gcm(ctx, ciphertext, size, key, keyId, out, written);
+    } else if (size > 0 && size % 16 == 0) {
+        ok = open_legacy_cbc(ctx, ciphertext, size, key, out, written);
+    }
+    if (authenticated) {
+        *authenticated = ok && gcm;
+    }
+    if (!ok) {
+        // Неаутентифицированный текст не должен остаться в буфере
+        OPENSSL_cleanse(out, encryption_t::decrypted_capacity_(size));
+        written = 0;
+        METRICS_ADD(c_counter_decrypt_failures, 1);
+    } else {
+        METRICS_ADD(c_counter_bytes_decrypted, written);
+    }
+    return ok;
+}
 
-    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
-    if (!ctx) return "";
+} // namespace
 
-    EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr, key.data(), iv.data());
+cipher_context_t::cipher_context_t()
+    : m_ctx(EVP_CIPHER_CTX_new()), m_gcmMode(0), m_gcmKeyId(0), m_noncePrefix{}, m_nonceCounter(0) {
+    if (!m_ctx) {
+        std::cerr << "Error allocating cipher context" << std::endl;
+    }
+}
 
-    EVP_DecryptUpdate(ctx, plaintext.data(), &len, ciphertext.data(), ciphertext.size());
-    plaintext_len = len;
+cipher_context_t::~cipher_context_t() {
+    EVP_CIPHER_CTX_free(m_ctx); // обнуляет и развёрнутый ключ
+}
 
-    EVP_DecryptFinal_ex(ctx, plaintext.data() + len, &len);
-    plaintext_len += len;
+/**
+ * @brief Full GCM setup only when the key or direction changes; otherwise the
+ *        expanded key stays in the context and callers only set a new nonce.
+ */
+bool cipher_context_t::prepare_gcm_(bool encrypt, const unsigned char* key, uint64_t keyId) {
+    int mode = encrypt ? 1 : 2;
+    if (m_gcmMode == mode && keyId != 0 && m_gcmKeyId == keyId) {
+        return true;
+    }
+
+    m_gcmMode = 0;
+    int rc = encrypt ? EVP_EncryptInit_ex(m_ctx, EVP_aes_256_gcm(), nullptr, key, nullptr)
+                     : EVP_DecryptInit_ex(m_ctx, EVP_aes_256_gcm(), nullptr, key, nullptr);
+    if (rc != 1) {
+        return false;
+    }
+    m_gcmKeyId = keyId;
+    m_gcmMode = mode;
+    return true;
+}
 
-    plaintext.resize(plaintext_len);
-    EVP_CIPHER_CTX_free(ctx);
+/**
+ * @brief Deterministic nonce construction (random per-context prefix + counter),
+ *        avoiding a RAND_bytes call per entry.
+ */
+bool cipher_context_t::next_nonce_(unsigned char* nonce) {
+    if (m_nonceCounter == 0 && RAND_bytes(m_noncePrefix, sizeof(m_noncePrefix)) != 1) {
+        return false;
+    }
 
-    return std::string(plaintext.begin(), plaintext.end());
+    std::memcpy(nonce, m_noncePrefix, sizeof(m_noncePrefix));
+    for (int i = 0; i < 4; ++i) {
+        nonce[sizeof(m_noncePrefix) + i] = static_cast<unsigned char>(m_nonceCounter >> (8 * i));
+    }
+    ++m_nonceCounter; // после 2^32 nonce счётчик обнуляется и префикс обновляется
+    return true;
 }
 
+encryption_t::encryption_t() {}
+
+/**
+ * @brief Generates an AES key from a master password using PBKDF2.
+ */
+std::vector<unsigned char> encryption_t::derive_key_(const std::string& masterPassword) {
+    std::vector<unsigned char> key(32); // ключ AES-256 (в старом формате CBC: 16 байт ключа + 16 байт IV)
+    derive_key_into_(masterPassword, key.data(), key.size());
+    return key;
+}
+
+/**
+ * @brief Same as derive_key_, but writes the key into a caller-owned buffer.
+ */
+bool encryption_t::derive_key_into_(const std::string& masterPassword, unsigned char* out, size_t outSize) {
+    METRICS_TIME(c_op_derive_key);
+    return derive_kdf_key(masterPassword, kdf_params_t::legacy_(), out, outSize);
+}
+
+/**
+ * @brief Encrypts into a caller-owned buffer of at least encrypted_size_(size) bytes.
+ */
+size_t encryption_t::encrypt_into_(cipher_context_t& ctx, const unsigned char* plaintext, size_t size,
+                                   const session_key_t& key, unsigned char* out) {
+    if (key.size() < 32) return 0;
+    return seal_gcm(ctx, plaintext, size, key.data(), key.id_(), out);
+}
+
+/**
+ * @brief Decrypts into a caller-owned buffer of at least decrypted_capacity_(size) bytes.
+ */
+bool encryption_t::decrypt_into_(cipher_context_t& ctx, const unsigned char* ciphertext, size_t size,
+                                 const session_key_t& key, unsigned char* out, size_t& written) {
+    written = 0;
+    if (key.size() < 32) return false;
+    return decrypt_with_key(ctx, ciphertext, size, key.data(), key.id_(), out, written);
+}
+
+/**
+ * @brief Encrypts a plaintext password using AES-256-GCM.
+ */
+std::vector<unsigned char> encryption_t::encrypt_aes_(const std::string& plaintext, const std::vector<unsigned char>& key) {
+    if (key.size() < 32) return {};
+    cipher_context_t ctx;
+    std::vector<unsigned char> ciphertext(encrypted_size_(plaintext.size()));
+    size_t written = seal_gcm(ctx, reinterpret_cast<const unsigned char*>(plaintext.data()),
+                              plaintext.size(), key.data(), 0, ciphertext.data());
+    ciphertext.resize(written);
+    return ciphertext;
+}
+
+/**
+ * @brief Encrypts a plaintext password with the cached session key.
+ */
+std::vector<unsigned char> encryption_t::encrypt_aes_(const std::string& plaintext, const session_key_t& key) {
+    cipher_context_t ctx;
+    return encrypt_aes_(ctx, plaintext, key);
+}
+
+/**
+ * @brief Encrypts with the session key, reusing the caller's cipher context.
+ */
+std::vector<unsigned char> encryption_t::encrypt_aes_(cipher_context_t& ctx, const std::string& plaintext, const session_key_t& key) {
+    std::vector<unsigned char> ciphertext(encrypted_size_(plaintext.size()));
+    size_t written = encrypt_into_(ctx, reinterpret_cast<const unsigned char*>(plaintext.data()),
+                                   plaintext.size(), key, ciphertext.data());
+    ciphertext.resize(written);
+    return ciphertext;
+}
+
+/**
+ * @brief Decrypts an AES-256-GCM (or legacy AES-128-CBC) encrypted password.
+ */
+std::string encryption_t::decrypt_aes_(const std::vector<unsigned char>& ciphertext, const std::vector<unsigned char>& key) {
+    if (key.size() < 32) return "";
+    cipher_context_t ctx;
+    std::string plaintext(decrypted_capacity_(ciphertext.size()), '\0');
+    size_t written = 0;
+    decrypt_with_key(ctx, ciphertext.data(), ciphertext.size(), key.data(), 0,
+                     reinterpret_cast<unsigned char*>(&plaintext[0]), written);
+    plaintext.resize(written);
+    return plaintext;
+}
+
+/**
+ * @brief Decrypts a password blob with the cached session key.
+ */
+std::string encryption_t::decrypt_aes_(const unsigned char* ciphertext, size_t size, const session_key_t& key) {
+    cipher_context_t ctx;
+    return decrypt_aes_(ctx, ciphertext, size, key);
+}
+
+/**
+ * @brief Decrypts with the session key, reusing the caller's cipher context.
+ */
+std::string encryption_t::decrypt_aes_(cipher_context_t& ctx, const unsigned char* ciphertext, size_t size, const session_key_t& key) {
+    std::string plaintext;
+    decrypt_checked_(ctx, ciphertext, size, key, plaintext);
+    return plaintext;
+}
+
+/**
+ * @brief Decrypts with the session key and reports whether authentication passed.
+ */
+bool encryption_t::decrypt_checked_(cipher_context_t& ctx, const unsigned char* ciphertext, size_t size,
+                                    const session_key_t& key, std::string& plaintext, bool* authenticated) {
+    plaintext.resize(decrypted_capacity_(size));
+    size_t written = 0;
+    bool ok = false;
+    if (authenticated) {
+        *authenticated = false;
+    }
+    if (key.size() >= 32) {
+        ok = decrypt_with_key(ctx, ciphertext, size, key.data(), key.id_(),
+                              reinterpret_cast<unsigned char*>(&plaintext[0]), written, authenticated);
+    }
+    plaintext.resize(written);
+    return ok;
+}
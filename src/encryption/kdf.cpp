@@ -0,0 +1,243 @@
+#include "encryption/kdf.h"
+#include "config.h"
+#include "metrics/metrics.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+const size_t c_salt_size = 16;
+const uint32_t c_legacy_iterations = 10000;
+const uint32_t c_min_pbkdf2_iterations = 100000;
+const uint32_t c_min_scrypt_log_n = 14;  // 16 MiB при r = 8
+const uint32_t c_max_scrypt_log_n = 30;
+const uint32_t c_scrypt_r = 8;
+const uint32_t c_max_lanes = 256;
+const size_t c_lane_key_size = 32;
+const char c_lanes_info[] = "passman kdf lanes";
+
+std::vector<unsigned char> random_salt() {
+    std::vector<unsigned char> salt(c_salt_size);
+    if (RAND_bytes(salt.data(), static_cast<int>(salt.size())) != 1) {
+        std::cerr << "Error generating salt" << std::endl;
+        salt.clear();
+    }
+    return salt;
+}
+
+/**
+ * @brief Память, которую scrypt выделит при этих параметрах (с запасом).
+ */
+uint64_t scrypt_memory(uint32_t logN, uint32_t r, uint32_t p) {
+    uint64_t n = uint64_t(1) << logN;
+    return 128ULL * r * (n + p + 2) + (1ULL << 20);
+}
+
+/**
+ * @brief Один проход выбранного алгоритма (без полос).
+ */
+bool derive_single(const std::string& password, const kdf_params_t& params,
+                   const unsigned char* salt, size_t saltSize,
+                   unsigned char* out, size_t outSize) {
+    switch (params.m_algorithm) {
+        case kdf_algorithm_t::pbkdf2_sha1_legacy:
+        case kdf_algorithm_t::pbkdf2_sha256: {
+            if (params.m_iterations == 0) {
+                return false;
+            }
+            const EVP_MD* md = params.m_algorithm == kdf_algorithm_t::pbkdf2_sha256 ? EVP_sha256() : EVP_sha1();
+            return PKCS5_PBKDF2_HMAC(password.c_str(), static_cast<int>(password.size()),
+                                     salt, static_cast<int>(saltSize),
+                                     static_cast<int>(params.m_iterations), md,
+                                     static_cast<int>(outSize), out) == 1;
+        }
+
+        case kdf_algorithm_t::scrypt: {
+            if (params.m_scryptLogN == 0 || params.m_scryptLogN > c_max_scrypt_log_n ||
+                params.m_scryptR == 0 || params.m_scryptP == 0) {
+                return false;
+            }
+            return EVP_PBE_scrypt(password.c_str(), password.size(), salt, saltSize,
+                                  uint64_t(1) << params.m_scryptLogN, params.m_scryptR, params.m_scryptP,
+                                  scrypt_memory(params.m_scryptLogN, params.m_scryptR, params.m_scryptP),
+                                  out, outSize) == 1;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Сводит выходы полос в ключ: HKDF-SHA256 (соль хранилища, фиксированный info).
+ */
+bool combine_lanes(const std::vector<unsigned char>& laneKeys, const std::vector<unsigned char>& salt,
+                   unsigned char* out, size_t outSize) {
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+    if (!ctx) {
+        return false;
+    }
+    size_t length = outSize;
+    bool ok = EVP_PKEY_derive_init(ctx) == 1 &&
+              EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha256()) == 1 &&
+              EVP_PKEY_CTX_set1_hkdf_salt(ctx, salt.data(), static_cast<int>(salt.size())) == 1 &&
+              EVP_PKEY_CTX_set1_hkdf_key(ctx, laneKeys.data(), static_cast<int>(laneKeys.size())) == 1 &&
+              EVP_PKEY_CTX_add1_hkdf_info(ctx, reinterpret_cast<const unsigned char*>(c_lanes_info),
+                                          static_cast<int>(sizeof(c_lanes_info) - 1)) == 1 &&
+              EVP_PKEY_derive(ctx, out, &length) == 1 &&
+              length == outSize;
+    EVP_PKEY_CTX_free(ctx);
+    return ok;
+}
+
+/**
+ * @brief Выводит все полосы на min(lanes, ядра) потоках и сводит их в ключ.
+ */
+bool derive_lanes(const std::string& password, const kdf_params_t& params,
+                  unsigned char* out, size_t outSize) {
+    const uint32_t lanes = params.m_lanes;
+    std::vector<unsigned char> laneKeys(lanes * c_lane_key_size);
+    std::atomic<uint32_t> nextLane(0);
+    std::atomic<bool> failed(false);
+
+    auto worker = [&]() {
+        std::vector<unsigned char> salt(params.m_salt);
+        salt.resize(params.m_salt.size() + 4);
+        for (uint32_t lane = nextLane++; lane < lanes && !failed; lane = nextLane++) {
+            for (int i = 0; i < 4; ++i) {
+                salt[params.m_salt.size() + i] = static_cast<unsigned char>(lane >> (8 * i));
+            }
+            if (!derive_single(password, params, salt.data(), salt.size(),
+                               &laneKeys[lane * c_lane_key_size], c_lane_key_size)) {
+                failed = true;
+            }
+        }
+    };
+
+    unsigned int threads = std::min<unsigned int>(lanes, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned int i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    bool ok = !failed && combine_lanes(laneKeys, params.m_salt, out, outSize);
+    OPENSSL_cleanse(laneKeys.data(), laneKeys.size());
+    return ok;
+}
+
+/**
+ * @brief Время одного вывода ключа с тестовым паролем.
+ */
+double time_derive_ms(const kdf_params_t& params) {
+    unsigned char out[32];
+    auto started = std::chrono::steady_clock::now();
+    derive_kdf_key("calibration-password", params, out, sizeof(out));
+    OPENSSL_cleanse(out, sizeof(out));
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+}
+
+} // namespace
+
+kdf_params_t kdf_params_t::legacy_() {
+    return kdf_params_t{kdf_algorithm_t::pbkdf2_sha1_legacy, c_legacy_iterations, 0, 0, 0, c_static_salt};
+}
+
+kdf_params_t kdf_params_t::with_new_salt_() const {
+    kdf_params_t params = *this;
+    params.m_salt = random_salt();
+    return params;
+}
+
+std::string kdf_params_t::describe_() const {
+    std::string lanes = m_lanes > 1 ? " x " + std::to_string(m_lanes) + " lanes" : std::string();
+    switch (m_algorithm) {
+        case kdf_algorithm_t::pbkdf2_sha1_legacy:
+            return "PBKDF2-SHA1 (legacy) " + std::to_string(m_iterations) + " iterations" + lanes;
+        case kdf_algorithm_t::pbkdf2_sha256:
+            return "PBKDF2-SHA256 " + std::to_string(m_iterations) + " iterations" + lanes;
+        case kdf_algorithm_t::scrypt:
+            return "scrypt N=2^" + std::to_string(m_scryptLogN) + " r=" + std::to_string(m_scryptR) +
+                   " p=" + std::to_string(m_scryptP) + lanes;
+    }
+    return "unknown KDF";
+}
+
+bool derive_kdf_key(const std::string& password, const kdf_params_t& params,
+                    unsigned char* out, size_t outSize) {
+    METRICS_TIME(c_op_kdf);
+    if (params.m_salt.empty()) {
+        std::cerr << "Error: KDF salt is missing" << std::endl;
+        return false;
+    }
+
+    if (params.m_lanes == 0 || params.m_lanes > c_max_lanes) {
+        std::cerr << "Error: invalid KDF lane count " << params.m_lanes << std::endl;
+        return false;
+    }
+    if (params.m_lanes > 1) {
+        return derive_lanes(password, params, out, outSize);
+    }
+    return derive_single(password, params, params.m_salt.data(), params.m_salt.size(), out, outSize);
+}
+
+uint32_t default_kdf_lanes() {
+    return std::min(std::max(1u, std::thread::hardware_concurrency()), c_max_lanes);
+}
+
+kdf_params_t calibrate_kdf(kdf_algorithm_t algorithm, std::chrono::milliseconds target, size_t maxMemoryMib,
+                           uint32_t lanes) {
+    double targetMs = static_cast<double>(std::max<long long>(target.count(), 1));
+    lanes = std::min(std::max<uint32_t>(lanes, 1), c_max_lanes);
+
+    // scrypt: N подбирается для одной полосы, как без полос, а полосы добавляются только
+    // на свободную память - каждая делает полный проход N x r над своей памятью
+    // одновременно с остальными, так что память на попытку не уменьшается
+    if (algorithm == kdf_algorithm_t::scrypt) {
+        kdf_params_t params{kdf_algorithm_t::scrypt, 0, c_min_scrypt_log_n, c_scrypt_r, 1, random_salt()};
+        uint64_t maxMemory = static_cast<uint64_t>(maxMemoryMib) << 20;
+
+        // Удваиваем память, пока вывод укладывается во время и потолок памяти
+        double elapsed = time_derive_ms(params);
+        while (params.m_scryptLogN < c_max_scrypt_log_n &&
+               elapsed * 2 <= targetMs &&
+               scrypt_memory(params.m_scryptLogN + 1, params.m_scryptR, 1) <= maxMemory) {
+            ++params.m_scryptLogN;
+            elapsed = time_derive_ms(params);
+        }
+
+        // Полос - не больше ядер (лишняя полоса удлиняет разблокировку) и сколько
+        // проходов этого N одновременно помещается в потолок памяти (при
+        // разблокировке ядер может быть больше, и все полосы пойдут разом)
+        uint64_t laneMemory = (128ULL * params.m_scryptR) << params.m_scryptLogN;
+        uint64_t fitting = std::max<uint64_t>(maxMemory / laneMemory, 1);
+        params.m_lanes = static_cast<uint32_t>(std::min<uint64_t>(std::min(lanes, default_kdf_lanes()), fitting));
+        if (params.m_lanes > 1) {
+            elapsed = time_derive_ms(params);
+        }
+
+        // Остаток времени - параллелизмом (p проходов над памятью полосы)
+        if (elapsed > 0.0 && elapsed * 2 <= targetMs) {
+            params.m_scryptP = static_cast<uint32_t>(targetMs / elapsed);
+        }
+        return params;
+    }
+
+    // PBKDF2 (старая схема для новых хранилищ не выбирается): стоимость линейна по итерациям
+    const uint32_t probeIterations = 20000;
+    kdf_params_t params{kdf_algorithm_t::pbkdf2_sha256, probeIterations, 0, 0, 0, random_salt()};
+
+    double elapsed = std::max(time_derive_ms(params), 0.001);
+    double scaled = std::min(probeIterations * targetMs / elapsed, 2.0e9) / lanes;
+    params.m_iterations = static_cast<uint32_t>(std::max(scaled, static_cast<double>(c_min_pbkdf2_iterations)) + 0.5);
+    params.m_lanes = lanes;
+    return params;
+}
@@ -0,0 +1,99 @@
+#include "encryption/session_key.h"
+#include "encryption/encryption.h"
+#include "encryption/kdf.h"
+#include <openssl/crypto.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <iostream>
+
+namespace {
+
+std::atomic<uint64_t> g_nextKeyId{1};
+
+} // namespace
+
+session_key_t::session_key_t() : m_data(nullptr), m_size(0), m_locked(false), m_id(0) {}
+
+session_key_t::~session_key_t() {
+    release_();
+}
+
+session_key_t::session_key_t(session_key_t&& other) noexcept
+    : m_data(other.m_data), m_size(other.m_size), m_locked(other.m_locked), m_id(other.m_id) {
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_locked = false;
+    other.m_id = 0;
+}
+
+session_key_t& session_key_t::operator=(session_key_t&& other) noexcept {
+    if (this != &other) {
+        release_();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_locked = other.m_locked;
+        m_id = other.m_id;
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_locked = false;
+        other.m_id = 0;
+    }
+    return *this;
+}
+
+/**
+ * @brief Обнуляет ключ, снимает mlock и освобождает память.
+ */
+void session_key_t::release_() {
+    if (!m_data) return;
+
+    OPENSSL_cleanse(m_data, m_size);
+    if (m_locked) {
+        munlock(m_data, m_size);
+    }
+    delete[] m_data;
+
+    m_data = nullptr;
+    m_size = 0;
+    m_locked = false;
+    m_id = 0;
+}
+
+session_key_t session_key_t::allocate_() {
+    session_key_t key;
+    key.m_data = new unsigned char[c_key_size];
+    key.m_size = c_key_size;
+    key.m_id = g_nextKeyId.fetch_add(1, std::memory_order_relaxed);
+
+    // Закрепляем страницы до записи ключа, чтобы он не попал в swap
+    key.m_locked = (mlock(key.m_data, key.m_size) == 0);
+    if (!key.m_locked) {
+        std::cerr << "Warning: could not lock session key memory" << std::endl;
+    }
+    return key;
+}
+
+session_key_t session_key_t::derive_(encryption_t& encryption, const std::string& masterPassword) {
+    session_key_t key = allocate_();
+    if (!encryption.derive_key_into_(masterPassword, key.m_data, key.m_size)) {
+        std::cerr << "Error deriving session key" << std::endl;
+        key.release_();
+    }
+    return key;
+}
+
+session_key_t session_key_t::derive_(const std::string& masterPassword, const kdf_params_t& params) {
+    session_key_t key = allocate_();
+    if (!derive_kdf_key(masterPassword, params, key.m_data, key.m_size)) {
+        std::cerr << "Error deriving session key" << std::endl;
+        key.release_();
+    }
+    return key;
+}
+
+bool session_key_t::equals_(const session_key_t& other) const {
+    if (m_size != other.m_size || m_size == 0) {
+        return false;
+    }
+    return CRYPTO_memcmp(m_data, other.m_data, m_size) == 0;
+}
@@ -0,0 +1,184 @@
+#include "interface/incremental_search.h"
+#include "database/text_search.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+// Как часто (в записях) уточнение проверяет флаг отмены
+const size_t c_cancel_check_rows = 4096;
+
+// Сколько нечётких совпадений показывать, когда точных нет
+const size_t c_fuzzy_limit = 200;
+
+bool is_blank(const std::string& query) {
+    return std::all_of(query.begin(), query.end(), [](unsigned char c) { return std::isspace(c); });
+}
+
+/**
+ * @brief Копирует метаданные записи в результат (пароль не нужен для списка).
+ */
+void append_metadata(entry_result_set_t& results, int id, std::string_view title, std::string_view url,
+                     std::string_view username, std::string_view notes) {
+    pmr_password_entry_t& entry = results.append_();
+    entry.m_id = id;
+    entry.m_title.assign(title.data(), title.size());
+    entry.m_url.assign(url.data(), url.size());
+    entry.m_username.assign(username.data(), username.size());
+    entry.m_notes.assign(notes.data(), notes.size());
+}
+
+bool contains(std::string_view field, const std::string& folded) {
+    return find_folded(field.data(), field.size(), folded) != std::string::npos;
+}
+
+} // namespace
+
+incremental_search_t::incremental_search_t(database_t& db)
+    : m_db(db),
+      m_notifyFd(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      m_pendingGeneration(0),
+      m_generation(0),
+      m_stop(false),
+      m_cancel(false) {
+    m_worker = std::thread(&incremental_search_t::run_, this);
+}
+
+incremental_search_t::~incremental_search_t() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_cancel = true;
+    }
+    m_wakeup.notify_one();
+    m_worker.join();
+    if (m_notifyFd >= 0) {
+        ::close(m_notifyFd);
+    }
+}
+
+uint64_t incremental_search_t::submit_(const std::string& query) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        generation = ++m_generation;
+        m_pendingQuery = query;
+        m_pendingGeneration = generation;
+        m_cancel = true; // выполняющийся запрос уже устарел
+    }
+    m_wakeup.notify_one();
+    return generation;
+}
+
+std::shared_ptr<const incremental_search_t::result_t> incremental_search_t::latest_() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_latest;
+}
+
+void incremental_search_t::consume_notify_() {
+    uint64_t counter;
+    if (m_notifyFd >= 0) {
+        ssize_t ignored = ::read(m_notifyFd, &counter, sizeof(counter));
+        (void)ignored;
+    }
+}
+
+void incremental_search_t::run_() {
+    // Последний завершённый результат - основа для уточнения следующего запроса
+    std::shared_ptr<const result_t> base;
+
+    while (true) {
+        std::string query;
+        uint64_t generation;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait(lock, [&] { return m_stop || m_pendingGeneration != 0; });
+            if (m_stop) {
+                return;
+            }
+            query.swap(m_pendingQuery);
+            generation = m_pendingGeneration;
+            m_pendingGeneration = 0;
+            m_cancel = false;
+        }
+
+        std::shared_ptr<result_t> result = execute_(query, generation, base);
+        if (!result) {
+            continue; // отменён более новым запросом
+        }
+        base = result;
+        publish_(result);
+    }
+}
+
+std::shared_ptr<incremental_search_t::result_t> incremental_search_t::execute_(
+    const std::string& query,
+    uint64_t generation,
+    const std::shared_ptr<const result_t>& base
+) {
+    auto started = std::chrono::steady_clock::now();
+    auto result = std::make_shared<result_t>();
+    result->m_generation = generation;
+    result->m_query = query;
+    result->m_refined = false;
+    result->m_fuzzy = false;
+
+    // Пустой запрос ничего не показывает: список всего хранилища - это View All
+    if (!is_blank(query)) {
+        std::string folded = fold_ascii(query);
+        bool refine = base && !base->m_fuzzy && !is_blank(base->m_query) && m_db.substring_search_() &&
+                      folded.find(fold_ascii(base->m_query)) != std::string::npos;
+
+        if (refine) {
+            // Совпадения нового запроса - подмножество прежних
+            result->m_refined = true;
+            size_t checked = 0;
+            for (const pmr_password_entry_t& entry : base->m_entries) {
+                if (++checked % c_cancel_check_rows == 0 && m_cancel.load(std::memory_order_relaxed)) {
+                    return nullptr;
+                }
+                if (contains(entry.m_title, folded) || contains(entry.m_url, folded) ||
+                    contains(entry.m_username, folded) || contains(entry.m_notes, folded)) {
+                    append_metadata(result->m_entries, entry.m_id, entry.m_title, entry.m_url,
+                                    entry.m_username, entry.m_notes);
+                }
+            }
+        } else {
+            bool ok = m_db.for_each_entry_(query, [&](const password_entry_view_t& view) {
+                append_metadata(result->m_entries, view.m_id, view.m_title, view.m_url,
+                                view.m_username, view.m_notes);
+            }, &m_cancel);
+            if (!ok) {
+                return nullptr;
+            }
+        }
+
+        if (result->m_entries.empty()) {
+            result->m_fuzzy = true;
+            if (!m_db.search_ranked_(query, c_fuzzy_limit, result->m_entries, &m_cancel)) {
+                return nullptr;
+            }
+        }
+    }
+
+    if (m_cancel.load(std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    result->m_millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return result;
+}
+
+void incremental_search_t::publish_(std::shared_ptr<const result_t> result) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_latest = std::move(result);
+    }
+    if (m_notifyFd >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = ::write(m_notifyFd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
@@ -1,10 +1,39 @@
 #include "interface/tui.h"
 #include "database/database.h"
+#include "database/async_database.h"
+#include "database/cursor.h"
+#include "interface/incremental_search.h"
+#include "metrics/metrics.h"
 
 #include <iostream>
 #include <limits>
 #include <iomanip>   // для setw и т.д.
 #include <sstream>
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+/// Сколько записей показывать на одной странице при просмотре всех записей.
+static const size_t c_page_size = 20;
+
+/// Сколько лучших совпадений показывать в результатах поиска.
+static const size_t c_search_limit = 50;
+
+/// Целевое время вывода ключа (мс) при переходе со старой схемы KDF.
+static const int c_unlock_ms = 250;
+
+/// Строк экрана, занятых поиском при вводе помимо списка (подсказка, статус, шапка, низ).
+static const int c_search_chrome_rows = 5;
+
+/// Период перерисовки строки состояния при ожидании долгой операции (мс).
+static const int c_progress_ms = 100;
 
 /**
  * @brief Заглушка для копирования пароля в буфер обмена.
@@ -32,13 +61,16 @@ static void print_table_header() {
 }
 
 /**
- * @brief Печатает строку «таблицы» для одной записи.
+ * @brief Печатает строку «таблицы» для одной записи (без выделения памяти).
  * @param index Порядковый номер (1-based).
- * @param entry Структура записи (без расшифрованного пароля).
+ * @param entry Представление записи (без расшифрованного пароля).
  */
-static void print_table_row(int index, const password_entry_t& entry) {
+static void print_table_row(int index, const password_entry_view_t& entry) {
+    char number[16];
+    std::snprintf(number, sizeof(number), "%d)", index);
+
     std::cout << std::left
-              << std::setw(4)  << (std::to_string(index) + ")")
+              << std::setw(4)  << number
               << std::setw(6)  << entry.m_id
               << std::setw(15) << entry.m_title
               << std::setw(20) << entry.m_url
@@ -47,6 +79,10 @@ static void print_table_row(int index, const password_entry_t& entry) {
               << "\n";
 }
 
+static void print_table_row(int index, const password_entry_t& entry) {
+    print_table_row(index, password_entry_view_t::of_(entry));
+}
+
 /**
  * @brief Печатает единственную запись в табличном стиле (шапка + одна строка).
  * @param entry запись, которую нужно вывести
@@ -61,11 +97,11 @@ static void print_single_entry_as_table(const password_entry_t& entry, int index
 /**
  * @brief Меню для выбранной записи (операции над одной записью).
  * @param db Ссылка на объект базы данных
- * @param masterPassword Мастер-пароль
+ * @param key Ключ сессии
  * @param entryId ID записи, которую хотим просмотреть/редактировать
  */
 static void handle_entry_menu(database_t& db,
-                              const std::string& masterPassword,
+                              const session_key_t& key,
                               int entryId) 
 {
     // Сразу получаем запись из базы:
@@ -117,7 +153,7 @@ static void handle_entry_menu(database_t& db,
 
             bool ok = db.update_entry_(entryId, newTitle, newUrl,
                                        newUsername, newPass, newNotes,
-                                       masterPassword);
+                                       key);
             if (ok) {
                 std::cout << "Entry updated.\n";
                 // Заново получаем запись, чтобы отобразить актуальные данные
@@ -128,7 +164,7 @@ static void handle_entry_menu(database_t& db,
 
         } else if (choice == 3) {
             // Показать расшифрованный пароль (с ожиданием 'q')
-            std::string decrypted = db.get_decrypted_password_(entryId, masterPassword);
+            std::string decrypted = db.get_decrypted_password_(entryId, key);
             if (!decrypted.empty()) {
                 std::cout << "Decrypted password: " << decrypted << "\n";
                 std::cout << "Press 'q' to go back: ";
@@ -146,7 +182,7 @@ static void handle_entry_menu(database_t& db,
 
         } else if (choice == 4) {
             // Копирование пароля в «буфер обмена» (пока заглушка)
-            std::string decrypted = db.get_decrypted_password_(entryId, masterPassword);
+            std::string decrypted = db.get_decrypted_password_(entryId, key);
             if (!decrypted.empty()) {
                 copy_password_to_clipboard(decrypted);
             } else {
@@ -166,7 +202,7 @@ static void handle_entry_menu(database_t& db,
 /**
  * @brief Функция для добавления новой записи (через ввод с консоли).
  */
-static void handle_add_entry(database_t& db, const std::string& masterPassword) {
+static void handle_add_entry(database_t& db, const session_key_t& key) {
     // На случай, если в буфере остался лишний ввод
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
@@ -182,7 +218,7 @@ static void handle_add_entry(database_t& db, const std::string& masterPassword)
     std::cout << "Notes: ";
     std::getline(std::cin, notes);
 
-    bool added = db.add_entry_(title, url, username, password, notes, masterPassword);
+    bool added = db.add_entry_(title, url, username, password, notes, key);
     if (added) {
         std::cout << "Entry added successfully.\n";
     } else {
@@ -196,12 +232,12 @@ static void handle_add_entry(database_t& db, const std::string& masterPassword)
  * @param results Список записей
  * @return ID выбранной записи или 0, если пользователь ввёл 'q' или некорректный индекс
  */
-static int pick_entry_from_list(const std::vector<password_entry_t>& results) {
+static int pick_entry_from_list(const entry_result_set_t& results) {
     // Печатаем «табличный» заголовок:
     print_table_header();
     // Печатаем каждую запись:
     for (size_t i = 0; i < results.size(); ++i) {
-        print_table_row((int)(i + 1), results[i]);
+        print_table_row((int)(i + 1), password_entry_view_t::of_(results[i]));
     }
 
     std::cout << "\nSelect an entry (1-" << results.size()
@@ -229,58 +265,609 @@ static int pick_entry_from_list(const std::vector<password_entry_t>& results) {
     return results[idx].m_id; 
 }
 
+/**
+ * @brief Переводит терминал в посимвольный ввод без эха; восстанавливает
+ *        прежний режим в деструкторе.
+ */
+class raw_terminal_t {
+public:
+    raw_terminal_t() : m_active(false) {
+        if (tcgetattr(STDIN_FILENO, &m_saved) != 0) {
+            return;
+        }
+        termios raw = m_saved;
+        // ISIG тоже выключен: Ctrl-C обрабатывается как отмена поиска
+        raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        m_active = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+    }
+
+    ~raw_terminal_t() {
+        if (m_active) {
+            tcsetattr(STDIN_FILENO, TCSANOW, &m_saved);
+        }
+    }
+
+    raw_terminal_t(const raw_terminal_t&) = delete;
+    raw_terminal_t& operator=(const raw_terminal_t&) = delete;
+
+    bool active_() const { return m_active; }
+
+private:
+    termios m_saved;
+    bool m_active;
+};
+
+/**
+ * @brief Размер терминала (по умолчанию 24x80, если он неизвестен).
+ */
+static void terminal_size(int& rows, int& columns) {
+    winsize size{};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+        rows = size.ws_row;
+        columns = size.ws_col;
+    } else {
+        rows = 24;
+        columns = 80;
+    }
+}
+
+/**
+ * @brief Поле для одной строки экрана: управляющие символы заменены пробелами,
+ *        длина - ровно width (обрезка или дополнение пробелами).
+ */
+static std::string fit_field(std::string_view text, size_t width) {
+    std::string cell(text.substr(0, width));
+    for (char& c : cell) {
+        if (static_cast<unsigned char>(c) < 0x20 || c == 0x7f) {
+            c = ' ';
+        }
+    }
+    cell.resize(width, ' ');
+    return cell;
+}
+
+/**
+ * @brief Одна строка списка поиска при вводе, не шире columns.
+ */
+static std::string format_search_row(const pmr_password_entry_t& entry, int columns) {
+    std::string line = fit_field(std::to_string(entry.m_id), 6) +
+                       fit_field(entry.m_title, 15) +
+                       fit_field(entry.m_url, 20) +
+                       fit_field(entry.m_username, 15);
+    size_t width = static_cast<size_t>(std::max(columns - 1, 1));
+    if (line.size() < width) {
+        line += fit_field(entry.m_notes, width - line.size());
+    }
+    return fit_field(line, width);
+}
+
+/**
+ * @brief Перерисовывает экран поиска при вводе: строку запроса, статус и
+ *        только видимое окно результатов (выбранная строка - инверсией).
+ */
+static void draw_incremental_search(const std::string& query,
+                                    const incremental_search_t::result_t* result,
+                                    bool pending,
+                                    size_t selected,
+                                    size_t firstVisible,
+                                    int visibleRows,
+                                    int columns) {
+    std::string screen = "\x1b[H\x1b[J";
+    screen += "Search: " + query + "\n";
+
+    if (!result) {
+        screen += pending ? "Searching...\n" : "Type to search.\n";
+    } else {
+        screen += std::to_string(result->m_entries.size()) +
+                  (result->m_fuzzy ? " close match(es) for \"" : " match(es) for \"") + result->m_query + "\"";
+        char timing[48];
+        std::snprintf(timing, sizeof(timing), " in %.1f ms%s", result->m_millis,
+                      result->m_refined ? " (refined)" : "");
+        screen += timing;
+        screen += pending ? ", searching...\n" : "\n";
+    }
+
+    screen += fit_field("ID", 6) + fit_field("Title", 15) + fit_field("URL", 20) +
+              fit_field("Username", 15) + "Notes\n";
+
+    if (result) {
+        size_t end = std::min(result->m_entries.size(), firstVisible + static_cast<size_t>(visibleRows));
+        for (size_t i = firstVisible; i < end; ++i) {
+            std::string row = format_search_row(result->m_entries[i], columns);
+            if (i == selected) {
+                screen += "\x1b[7m" + row + "\x1b[0m\n";
+            } else {
+                screen += row + "\n";
+            }
+        }
+    }
+
+    screen += "-- Up/Down: select, Enter: open, Esc: back --";
+    // Курсор - в конец строки запроса
+    screen += "\x1b[1;" + std::to_string(9 + query.size()) + "H";
+    std::cout << screen << std::flush;
+}
+
+/**
+ * @brief Поиск при вводе: запрос уходит в incremental_search_t на каждое
+ *        нажатие, экран перерисовывается по готовности результата.
+ * @return ID выбранной записи, 0 - поиск отменён, -1 - терминал не
+ *         переводится в посимвольный режим
+ */
+static int pick_entry_incremental(database_t& db) {
+    raw_terminal_t terminal;
+    if (!terminal.active_()) {
+        return -1;
+    }
+
+    incremental_search_t search(db);
+    std::string query;
+    std::shared_ptr<const incremental_search_t::result_t> shown;
+    uint64_t submitted = 0;
+    size_t selected = 0;
+    size_t firstVisible = 0;
+    int selectedId = 0;
+    bool done = false;
+    bool dirty = true;
+
+    while (!done) {
+        int rows, columns;
+        terminal_size(rows, columns);
+        int visibleRows = std::max(rows - c_search_chrome_rows, 1);
+
+        // Прокрутка окна так, чтобы выбранная строка была видна
+        size_t count = shown ? shown->m_entries.size() : 0;
+        if (selected >= count) {
+            selected = count ? count - 1 : 0;
+        }
+        if (selected < firstVisible) {
+            firstVisible = selected;
+        } else if (selected >= firstVisible + static_cast<size_t>(visibleRows)) {
+            firstVisible = selected - static_cast<size_t>(visibleRows) + 1;
+        }
+
+        if (dirty) {
+            bool pending = submitted != 0 && (!shown || shown->m_generation != submitted);
+            draw_incremental_search(query, shown.get(), pending, selected, firstVisible, visibleRows, columns);
+            dirty = false;
+        }
+
+        pollfd fds[2] = {{STDIN_FILENO, POLLIN, 0}, {search.notify_fd_(), POLLIN, 0}};
+        int nfds = search.notify_fd_() >= 0 ? 2 : 1;
+        // Без eventfd результаты подхватываются по таймауту
+        if (poll(fds, nfds, nfds == 2 ? -1 : 50) < 0) {
+            continue;
+        }
+
+        if (nfds == 1 || (fds[1].revents & POLLIN)) {
+            if (nfds == 2) {
+                search.consume_notify_();
+            }
+            auto latest = search.latest_();
+            if (latest && latest != shown) {
+                shown = latest;
+                selected = 0;
+                firstVisible = 0;
+                dirty = true;
+            }
+        }
+
+        if (!(fds[0].revents & (POLLIN | POLLHUP))) {
+            continue;
+        }
+
+        char input[64];
+        ssize_t n = read(STDIN_FILENO, input, sizeof(input));
+        if (n <= 0) {
+            break; // ввод закрыт
+        }
+
+        bool changed = false;
+        for (ssize_t i = 0; i < n && !done; ++i) {
+            unsigned char c = static_cast<unsigned char>(input[i]);
+            if (c == 0x1b) {
+                // Стрелки приходят как ESC [ A / ESC [ B; одиночный ESC - выход
+                if (i + 2 < n && input[i + 1] == '[') {
+                    if (input[i + 2] == 'A' && selected > 0) {
+                        --selected;
+                    } else if (input[i + 2] == 'B' && shown && selected + 1 < shown->m_entries.size()) {
+                        ++selected;
+                    }
+                    i += 2;
+                    dirty = true;
+                } else if (i + 1 == n) {
+                    done = true;
+                }
+            } else if (c == 0x03 || c == 0x07) { // Ctrl-C, Ctrl-G
+                done = true;
+            } else if (c == '\r' || c == '\n') {
+                // Выбор - только из результата для текущего запроса
+                if (shown && shown->m_generation == submitted && selected < shown->m_entries.size()) {
+                    selectedId = shown->m_entries[selected].m_id;
+                    done = true;
+                }
+            } else if (c == 0x7f || c == 0x08) {
+                if (!query.empty()) {
+                    // Убираем целиком последний символ UTF-8
+                    do {
+                        query.pop_back();
+                    } while (!query.empty() && (static_cast<unsigned char>(query.back()) & 0xC0) == 0x80);
+                    changed = true;
+                }
+            } else if (c == 0x15) { // Ctrl-U
+                changed = !query.empty();
+                query.clear();
+            } else if (c >= 0x20) {
+                query.push_back(static_cast<char>(c));
+                changed = true;
+            }
+        }
+
+        if (changed) {
+            submitted = search.submit_(query);
+            dirty = true;
+        }
+    }
+
+    std::cout << "\x1b[H\x1b[J" << std::flush;
+    return selectedId;
+}
+
+/**
+ * @brief Ждёт асинхронную операцию, перерисовывая строку состояния с индикатором.
+ *
+ * В терминале Esc или Ctrl-C просит операцию остановиться (если cancellable);
+ * без терминала просто ждёт результата. Операции быстрее c_progress_ms
+ * завершаются без вывода.
+ * @param status Текст строки состояния, запрашивается на каждом кадре
+ */
+template <typename T>
+static T wait_pending(pending_t<T>& op, const std::function<std::string()>& status, bool cancellable) {
+    if (!isatty(STDOUT_FILENO) || op.wait_for_(std::chrono::milliseconds(c_progress_ms))) {
+        return op.get_();
+    }
+
+    std::unique_ptr<raw_terminal_t> terminal;
+    if (cancellable && isatty(STDIN_FILENO)) {
+        terminal = std::make_unique<raw_terminal_t>();
+    }
+    bool watchInput = terminal && terminal->active_();
+
+    static const char c_spinner[] = "|/-\\";
+    size_t frame = 0;
+    do {
+        std::cout << "\r\x1b[K" << c_spinner[frame++ % 4] << ' ' << status();
+        if (op.cancelled_()) {
+            std::cout << "  (cancelling...)";
+        } else if (watchInput) {
+            std::cout << "  (Esc to cancel)";
+        }
+        std::cout << std::flush;
+
+        if (!watchInput) {
+            continue; // ждёт wait_for_ в условии цикла
+        }
+        pollfd fd{STDIN_FILENO, POLLIN, 0};
+        if (poll(&fd, 1, c_progress_ms) <= 0) {
+            continue;
+        }
+        char input[64];
+        ssize_t n = read(STDIN_FILENO, input, sizeof(input));
+        if (n <= 0) {
+            watchInput = false; // ввод закрыт
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            if (input[i] == 0x1b || input[i] == 0x03) {
+                op.cancel_();
+            }
+        }
+    } while (!op.wait_for_(std::chrono::milliseconds(watchInput ? 0 : c_progress_ms)));
+
+    std::cout << "\r\x1b[K" << std::flush;
+    return op.get_();
+}
+
 /**
  * @brief Обработчик пункта "Search Entry" главного меню.
+ *        В терминале - поиск при вводе, иначе - запрос одной строкой.
  */
-static void handle_search(database_t& db, const std::string& masterPassword) {
+static void handle_search(database_t& db, async_database_t& async, const session_key_t& key) {
     // Очистим буфер
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
+    if (isatty(STDIN_FILENO) && isatty(STDOUT_FILENO)) {
+        int entryId = pick_entry_incremental(db);
+        if (entryId > 0) {
+            handle_entry_menu(db, key, entryId);
+        }
+        if (entryId >= 0) {
+            return;
+        }
+        // Терминал не удалось перевести в посимвольный режим - обычный поиск
+    }
+
     std::cout << "Enter search query: ";
     std::string query;
     std::getline(std::cin, query);
 
-    // Запрашиваем все подходящие записи
-    auto results = db.search_entries_(query, masterPassword);
-    if (results.empty()) {
+    // Лучшие совпадения, в том числе с опечатками (в арене, освобождается разом)
+    auto search = async.search_ranked_(query, c_search_limit);
+    std::shared_ptr<const entry_result_set_t> results = wait_pending(search, [] {
+        return std::string("Searching...");
+    }, true);
+    if (!results) {
+        std::cout << (search.cancelled_() ? "Search cancelled.\n" : "Search failed.\n");
+        return;
+    }
+    if (results->empty()) {
         std::cout << "No entries found.\n";
         return;
     }
 
     // Даём пользователю выбрать
-    int entryId = pick_entry_from_list(results);
+    int entryId = pick_entry_from_list(*results);
     if (entryId != 0) {
         // Если выбрана конкретная запись - открываем меню записи
-        handle_entry_menu(db, masterPassword, entryId);
+        handle_entry_menu(db, key, entryId);
     }
 }
 
 /**
- * @brief Показывает все записи из базы (аналогично "search" с пустым запросом).
+ * @brief Постраничный вывод записей курсора и выбор одной записи
+ *        (номер на странице, 'n' - следующая страница, 'q' - назад).
+ *        Строки печатаются прямо из буферов SQLite; хранятся только ID страницы.
+ * @return ID выбранной записи или 0
  */
-static void handle_view_all(database_t& db, const std::string& masterPassword) {
-    auto results = db.search_entries_("", masterPassword);
-    if (results.empty()) {
+static int pick_entry_paged(entry_cursor_t& cursor) {
+    std::vector<int> pageIds;
+    pageIds.reserve(c_page_size);
+    int pageNumber = 0;
+
+    auto show_next_page = [&]() {
+        std::vector<int> ids;
+        ids.reserve(c_page_size);
+        bool headerPrinted = false;
+        cursor.next_page_([&](const password_entry_view_t& view) {
+            if (!headerPrinted) {
+                std::cout << "\nPage " << (pageNumber + 1);
+                print_table_header();
+                headerPrinted = true;
+            }
+            ids.push_back(view.m_id);
+            print_table_row((int)ids.size(), view);
+        });
+        if (ids.empty()) {
+            return false;
+        }
+        pageIds.swap(ids);
+        ++pageNumber;
+        return true;
+    };
+
+    if (!show_next_page()) {
         std::cout << "Database is empty.\n";
-        return;
+        return 0;
+    }
+
+    while (true) {
+        bool hasMore = !cursor.finished_();
+        std::cout << "\nSelect an entry (1-" << pageIds.size() << ")"
+                  << (hasMore ? ", 'n' for next page" : "")
+                  << " or 'q' to go back: ";
+        std::string input;
+        std::cin >> input;
+        if (input == "q" || input == "Q") {
+            return 0;
+        }
+
+        if (input == "n" || input == "N") {
+            if (!hasMore || !show_next_page()) {
+                std::cout << "No more entries.\n";
+            }
+            continue;
+        }
+
+        int idx;
+        try {
+            idx = std::stoi(input);
+        } catch (...) {
+            std::cout << "Invalid input!\n";
+            return 0;
+        }
+        idx -= 1;
+        if (idx < 0 || idx >= (int)pageIds.size()) {
+            std::cout << "Invalid choice!\n";
+            return 0;
+        }
+        return pageIds[idx];
     }
+}
 
-    int entryId = pick_entry_from_list(results);
+/**
+ * @brief Показывает все записи из базы постранично: в памяти только текущая страница.
+ */
+static void handle_view_all(database_t& db, const session_key_t& key) {
+    entry_cursor_t cursor(db, "", c_page_size);
+
+    int entryId = pick_entry_paged(cursor);
     if (entryId != 0) {
-        handle_entry_menu(db, masterPassword, entryId);
+        handle_entry_menu(db, key, entryId);
+    }
+}
+
+/**
+ * @brief Импорт записей из CSV- или JSON-файла (формат определяется по расширению).
+ */
+static void handle_import(database_t& db, const session_key_t& key) {
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    std::cout << "Path to CSV or JSON file: ";
+    std::string path;
+    std::getline(std::cin, path);
+
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        std::cout << "Could not open file: " << path << "\n";
+        return;
+    }
+
+    bool isJson = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    auto reader = make_entry_reader(input, isJson ? import_format_t::json : import_format_t::csv);
+
+    import_result_t result = db.import_entries_(*reader, key);
+    std::cout << "Imported " << result.m_imported << " entries";
+    if (result.m_failed > 0) {
+        std::cout << " (" << result.m_failed << " failed)";
+    }
+    std::ostringstream timing;
+    timing << std::fixed << std::setprecision(3) << result.m_seconds << " s, "
+           << std::setprecision(0) << result.m_rowsPerSecond << " rows/s";
+    std::cout << " in " << timing.str() << ".\n";
+    if (!result.m_ok) {
+        std::cout << "Import stopped: " << result.m_error << "\n";
+    }
+}
+
+/**
+ * @brief Смена мастер-пароля: перешифровывает хранилище и заменяет ключ сессии.
+ *        Отменённая или сорвавшаяся смена откатывается, чтобы всё хранилище
+ *        снова было под ключом сессии.
+ * @return false, если откат не удался и с одним ключом сессии работать нельзя
+ */
+static bool handle_change_master_password(database_t& db, async_database_t& async, session_key_t& key) {
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    std::string password;
+
+    kdf_params_t currentParams;
+    if (!db.load_kdf_params_(currentParams)) {
+        currentParams = kdf_params_t::legacy_();
+    }
+
+    std::cout << "Current master password: ";
+    std::getline(std::cin, password);
+    auto oldDerivation = async.derive_key_(std::move(password), currentParams);
+    session_key_t oldKey = wait_pending(oldDerivation, [] { return std::string("Checking password..."); }, false);
+    if (!oldKey.equals_(key)) {
+        std::cout << "Wrong master password.\n";
+        return true;
+    }
+
+    std::string confirm;
+    std::cout << "New master password: ";
+    std::getline(std::cin, password);
+    std::cout << "Repeat new master password: ";
+    std::getline(std::cin, confirm);
+    bool same = (password == confirm);
+
+    // Новая соль при каждой смене; прерванная смена продолжается с её параметрами,
+    // старая схема PBKDF2-SHA1 заменяется на scrypt
+    kdf_params_t newParams;
+    if (!(db.rekey_in_progress_() && db.load_kdf_params_(newParams, true))) {
+        if (currentParams.m_algorithm == kdf_algorithm_t::pbkdf2_sha1_legacy) {
+            auto calibration = async.submit_([](database_t&, const std::atomic<bool>&) {
+                return calibrate_kdf(kdf_algorithm_t::scrypt, std::chrono::milliseconds(c_unlock_ms), 256);
+            });
+            newParams = wait_pending(calibration, [] { return std::string("Calibrating key derivation..."); },
+                                     false);
+        } else {
+            newParams = currentParams.with_new_salt_();
+        }
+    }
+
+    std::fill(confirm.begin(), confirm.end(), '\0');
+    session_key_t newKey;
+    if (same && !password.empty()) {
+        auto newDerivation = async.derive_key_(std::move(password), newParams);
+        newKey = wait_pending(newDerivation, [] { return std::string("Deriving new key..."); }, false);
+    }
+    std::fill(password.begin(), password.end(), '\0');
+    if (!same || newKey.empty()) {
+        std::cout << "Passwords do not match or are empty.\n";
+        return true;
+    }
+
+    // Прогресс приходит из потока исполнителя, строка рисуется здесь
+    std::atomic<size_t> processed(0), total(0);
+    auto rekey = async.rekey_(key, newKey, 1000, [&](const rekey_progress_t& progress) {
+        processed = progress.m_processed;
+        total = progress.m_total;
+    }, &newParams);
+    bool ok = wait_pending(rekey, [&] {
+        return "Re-encrypted " + std::to_string(processed) + "/" + std::to_string(total);
+    }, true);
+    std::cout << "Re-encrypted " << processed << " entries.\n";
+
+    if (ok) {
+        key = std::move(newKey);
+        std::cout << "Master password changed.\n";
+        return true;
+    }
+
+    // Часть записей уже под новым ключом: возвращаем их старому, иначе сессия
+    // (и поиск, и добавление) работала бы с наполовину перешифрованным хранилищем
+    bool cancelled = rekey.cancelled_();
+    processed = 0;
+    total = 0;
+    auto rollback = async.rollback_rekey_(key, newKey, 1000, [&](const rekey_progress_t& progress) {
+        processed = progress.m_processed;
+        total = progress.m_total;
+    });
+    bool restored = wait_pending(rollback, [&] {
+        return "Restoring " + std::to_string(processed) + "/" + std::to_string(total);
+    }, false);
+    if (!restored) {
+        std::cout << "The vault is only partly re-encrypted with the new master password.\n"
+                  << "Restart passman and enter the new master password to finish the change.\n";
+        return false;
+    }
+    std::cout << (cancelled ? "Master password change cancelled." : "Failed to change master password.")
+              << " The old master password is still in use.\n";
+    return true;
+}
+
+/**
+ * @brief Обработчик пункта "Metrics": сводка замеров и выгрузка в файл.
+ */
+static void handle_metrics() {
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    std::cout << "\n=== Metrics ===\n" << metrics_t::summary_();
+    if (!metrics_t::enabled_()) {
+        return;
+    }
+
+    std::cout << "\nExport to file (*.json - JSON, otherwise Prometheus text; empty to skip): ";
+    std::string path;
+    std::getline(std::cin, path);
+    if (path.empty()) {
+        return;
+    }
+    if (metrics_t::export_(path)) {
+        std::cout << "Metrics written to " << path << "\n";
+    } else {
+        std::cout << "Failed to export metrics.\n";
     }
 }
 
 /**
  * @brief Основное меню TUI.
  */
-void start_tui(database_t& db, const std::string& masterPassword) {
+void start_tui(database_t& db, session_key_t& key) {
+    // Долгие операции (поиск, вывод ключа, смена мастер-пароля) идут в исполнителе
+    async_database_t async(db);
+
     while (true) {
         std::cout << "\n=== Main Menu ===\n"
                   << "1) Add Entry\n"
                   << "2) Search Entry\n"
                   << "3) View All Entries\n"
-                  << "4) Exit\n"
+                  << "4) Import Entries\n"
+                  << "5) Change Master Password\n"
+                  << "6) Metrics\n"
+                  << "7) Exit\n"
                   << "Choose: ";
 
         int choice;
@@ -294,15 +881,26 @@ void start_tui(database_t& db, const std::string& masterPassword) {
 
         switch (choice) {
         case 1:
-            handle_add_entry(db, masterPassword);
+            handle_add_entry(db, key);
             break;
         case 2:
-            handle_search(db, masterPassword);
+            handle_search(db, async, key);
             break;
         case 3:
-            handle_view_all(db, masterPassword);
+            handle_view_all(db, key);
             break;
         case 4:
+            handle_import(db, key);
+            break;
+        case 5:
+            if (!handle_change_master_password(db, async, key)) {
+                return;
+            }
+            break;
+        case 6:
+            handle_metrics();
+            break;
+        case 7:
             std::cout << "Exiting...\n";
             return;
         default:
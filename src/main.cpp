@@ -1,17 +1,217 @@
 #include "database/database.h"
 #include "interface/tui.h"
+#include "daemon/daemon.h"
+#include "metrics/metrics.h"
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
 
-int main() {
-    database_t db;
+static const size_t c_entry_cache_size = 1024;
+static const int c_default_unlock_ms = 250;
+
+static void print_usage() {
+    std::cerr << "Usage: passman [vault.db] [--daemon <socket>]\n"
+              << "               [--kdf scrypt|pbkdf2-sha256] [--unlock-ms N] [--kdf-lanes N]\n"
+              << "       passman [vault.db] --export-snapshot <file>\n"
+              << "       passman --snapshot <file> [--daemon <socket>]\n"
+              << "  --metrics-out <file> writes metrics on exit (*.json - JSON, otherwise Prometheus text)\n"
+              << "  --kdf, --unlock-ms and --kdf-lanes apply when a new vault is created;\n"
+              << "  lanes default to the number of cores (scrypt uses fewer if memory runs out)\n"
+              << "  --snapshot opens an exported snapshot read-only\n";
+}
+
+// В хранилище старого формата нечем проверить мастер-пароль: перед переводом в GCM
+// пользователь подтверждает его по расшифрованному паролю первой записи, и
+// подтверждённый ключ записывается в заголовок как контрольное значение
+static bool confirm_legacy_key(database_t& db, const session_key_t& key) {
+    int firstId = 0;
+    std::string title;
+    db.visit_page_("", 0, 1, [&](const password_entry_view_t& view) {
+        firstId = view.m_id;
+        title.assign(view.m_title.data(), view.m_title.size());
+    });
+    std::string password = firstId > 0 ? db.get_decrypted_password_(firstId, key) : std::string();
+    if (password.empty()) {
+        std::cerr << "The entries cannot be decrypted with this master password.\n";
+        return false;
+    }
+
+    std::cout << "The master password cannot be verified automatically.\n"
+              << "The password of \"" << title << "\" decrypts as: " << password << "\n"
+              << "Is this correct? (y/n): ";
+    std::fill(password.begin(), password.end(), '\0');
+    std::string answer;
+    std::getline(std::cin, answer);
+    if (answer != "y" && answer != "Y") {
+        return false;
+    }
+
+    kdf_params_t stored;
+    if (!db.load_kdf_params_(stored) && !db.store_kdf_params_(kdf_params_t::legacy_())) {
+        return false;
+    }
+    return db.store_key_check_(key);
+}
+
+int main(int argc, char** argv) {
+    // Аргументы: [путь к файлу хранилища] [--daemon <сокет>] [--kdf ...] [--unlock-ms N] [--kdf-lanes N]
+    //            [--export-snapshot <файл>] [--snapshot <файл>] [--metrics-out <файл>]
+    storage_profile_t profile;
+    std::string socketPath;
+    std::string exportPath;
+    std::string metricsPath;
+    kdf_algorithm_t kdfAlgorithm = kdf_algorithm_t::scrypt;
+    int unlockMs = c_default_unlock_ms;
+    uint32_t kdfLanes = default_kdf_lanes();
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--daemon" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--kdf" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "scrypt") {
+                kdfAlgorithm = kdf_algorithm_t::scrypt;
+            } else if (name == "pbkdf2-sha256") {
+                kdfAlgorithm = kdf_algorithm_t::pbkdf2_sha256;
+            } else {
+                print_usage();
+                return 1;
+            }
+        } else if (arg == "--unlock-ms" && i + 1 < argc) {
+            unlockMs = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--kdf-lanes" && i + 1 < argc) {
+            kdfLanes = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+        } else if (arg == "--export-snapshot" && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (arg == "--metrics-out" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            profile = storage_profile_t::snapshot_(argv[++i]);
+        } else if (arg.rfind("--", 0) != 0) {
+            profile.m_path = arg;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    database_t db(profile);
     db.init_database_();
+    db.enable_cache_(c_entry_cache_size); // только метаданные, пароли не кешируются
+
+    // Экспорт снимка не требует ключа: пароли копируются зашифрованными
+    if (!exportPath.empty()) {
+        if (!db.export_snapshot_(exportPath)) {
+            std::cerr << "Failed to export the snapshot.\n";
+            return 1;
+        }
+        std::cout << "Snapshot written to " << exportPath << "\n";
+        return 0;
+    }
+
+    // Параметры KDF из заголовка; новое хранилище получает соль и стоимость,
+    // подобранную под время разблокировки на этой машине
+    kdf_params_t kdfParams;
+    if (!db.load_kdf_params_(kdfParams)) {
+        if (db.read_only_()) {
+            std::cerr << "Failed to open the snapshot.\n";
+            return 1;
+        }
+        if (db.has_entries_()) {
+            kdfParams = kdf_params_t::legacy_();
+        } else {
+            std::cout << "Creating a new vault, calibrating key derivation...\n";
+            kdfParams = calibrate_kdf(kdfAlgorithm, std::chrono::milliseconds(unlockMs), 256, kdfLanes);
+            if (!db.store_kdf_params_(kdfParams)) {
+                std::cerr << "Failed to write the vault header.\n";
+                return 1;
+            }
+            std::cout << "Key derivation: " << kdfParams.describe_() << "\n";
+        }
+    }
 
     std::string masterPassword;
     std::cout << "Enter Master Password: ";
     std::getline(std::cin, masterPassword);
 
-    // Запускаем TUI
-    start_tui(db, masterPassword);
+    // Производим ключ один раз на всю сессию, сам пароль больше не храним
+    session_key_t key = session_key_t::derive_(masterPassword, kdfParams);
+    std::fill(masterPassword.begin(), masterPassword.end(), '\0');
+    if (key.empty()) {
+        std::cerr << "Failed to unlock the vault.\n";
+        return 1;
+    }
+
+    // Контрольное значение в заголовке отсекает неверный пароль сразу; новое
+    // хранилище получает его от первого введённого пароля
+    key_check_t keyCheck = db.verify_key_(key);
+    if (keyCheck == key_check_t::mismatch) {
+        std::cerr << "Wrong master password.\n";
+        return 1;
+    }
+    if (keyCheck == key_check_t::unknown && !db.read_only_() && !db.has_entries_()) {
+        db.store_key_check_(key);
+    }
+
+    // Прерванная смена мастер-пароля: введённый пароль считается старым,
+    // доводим перешифровку до конца, прежде чем открывать хранилище
+    if (db.rekey_in_progress_()) {
+        std::cout << "An interrupted master password change was found.\n"
+                  << "Enter the NEW master password to resume it: ";
+        std::getline(std::cin, masterPassword);
+
+        // Новый ключ - с параметрами, записанными прерванной сменой (если она их меняла)
+        kdf_params_t newParams = kdfParams;
+        db.load_kdf_params_(newParams, true);
+        session_key_t newKey = session_key_t::derive_(masterPassword, newParams);
+        std::fill(masterPassword.begin(), masterPassword.end(), '\0');
+
+        if (newKey.empty() || !db.rekey_(key, newKey)) {
+            std::cerr << "Failed to resume the master password change.\n";
+            return 1;
+        }
+        key = std::move(newKey);
+        std::cout << "Master password change completed.\n";
+    }
+
+    // Пароли старого формата (AES-128-CBC) переводим в AES-256-GCM по согласию пользователя
+    size_t legacyCount = db.read_only_() ? 0 : db.legacy_entry_count_();
+    if (legacyCount > 0) {
+        std::cout << legacyCount << " entries use the old AES-128-CBC format.\n"
+                  << "Upgrade them to AES-256-GCM now? (y/n): ";
+        std::string answer;
+        std::getline(std::cin, answer);
+        if (answer == "y" || answer == "Y") {
+            bool verified = db.verify_key_(key) == key_check_t::match || confirm_legacy_key(db, key);
+            if (!verified) {
+                std::cerr << "The master password is not verified; entries are left unchanged.\n";
+            } else if (db.migrate_cipher_(key)) {
+                std::cout << "Upgrade completed.\n";
+            } else {
+                std::cerr << "Upgrade failed; entries are left unchanged.\n";
+            }
+        }
+    }
+
+    // Режим демона: хранилище остаётся разблокированным и обслуживает запросы по сокету
+    if (!socketPath.empty()) {
+        daemon_t daemon(db, key, socketPath);
+        bool ok = daemon.run_();
+        if (!metricsPath.empty()) {
+            metrics_t::export_(metricsPath);
+        }
+        return ok ? 0 : 1;
+    }
+
+    // Запускаем TUI; поиск при вводе идёт по колоночному хранилищу в памяти
+    if (!db.load_column_store_()) {
+        std::cerr << "Failed to load entries into memory, searching in SQLite.\n";
+    }
+    start_tui(db, key);
+
+    if (!metricsPath.empty() && !metrics_t::export_(metricsPath)) {
+        return 1;
+    }
 
     return 0;
 }
@@ -0,0 +1,257 @@
+#include "metrics/metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+struct atomic_histogram_t {
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_sumNanos{0};
+    std::atomic<uint64_t> m_maxNanos{0};
+    std::atomic<uint64_t> m_buckets[metrics_t::c_buckets] = {};
+};
+
+atomic_histogram_t g_histograms[c_op_count];
+std::atomic<uint64_t> g_counters[c_counter_count] = {};
+
+const char* const c_op_names[c_op_count] = {
+    "derive_key", "kdf", "encrypt", "decrypt", "sql_prepare", "sql_step", "sql_exec",
+};
+
+const char* const c_counter_names[c_counter_count] = {
+    "bytes_encrypted", "bytes_decrypted", "decrypt_failures", "sqlite_cache_hits", "sqlite_cache_misses",
+};
+
+int bucket_of(uint64_t nanos) {
+    if (nanos == 0) {
+        return 0;
+    }
+    int bucket = 63 - __builtin_clzll(nanos);
+    return std::min(bucket, metrics_t::c_buckets - 1);
+}
+
+/**
+ * @brief Верхняя граница корзины в наносекундах.
+ */
+double bucket_upper(int bucket) {
+    return static_cast<double>(uint64_t(1) << (bucket + 1));
+}
+
+std::string format_nanos(double nanos) {
+    char buffer[32];
+    if (nanos < 1e3) {
+        std::snprintf(buffer, sizeof(buffer), "%.0f ns", nanos);
+    } else if (nanos < 1e6) {
+        std::snprintf(buffer, sizeof(buffer), "%.1f us", nanos / 1e3);
+    } else if (nanos < 1e9) {
+        std::snprintf(buffer, sizeof(buffer), "%.1f ms", nanos / 1e6);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%.2f s", nanos / 1e9);
+    }
+    return buffer;
+}
+
+} // namespace
+
+double metrics_t::histogram_t::quantile_(double q) const {
+    if (m_count == 0) {
+        return 0.0;
+    }
+    double rank = q * static_cast<double>(m_count);
+    uint64_t seen = 0;
+    for (int i = 0; i < c_buckets; ++i) {
+        if (m_buckets[i] == 0) {
+            continue;
+        }
+        if (static_cast<double>(seen + m_buckets[i]) >= rank) {
+            double lower = i == 0 ? 0.0 : static_cast<double>(uint64_t(1) << i);
+            double fraction = (rank - static_cast<double>(seen)) / static_cast<double>(m_buckets[i]);
+            return std::min(lower + fraction * (bucket_upper(i) - lower), static_cast<double>(m_maxNanos));
+        }
+        seen += m_buckets[i];
+    }
+    return static_cast<double>(m_maxNanos);
+}
+
+void metrics_t::record_(metric_op_t op, uint64_t nanos) {
+    atomic_histogram_t& histogram = g_histograms[op];
+    histogram.m_count.fetch_add(1, std::memory_order_relaxed);
+    histogram.m_sumNanos.fetch_add(nanos, std::memory_order_relaxed);
+    histogram.m_buckets[bucket_of(nanos)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = histogram.m_maxNanos.load(std::memory_order_relaxed);
+    while (nanos > max && !histogram.m_maxNanos.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {
+    }
+}
+
+void metrics_t::add_(metric_counter_t counter, uint64_t value) {
+    g_counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+metrics_t::histogram_t metrics_t::histogram_(metric_op_t op) {
+    const atomic_histogram_t& source = g_histograms[op];
+    histogram_t histogram{};
+    histogram.m_count = source.m_count.load(std::memory_order_relaxed);
+    histogram.m_sumNanos = source.m_sumNanos.load(std::memory_order_relaxed);
+    histogram.m_maxNanos = source.m_maxNanos.load(std::memory_order_relaxed);
+    for (int i = 0; i < c_buckets; ++i) {
+        histogram.m_buckets[i] = source.m_buckets[i].load(std::memory_order_relaxed);
+    }
+    return histogram;
+}
+
+uint64_t metrics_t::counter_(metric_counter_t counter) {
+    return g_counters[counter].load(std::memory_order_relaxed);
+}
+
+void metrics_t::reset_() {
+    for (atomic_histogram_t& histogram : g_histograms) {
+        histogram.m_count = 0;
+        histogram.m_sumNanos = 0;
+        histogram.m_maxNanos = 0;
+        for (auto& bucket : histogram.m_buckets) {
+            bucket = 0;
+        }
+    }
+    for (auto& counter : g_counters) {
+        counter = 0;
+    }
+}
+
+const char* metrics_t::op_name_(metric_op_t op) {
+    return c_op_names[op];
+}
+
+const char* metrics_t::counter_name_(metric_counter_t counter) {
+    return c_counter_names[counter];
+}
+
+bool metrics_t::enabled_() {
+#ifdef PASSMAN_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::string metrics_t::summary_() {
+    if (!enabled_()) {
+        return "Metrics are compiled out (configure with -DPASSMAN_METRICS=ON).\n";
+    }
+
+    std::ostringstream out;
+    char line[160];
+    std::snprintf(line, sizeof(line), "%-12s %10s %10s %10s %10s %10s\n", "Operation", "Count", "Avg", "p50", "p99", "Max");
+    out << line << std::string(67, '-') << "\n";
+    for (int op = 0; op < c_op_count; ++op) {
+        histogram_t histogram = histogram_(static_cast<metric_op_t>(op));
+        if (histogram.m_count == 0) {
+            std::snprintf(line, sizeof(line), "%-12s %10s\n", c_op_names[op], "0");
+        } else {
+            double average = static_cast<double>(histogram.m_sumNanos) / static_cast<double>(histogram.m_count);
+            std::snprintf(line, sizeof(line), "%-12s %10llu %10s %10s %10s %10s\n", c_op_names[op],
+                          static_cast<unsigned long long>(histogram.m_count), format_nanos(average).c_str(),
+                          format_nanos(histogram.quantile_(0.5)).c_str(),
+                          format_nanos(histogram.quantile_(0.99)).c_str(),
+                          format_nanos(static_cast<double>(histogram.m_maxNanos)).c_str());
+        }
+        out << line;
+    }
+    out << "\n";
+    for (int counter = 0; counter < c_counter_count; ++counter) {
+        std::snprintf(line, sizeof(line), "%-20s %llu\n", c_counter_names[counter],
+                      static_cast<unsigned long long>(counter_(static_cast<metric_counter_t>(counter))));
+        out << line;
+    }
+    return out.str();
+}
+
+std::string metrics_t::to_json_() {
+    std::ostringstream out;
+    out << "{\n  \"enabled\": " << (enabled_() ? "true" : "false") << ",\n  \"operations\": {";
+    for (int op = 0; op < c_op_count; ++op) {
+        histogram_t histogram = histogram_(static_cast<metric_op_t>(op));
+        out << (op ? ",\n" : "\n") << "    \"" << c_op_names[op] << "\": {\"count\": " << histogram.m_count
+            << ", \"sum_ns\": " << histogram.m_sumNanos << ", \"max_ns\": " << histogram.m_maxNanos
+            << ", \"p50_ns\": " << static_cast<uint64_t>(histogram.quantile_(0.5))
+            << ", \"p99_ns\": " << static_cast<uint64_t>(histogram.quantile_(0.99))
+            << ", \"buckets\": [";
+        // Корзина i: [2^i, 2^(i+1)) нс; хвост из нулей не выводится
+        int last = c_buckets - 1;
+        while (last >= 0 && histogram.m_buckets[last] == 0) {
+            --last;
+        }
+        for (int i = 0; i <= last; ++i) {
+            out << (i ? ", " : "") << histogram.m_buckets[i];
+        }
+        out << "]}";
+    }
+    out << "\n  },\n  \"counters\": {";
+    for (int counter = 0; counter < c_counter_count; ++counter) {
+        out << (counter ? ",\n" : "\n") << "    \"" << c_counter_names[counter]
+            << "\": " << counter_(static_cast<metric_counter_t>(counter));
+    }
+    out << "\n  }\n}\n";
+    return out.str();
+}
+
+std::string metrics_t::to_prometheus_() {
+    std::ostringstream out;
+    out << "# HELP passman_operation_seconds Latency of instrumented operations.\n"
+        << "# TYPE passman_operation_seconds histogram\n";
+    for (int op = 0; op < c_op_count; ++op) {
+        histogram_t histogram = histogram_(static_cast<metric_op_t>(op));
+        uint64_t cumulative = 0;
+        for (int i = 0; i < c_buckets; ++i) {
+            cumulative += histogram.m_buckets[i];
+            out << "passman_operation_seconds_bucket{op=\"" << c_op_names[op] << "\",le=\""
+                << bucket_upper(i) / 1e9 << "\"} " << cumulative << "\n";
+        }
+        out << "passman_operation_seconds_bucket{op=\"" << c_op_names[op] << "\",le=\"+Inf\"} "
+            << histogram.m_count << "\n"
+            << "passman_operation_seconds_sum{op=\"" << c_op_names[op] << "\"} "
+            << static_cast<double>(histogram.m_sumNanos) / 1e9 << "\n"
+            << "passman_operation_seconds_count{op=\"" << c_op_names[op] << "\"} " << histogram.m_count << "\n";
+    }
+    for (int counter = 0; counter < c_counter_count; ++counter) {
+        out << "# TYPE passman_" << c_counter_names[counter] << "_total counter\n"
+            << "passman_" << c_counter_names[counter] << "_total "
+            << counter_(static_cast<metric_counter_t>(counter)) << "\n";
+    }
+    return out.str();
+}
+
+bool metrics_t::export_(const std::string& path) {
+    if (!enabled_()) {
+        std::cerr << "Error: metrics are compiled out, nothing to export" << std::endl;
+        return false;
+    }
+
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Error creating " << tmpPath << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        file << (json ? to_json_() : to_prometheus_());
+        if (!file.flush()) {
+            std::cerr << "Error writing " << tmpPath << std::endl;
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error renaming " << tmpPath << ": " << std::strerror(errno) << std::endl;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
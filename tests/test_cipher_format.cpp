@@ -0,0 +1,222 @@
+#include "database/database.h"
+#include "encryption/encryption.h"
+#include "test_util.h"
+#include <openssl/evp.h>
+#include <sqlite3.h>
+
+namespace {
+
+const int c_wrong_keys = 512; // CBC-дополнение с неверным ключом сходится ~1/256
+
+/**
+ * @brief Блок старого формата: AES-128-CBC, первые 16 байт ключа - ключ, последние 16 - IV.
+ */
+std::vector<unsigned char> legacy_cbc(const std::string& plaintext, const session_key_t& key) {
+    std::vector<unsigned char> out(plaintext.size() + 16);
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int len = 0, total = 0;
+    EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), nullptr, key.data(), key.data() + 16);
+    EVP_EncryptUpdate(ctx, out.data(), &len, reinterpret_cast<const unsigned char*>(plaintext.data()),
+                      static_cast<int>(plaintext.size()));
+    total = len;
+    EVP_EncryptFinal_ex(ctx, out.data() + total, &len);
+    total += len;
+    EVP_CIPHER_CTX_free(ctx);
+    out.resize(total);
+    return out;
+}
+
+/**
+ * @brief Записывает блок в обход database_t (как оставила бы старая версия).
+ */
+bool store_raw_password(const std::string& path, int id, const std::vector<unsigned char>& blob) {
+    sqlite3* handle = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+    bool ok = sqlite3_open(path.c_str(), &handle) == SQLITE_OK &&
+              sqlite3_prepare_v2(handle, "UPDATE passwords SET password = ? WHERE id = ?;", -1, &stmt,
+                                 nullptr) == SQLITE_OK;
+    if (ok) {
+        sqlite3_bind_blob(stmt, 1, blob.data(), static_cast<int>(blob.size()), SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, id);
+        ok = sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(handle) == 1;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(handle);
+    return ok;
+}
+
+bool decrypts(encryption_t& encryption, cipher_context_t& ctx, const std::vector<unsigned char>& blob,
+              const session_key_t& key, std::string& plaintext, bool& authenticated) {
+    return encryption.decrypt_checked_(ctx, blob.data(), blob.size(), key, plaintext, &authenticated);
+}
+
+void check_gcm(encryption_t& encryption, const session_key_t& key) {
+    cipher_context_t ctx;
+    std::string plaintext;
+    bool authenticated = false;
+
+    // 3 байта текста - блок в 32 байта, кратный блоку AES: откат на CBC был бы возможен
+    std::vector<unsigned char> blob = encryption.encrypt_aes_(ctx, "pin", key);
+    CHECK(blob.size() == encryption_t::encrypted_size_(3) && blob.size() % 16 == 0);
+    CHECK(blob[0] == encryption_t::c_format_gcm);
+    CHECK(decrypts(encryption, ctx, blob, key, plaintext, authenticated));
+    CHECK(authenticated && plaintext == "pin");
+
+    // Испорченный тег - ошибка без отката на CBC
+    std::vector<unsigned char> tampered = blob;
+    tampered.back() ^= 1;
+    CHECK(!decrypts(encryption, ctx, tampered, key, plaintext, authenticated));
+    CHECK(!authenticated && plaintext.empty());
+
+    // Ни один неверный ключ не "расшифровывает" блок GCM
+    int accepted = 0;
+    for (int i = 0; i < c_wrong_keys; ++i) {
+        session_key_t wrong = test_key("wrong " + std::to_string(i));
+        if (decrypts(encryption, ctx, blob, wrong, plaintext, authenticated) || authenticated) {
+            ++accepted;
+        }
+    }
+    CHECK(accepted == 0);
+}
+
+void check_legacy_cbc(encryption_t& encryption, const session_key_t& key) {
+    cipher_context_t ctx;
+    std::string plaintext;
+    bool authenticated = true;
+
+    // Старый формат читается, но ключ им не подтверждается
+    std::vector<unsigned char> blob = legacy_cbc("legacy secret", key);
+    CHECK(blob[0] != encryption_t::c_format_gcm);
+    CHECK(decrypts(encryption, ctx, blob, key, plaintext, authenticated));
+    CHECK(!authenticated && plaintext == "legacy secret");
+
+    // Неверный ключ иногда проходит дополнение CBC, но никогда - как аутентифицированный
+    int authenticatedByWrongKey = 0;
+    for (int i = 0; i < c_wrong_keys; ++i) {
+        session_key_t wrong = test_key("wrong " + std::to_string(i));
+        decrypts(encryption, ctx, blob, wrong, plaintext, authenticated);
+        authenticatedByWrongKey += authenticated ? 1 : 0;
+    }
+    CHECK(authenticatedByWrongKey == 0);
+
+    // Блок CBC, случайно начавшийся с 0x02, считается GCM и не расшифровывается
+    std::vector<unsigned char> lookalike;
+    for (int i = 0; lookalike.empty() && i < 100000; ++i) {
+        std::vector<unsigned char> candidate = legacy_cbc("value " + std::to_string(i), key);
+        if (candidate[0] == encryption_t::c_format_gcm) {
+            lookalike = candidate;
+        }
+    }
+    CHECK(!lookalike.empty());
+    if (!lookalike.empty()) {
+        CHECK(!decrypts(encryption, ctx, lookalike, key, plaintext, authenticated));
+    }
+}
+
+void check_rekey_requires_gcm(const session_key_t& key) {
+    temp_file_t vault("cipher_format.db");
+    session_key_t next = test_key("next");
+    {
+        database_t db(storage_profile_t::tuned_(vault.path_()));
+        db.init_database_();
+        CHECK(db.add_entry_("gcm", "", "", "one", "", key));
+        CHECK(db.add_entry_("cbc", "", "", "placeholder", "", key));
+    }
+
+    std::vector<unsigned char> blob = legacy_cbc("two", key);
+    CHECK(blob[0] != encryption_t::c_format_gcm);
+    CHECK(store_raw_password(vault.path_(), 2, blob));
+
+    database_t db(storage_profile_t::tuned_(vault.path_()));
+    db.init_database_();
+    CHECK(db.legacy_entry_count_() == 1);
+    CHECK(db.get_decrypted_password_(2, key) == "two");
+
+    // Смена ключа не начинается, пока есть блоки CBC
+    CHECK(!db.rekey_(key, next));
+    CHECK(!db.rekey_in_progress_());
+
+    CHECK(db.migrate_cipher_(key));
+    CHECK(db.legacy_entry_count_() == 0);
+    CHECK(db.rekey_(key, next));
+    CHECK(db.get_decrypted_password_(1, next) == "one");
+    CHECK(db.get_decrypted_password_(2, next) == "two");
+}
+
+/**
+ * @brief Хранилище только из блоков CBC: неверный ключ проходит дополнение, поэтому
+ *        перевод в GCM ждёт контрольного значения ключа в заголовке.
+ */
+void check_migrate_requires_verified_key(const session_key_t& key) {
+    temp_file_t vault("cipher_legacy.db");
+    {
+        database_t db(storage_profile_t::tuned_(vault.path_()));
+        db.init_database_();
+        CHECK(db.add_entry_("only", "", "", "placeholder", "", key));
+    }
+
+    // Неверный ключ, с которым единственный блок CBC "расшифровывается"
+    std::vector<unsigned char> blob = legacy_cbc("secret", key);
+    CHECK(blob[0] != encryption_t::c_format_gcm);
+    CHECK(store_raw_password(vault.path_(), 1, blob));
+    encryption_t encryption;
+    cipher_context_t ctx;
+    std::string plaintext;
+    bool authenticated = false;
+    session_key_t wrong;
+    for (int i = 0; wrong.empty() && i < 100000; ++i) {
+        session_key_t candidate = test_key("wrong " + std::to_string(i));
+        if (decrypts(encryption, ctx, blob, candidate, plaintext, authenticated)) {
+            wrong = std::move(candidate);
+        }
+    }
+    CHECK(!wrong.empty());
+
+    database_t db(storage_profile_t::tuned_(vault.path_()));
+    db.init_database_();
+    CHECK(db.verify_key_(key) == key_check_t::unknown);
+    CHECK(db.verify_key_(wrong) == key_check_t::unknown);
+
+    // Проверить нечем - перевод не начинается ни с каким ключом, блок не тронут
+    CHECK(!db.migrate_cipher_(wrong));
+    CHECK(!db.migrate_cipher_(key));
+    CHECK(!db.rekey_in_progress_());
+    CHECK(db.legacy_entry_count_() == 1);
+    CHECK(db.get_decrypted_password_(1, key) == "secret");
+
+    // Без заголовка контрольное значение записать некуда
+    CHECK(!db.store_key_check_(key));
+
+    // Подтверждённый ключ в заголовке: неверный отвергается, верный переводит в GCM
+    CHECK(db.store_kdf_params_(kdf_params_t::legacy_()));
+    CHECK(db.store_key_check_(key));
+    CHECK(db.verify_key_(key) == key_check_t::match);
+    CHECK(db.verify_key_(wrong) == key_check_t::mismatch);
+    CHECK(!db.migrate_cipher_(wrong));
+    CHECK(db.legacy_entry_count_() == 1);
+    CHECK(db.get_decrypted_password_(1, key) == "secret");
+
+    CHECK(db.migrate_cipher_(key));
+    CHECK(db.legacy_entry_count_() == 0);
+    CHECK(db.get_decrypted_password_(1, key) == "secret");
+
+    // Смена ключа переписывает контрольное значение
+    session_key_t next = test_key("next");
+    CHECK(db.rekey_(key, next));
+    CHECK(db.verify_key_(next) == key_check_t::match);
+    CHECK(db.verify_key_(key) == key_check_t::mismatch);
+}
+
+} // namespace
+
+int main() {
+    encryption_t encryption;
+    session_key_t key = test_key("master");
+
+    check_gcm(encryption, key);
+    check_legacy_cbc(encryption, key);
+    check_rekey_requires_gcm(key);
+    check_migrate_requires_verified_key(key);
+
+    return test_result("test_cipher_format");
+}
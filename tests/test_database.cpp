@@ -9,6 +9,9 @@ int main() {
     std::cout << "Enter master password: ";
     std::getline(std::cin, masterPassword);
 
+    encryption_t encryption;
+    session_key_t key = session_key_t::derive_(encryption, masterPassword);
+
     while (true) {
         std::cout << "\n1) Add Entry"
                   << "\n2) Search"
@@ -33,7 +36,7 @@ int main() {
             std::cout << "Notes: ";
             std::getline(std::cin, notes);
 
-            bool added = db.add_entry_(title, url, username, password, notes, masterPassword);
+            bool added = db.add_entry_(title, url, username, password, notes, key);
             if (added) {
                 std::cout << "Entry added successfully.\n";
             } else {
@@ -45,7 +48,7 @@ int main() {
             std::cout << "Search query: ";
             std::getline(std::cin, query);
 
-            auto results = db.search_entries_(query, masterPassword);
+            auto results = db.search_entries_(query);
             std::cout << "=== Search results ===\n";
             for (auto& entry : results) {
                 // Можно выводить и другие поля
@@ -71,7 +74,7 @@ int main() {
             std::cin >> id;
             std::cin.ignore();
 
-            std::string decrypted = db.get_decrypted_password_(id, masterPassword);
+            std::string decrypted = db.get_decrypted_password_(id, key);
             if (!decrypted.empty()) {
                 std::cout << "Decrypted password: " << decrypted << std::endl;
             } else {
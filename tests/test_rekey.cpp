@@ -0,0 +1,99 @@
+#include "database/database.h"
+#include "test_util.h"
+#include <atomic>
+
+namespace {
+
+const int c_entries = 50;
+const size_t c_chunk = 10;
+
+std::string password_of(int id) {
+    return "password-" + std::to_string(id);
+}
+
+/**
+ * @brief Все пароли расшифровываются ключом key и совпадают с исходными.
+ */
+bool all_decrypt(database_t& db, const session_key_t& key) {
+    std::vector<int> ids;
+    for (int id = 1; id <= c_entries; ++id) {
+        ids.push_back(id);
+    }
+    std::vector<std::string> passwords;
+    if (!db.get_decrypted_passwords_(ids, key, passwords)) {
+        return false;
+    }
+    for (int id = 1; id <= c_entries; ++id) {
+        if (passwords[id - 1] != password_of(id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Смена oldKey -> newKey, отменённая после первого пакета.
+ * @return Результат rekey_ (ожидается false)
+ */
+bool interrupted_rekey(database_t& db, const session_key_t& oldKey, const session_key_t& newKey,
+                       const kdf_params_t* newParams = nullptr) {
+    std::atomic<bool> cancelled(false);
+    return db.rekey_(oldKey, newKey, c_chunk, [&](const rekey_progress_t&) { cancelled = true; },
+                     newParams, &cancelled);
+}
+
+int marker(database_t& db) {
+    int lastId = -1;
+    return db.rekey_in_progress_(&lastId) ? lastId : -1;
+}
+
+} // namespace
+
+int main() {
+    temp_file_t vault("rekey.db");
+    database_t db(storage_profile_t::tuned_(vault.path_()));
+    db.init_database_();
+
+    session_key_t first = test_key("first");
+    session_key_t second = test_key("second");
+    session_key_t stranger = test_key("stranger");
+
+    for (int id = 1; id <= c_entries; ++id) {
+        CHECK(db.add_entry_("entry " + std::to_string(id), "", "", password_of(id), "", first));
+    }
+
+    // Отмена: первый пакет уже под новым ключом, остальное - под старым
+    CHECK(!interrupted_rekey(db, first, second));
+    CHECK(marker(db) == static_cast<int>(c_chunk));
+    CHECK(db.get_decrypted_password_(c_chunk, second) == password_of(c_chunk));
+    CHECK(db.get_decrypted_password_(c_chunk + 1, first) == password_of(c_chunk + 1));
+
+    // Возобновление с чужим новым или старым ключом отклоняется, маркер на месте
+    CHECK(!db.rekey_(first, stranger, c_chunk));
+    CHECK(!db.rekey_(stranger, second, c_chunk));
+    CHECK(marker(db) == static_cast<int>(c_chunk));
+
+    // Возобновление с теми же ключами доводит смену до конца
+    CHECK(db.rekey_(first, second, c_chunk));
+    CHECK(marker(db) == -1);
+    CHECK(all_decrypt(db, second));
+    CHECK(!all_decrypt(db, first));
+
+    // Откат прерванной смены возвращает всё старому ключу и убирает ожидающий KDF
+    kdf_params_t pending = kdf_params_t::legacy_().with_new_salt_();
+    kdf_params_t loaded;
+    CHECK(!interrupted_rekey(db, second, first, &pending));
+    CHECK(db.load_kdf_params_(loaded, true));
+    CHECK(!db.rollback_rekey_(second, stranger, 3)); // чужой новый ключ - ничего не трогаем
+    CHECK(marker(db) == static_cast<int>(c_chunk));
+    CHECK(db.rollback_rekey_(second, first, 3));
+    CHECK(marker(db) == -1);
+    CHECK(!db.load_kdf_params_(loaded, true));
+    CHECK(all_decrypt(db, second));
+
+    // Без маркера откатывать нечего
+    CHECK(db.rollback_rekey_(second, first));
+    CHECK(all_decrypt(db, second));
+
+    return test_result("test_rekey");
+}
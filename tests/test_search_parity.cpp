@@ -0,0 +1,156 @@
+#include "database/database.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+const int c_random_entries = 200;
+const size_t c_long_field = 100;
+
+/**
+ * @brief Детерминированный генератор (LCG), чтобы набор записей не менялся между запусками.
+ */
+class lcg_t {
+private:
+    uint32_t m_state;
+
+public:
+    explicit lcg_t(uint32_t seed) : m_state(seed) {}
+    uint32_t next_(uint32_t bound) {
+        m_state = m_state * 1664525u + 1013904223u;
+        return (m_state >> 8) % bound;
+    }
+};
+
+/**
+ * @brief Поле из символов, на которых расходились LIKE и поиск подстроки:
+ *        регистр, шаблонные символы LIKE, обратная косая черта, не-ASCII.
+ */
+std::string random_field(lcg_t& random) {
+    static const char* const c_pieces[] = {"a", "A", "b", "B", "%", "_", "\\", ".", "-", "@", " ", "x", "\xC3\xA9"};
+    std::string field;
+    size_t length = random.next_(80);
+    while (field.size() < length) {
+        field += c_pieces[random.next_(sizeof(c_pieces) / sizeof(c_pieces[0]))];
+    }
+    return field;
+}
+
+char fold(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool contains_folded(const std::string& field, const std::string& query) {
+    auto equal = [](char a, char b) { return fold(a) == fold(b); };
+    return std::search(field.begin(), field.end(), query.begin(), query.end(), equal) != field.end();
+}
+
+/**
+ * @brief Эталон: query - подстрока одного из полей без учёта регистра ASCII,
+ *        пустой запрос - все записи.
+ */
+std::vector<int> reference_ids(const std::vector<password_entry_t>& entries, const std::string& query) {
+    std::vector<int> ids;
+    for (const password_entry_t& entry : entries) {
+        if (query.empty() || contains_folded(entry.m_title, query) || contains_folded(entry.m_url, query) ||
+            contains_folded(entry.m_username, query) || contains_folded(entry.m_notes, query)) {
+            ids.push_back(entry.m_id);
+        }
+    }
+    return ids;
+}
+
+std::vector<int> found_ids(database_t& db, const std::string& query) {
+    std::vector<int> ids;
+    bool ok = db.for_each_entry_(query, [&](const password_entry_view_t& view) { ids.push_back(view.m_id); });
+    CHECK(ok);
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+/**
+ * @brief Колоночное хранилище, снимок и эталон дают одни и те же записи.
+ * @param sqlQueries Запросы без индексируемых слов: для них и SQL идёт через LIKE
+ */
+void check_parity(database_t& sql, database_t& columns, const std::string& snapshotPath,
+                  const std::vector<std::string>& queries, const std::vector<std::string>& sqlQueries) {
+    std::vector<password_entry_t> entries = sql.search_entries_("");
+    std::sort(entries.begin(), entries.end(),
+              [](const password_entry_t& a, const password_entry_t& b) { return a.m_id < b.m_id; });
+
+    CHECK(sql.export_snapshot_(snapshotPath));
+    database_t snapshot(storage_profile_t::snapshot_(snapshotPath));
+    snapshot.init_database_();
+
+    for (const std::string& query : queries) {
+        std::vector<int> expected = reference_ids(entries, query);
+        std::vector<int> fromColumns = found_ids(columns, query);
+        std::vector<int> fromSnapshot = found_ids(snapshot, query);
+        if (fromColumns != expected || fromSnapshot != expected) {
+            std::cerr << "query \"" << query << "\": expected " << expected.size() << ", columns "
+                      << fromColumns.size() << ", snapshot " << fromSnapshot.size() << "\n";
+        }
+        CHECK(fromColumns == expected);
+        CHECK(fromSnapshot == expected);
+    }
+    for (const std::string& query : sqlQueries) {
+        std::vector<int> expected = reference_ids(entries, query);
+        std::vector<int> fromSql = found_ids(sql, query);
+        if (fromSql != expected) {
+            std::cerr << "query \"" << query << "\": expected " << expected.size() << ", sql "
+                      << fromSql.size() << "\n";
+        }
+        CHECK(fromSql == expected);
+    }
+}
+
+} // namespace
+
+int main() {
+    temp_file_t vault("search_parity.db");
+    temp_file_t snapshotFile("search_parity.snap");
+    session_key_t key = test_key("master");
+
+    database_t sql(storage_profile_t::tuned_(vault.path_()));
+    sql.init_database_();
+
+    lcg_t random(12345);
+    for (int i = 0; i < c_random_entries; ++i) {
+        std::string title = random_field(random), url = random_field(random);
+        std::string username = random_field(random), notes = random_field(random);
+        CHECK(sql.add_entry_(title, url, username, "pw", notes, key));
+    }
+    // Совпадение на каждом смещении длинного поля: проверка хвостов и границ блоков SIMD
+    for (size_t offset = 0; offset + 6 <= c_long_field; ++offset) {
+        std::string field(c_long_field, 'x');
+        field.replace(offset, 6, offset % 2 ? "NeEdLe" : "needle");
+        std::string fields[4] = {"", "", "", ""};
+        fields[offset % 4] = field;
+        CHECK(sql.add_entry_(fields[0], fields[1], fields[2], "pw", fields[3], key));
+    }
+
+    database_t columns(storage_profile_t::tuned_(vault.path_()));
+    columns.init_database_();
+    columns.load_column_store_();
+
+    // Без букв, цифр и не-ASCII: FTS такие запросы не принимает, SQL ищет через LIKE
+    const std::vector<std::string> sqlQueries = {"%", "_", "\\", "%_", "_%", "\\%", "\\_", "%%", "__", ".",
+                                                 "-", "@", "_\\%", ". -"};
+    std::vector<std::string> queries = sqlQueries;
+    for (const char* query : {"", "\xC3\xA9", "%\xC3\xA9_", "a", "A", "ab", "AB", "aB%", "b_a", "a\\b",
+                              "needle", "NEEDLE", "eedl", "xneedlex",
+                              "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxneedle",
+                              "needlexxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx", "no such text"}) {
+        queries.push_back(query);
+    }
+    check_parity(sql, columns, snapshotFile.path_(), queries, sqlQueries);
+
+    // Изменения через колоночное хранилище видны в нём так же, как в SQL
+    CHECK(columns.update_entry_(1, "Updated_%", "", "", "pw", "", key));
+    CHECK(columns.delete_entry_(2));
+    CHECK(columns.add_entry_("added \\ entry", "", "", "pw", "", key));
+    check_parity(sql, columns, snapshotFile.path_(), queries, sqlQueries);
+
+    return test_result("test_search_parity");
+}
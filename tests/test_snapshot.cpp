@@ -0,0 +1,157 @@
+#include "database/database.h"
+#include "database/snapshot.h"
+#include "test_util.h"
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+
+namespace {
+
+const int c_entries = 20;
+
+std::vector<unsigned char> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_file(const std::string& path, const std::vector<unsigned char>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+template <typename T>
+void patch(std::vector<unsigned char>& bytes, size_t offset, T value) {
+    std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+template <typename T>
+T peek(const std::vector<unsigned char>& bytes, size_t offset) {
+    T value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Открывается ли копия снимка после порчи corrupt.
+ */
+bool opens_after(const std::vector<unsigned char>& original,
+                 const std::function<void(std::vector<unsigned char>&)>& corrupt) {
+    temp_file_t copy("corrupted.snap");
+    std::vector<unsigned char> bytes = original;
+    corrupt(bytes);
+    write_file(copy.path_(), bytes);
+    snapshot_t snapshot;
+    return snapshot.open_(copy.path_());
+}
+
+/**
+ * @brief Снимок совпадает с хранилищем: те же записи, пароли расшифровываются ключом.
+ */
+void check_contents(database_t& source, database_t& snapshot, const session_key_t& key) {
+    std::vector<password_entry_t> expected = source.search_entries_("");
+    std::vector<password_entry_t> actual = snapshot.search_entries_("");
+    CHECK(actual.size() == expected.size());
+    for (size_t i = 0; i < expected.size() && i < actual.size(); ++i) {
+        CHECK(actual[i].m_id == expected[i].m_id);
+        CHECK(actual[i].m_title == expected[i].m_title);
+        CHECK(actual[i].m_url == expected[i].m_url);
+        CHECK(actual[i].m_username == expected[i].m_username);
+        CHECK(actual[i].m_notes == expected[i].m_notes);
+        CHECK(snapshot.get_decrypted_password_(expected[i].m_id, key) ==
+              source.get_decrypted_password_(expected[i].m_id, key));
+    }
+    CHECK(snapshot.search_entries_("site 1").size() == source.search_entries_("site 1").size());
+}
+
+void check_corruption(const std::string& path) {
+    const std::vector<unsigned char> original = read_file(path);
+    CHECK(original.size() > sizeof(snapshot_header_t));
+    CHECK(opens_after(original, [](std::vector<unsigned char>&) {}));
+
+    // Заголовок: любое несоответствие - снимок не открывается
+    CHECK(!opens_after(original, [](std::vector<unsigned char>& b) { b[0] ^= 0xFF; }));
+    CHECK(!opens_after(original, [](std::vector<unsigned char>& b) {
+        patch(b, offsetof(snapshot_header_t, m_version), peek<uint32_t>(b, offsetof(snapshot_header_t, m_version)) + 1);
+    }));
+    CHECK(!opens_after(original, [](std::vector<unsigned char>& b) {
+        patch<uint32_t>(b, offsetof(snapshot_header_t, m_byteOrder), 0x04030201);
+    }));
+    CHECK(!opens_after(original, [](std::vector<unsigned char>& b) { b.pop_back(); }));
+    CHECK(!opens_after(original, [](std::vector<unsigned char>& b) { b.push_back(0); }));
+    CHECK(!opens_after(original, [](std::vector<unsigned char>& b) { b.resize(10); }));
+    CHECK(!opens_after(original, [](std::vector<unsigned char>& b) {
+        size_t at = offsetof(snapshot_header_t, m_entryCount);
+        patch(b, at, peek<uint32_t>(b, at) + 1);
+    }));
+    CHECK(!opens_after(original, [](std::vector<unsigned char>& b) {
+        size_t at = offsetof(snapshot_header_t, m_stringsSize);
+        patch(b, at, peek<uint64_t>(b, at) + 1);
+    }));
+    CHECK(!opens_after(original, [](std::vector<unsigned char>& b) {
+        patch<uint32_t>(b, offsetof(snapshot_header_t, m_kdfSaltSize), 25);
+    }));
+
+    // Индекс при открытии не разбирается: испорченная запись отвергается при чтении
+    temp_file_t copy("bad_record.snap");
+    std::vector<unsigned char> bytes = original;
+    size_t first = sizeof(snapshot_header_t);
+    size_t second = first + sizeof(snapshot_record_t);
+    patch<uint32_t>(bytes, first + offsetof(snapshot_record_t, m_fields), 0xFFFFFFF0u);
+    patch<uint32_t>(bytes, second + offsetof(snapshot_record_t, m_blobOffset), 0xFFFFFFF0u);
+    write_file(copy.path_(), bytes);
+
+    snapshot_t snapshot;
+    CHECK(snapshot.open_(copy.path_()));
+    auto ignore = [](const password_entry_view_t&) {};
+    CHECK(!snapshot.visit_(1, ignore));
+    CHECK(!snapshot.visit_(2, ignore));
+    CHECK(snapshot.visit_(3, ignore));
+    CHECK(!snapshot.for_each_("", ignore));
+}
+
+} // namespace
+
+int main() {
+    temp_file_t vault("snapshot.db");
+    temp_file_t snapshotFile("vault.snap");
+    session_key_t key = test_key("master");
+
+    database_t db(storage_profile_t::tuned_(vault.path_()));
+    db.init_database_();
+    kdf_params_t params{kdf_algorithm_t::pbkdf2_sha256, 1, 0, 0, 0, {'t', 'e', 's', 't'}};
+    CHECK(db.store_kdf_params_(params));
+    for (int i = 0; i < c_entries; ++i) {
+        std::string n = std::to_string(i);
+        CHECK(db.add_entry_("Site " + n, "site" + n + ".example", "user" + n, "password " + n, "notes " + n, key));
+    }
+
+    CHECK(db.export_snapshot_(snapshotFile.path_()));
+    {
+        database_t snapshot(storage_profile_t::snapshot_(snapshotFile.path_()));
+        snapshot.init_database_();
+        CHECK(snapshot.read_only_());
+        check_contents(db, snapshot, key);
+
+        kdf_params_t stored;
+        CHECK(snapshot.load_kdf_params_(stored));
+        CHECK(stored.m_algorithm == params.m_algorithm && stored.m_iterations == params.m_iterations);
+        CHECK(stored.m_salt == params.m_salt);
+
+        CHECK(!snapshot.add_entry_("new", "", "", "pw", "", key));
+        CHECK(!snapshot.delete_entry_(1));
+    }
+
+    check_corruption(snapshotFile.path_());
+
+    // Наполовину перешифрованное хранилище не экспортируется
+    session_key_t next = test_key("next");
+    std::atomic<bool> cancelled(false);
+    CHECK(!db.rekey_(key, next, 5, [&](const rekey_progress_t&) { cancelled = true; }, nullptr, &cancelled));
+    CHECK(db.rekey_in_progress_());
+    CHECK(!db.export_snapshot_(snapshotFile.path_()));
+
+    return test_result("test_snapshot");
+}
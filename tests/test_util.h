@@ -0,0 +1,81 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include "encryption/kdf.h"
+#include "encryption/session_key.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+/**
+ * @brief Общие средства автоматических тестов (ctest): проверки без
+ *        фреймворка, временные файлы хранилища и быстрые ключи.
+ */
+
+inline int& test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+/**
+ * @brief Проверка условия: при провале печатает место и продолжает тест,
+ *        итог подводит test_result().
+ */
+#define CHECK(condition)                                                                       \
+    do {                                                                                       \
+        if (!(condition)) {                                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            ++test_failures();                                                                 \
+        }                                                                                      \
+    } while (0)
+
+/**
+ * @brief Код возврата теста для ctest: 0, если все проверки прошли.
+ */
+inline int test_result(const char* name) {
+    if (test_failures() > 0) {
+        std::cerr << name << ": " << test_failures() << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << name << ": ok\n";
+    return 0;
+}
+
+/**
+ * @brief Временный файл во /tmp с уникальным для процесса именем; удаляется
+ *        (вместе с -wal/-shm SQLite) при создании и в деструкторе.
+ */
+class temp_file_t {
+private:
+    std::string m_path;
+
+    void remove_() const {
+        std::remove(m_path.c_str());
+        std::remove((m_path + "-wal").c_str());
+        std::remove((m_path + "-shm").c_str());
+    }
+
+public:
+    explicit temp_file_t(const std::string& name)
+        : m_path("/tmp/passman_" + std::to_string(getpid()) + "_" + name) {
+        remove_();
+    }
+    ~temp_file_t() { remove_(); }
+
+    temp_file_t(const temp_file_t&) = delete;
+    temp_file_t& operator=(const temp_file_t&) = delete;
+
+    const std::string& path_() const { return m_path; }
+};
+
+/**
+ * @brief Ключ сессии из пароля с минимальной стоимостью KDF: тестам нужны
+ *        разные ключи, а не стойкость к перебору.
+ */
+inline session_key_t test_key(const std::string& password) {
+    kdf_params_t params{kdf_algorithm_t::pbkdf2_sha256, 1, 0, 0, 0, {'t', 'e', 's', 't'}};
+    return session_key_t::derive_(password, params);
+}
+
+#endif // TEST_UTIL_H